@@ -0,0 +1,371 @@
+//########################################################################
+// (C) Embedded Systems Lab
+// All rights reserved.
+// ------------------------------------------------------------
+// This document contains proprietary information belonging to
+// Research & Development FH OÖ Forschungs und Entwicklungs GmbH.
+// Using, passing on and copying of this document or parts of it
+// is generally not permitted without prior written authorization.
+// ------------------------------------------------------------
+// info(at)embedded-lab.at
+// https://www.embedded-lab.at/
+//########################################################################
+// *** File name: FuzzyBench.c
+// *** Date of file creation: 2022-02-07
+// *** List of autors: Lucas Drack
+// ***
+// *** Benchmark of feGenerate/feReproduce over a parameter sweep.
+//########################################################################
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sodium.h>
+
+#include "CFuzzyExtractor.h"
+#include "HelperDataFile.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <time.h>
+#include <sys/resource.h>
+#endif
+
+//  Usage: fuzzy_bench [options]
+//
+//    --length 16,32          value lengths in bytes
+//    --hamerr 2,4            Hamming errors
+//    --reperr 0.001          reproduce errors
+//    --threads 1,0           worker threads, 0 = one per CPU
+//    --locker argon2id,blake2b
+//                            argon2id, argon2i, blake2b, pbkdf2
+//    --trials 50             reproductions per configuration
+//    --format json|csv       output format (default json)
+//    --output path           write results to path instead of stdout
+//
+//  Every configuration generates helper data once and then reproduces the
+//  key from trials readings with exactly hamErr random bit flips. Which
+//  locker opens differs per reading, so reproduce time is reported as a
+//  distribution (best, median, p99, worst).
+
+#define BENCH_MAX_VALUES 16
+
+typedef struct {
+    size_t count;
+    double values[BENCH_MAX_VALUES];
+} BenchList;
+
+typedef struct {
+    BenchList lengths;
+    BenchList hamErrs;
+    BenchList repErrs;
+    BenchList threads;
+    size_t numLockers;
+    LockerAlgorithm lockers[BENCH_MAX_VALUES];
+    size_t trials;
+    bool csv;
+    const char* output;
+} BenchOptions;
+
+typedef struct {
+    size_t length;
+    size_t hamErr;
+    double repErr;
+    size_t threads;
+    LockerAlgorithm locker;
+    size_t numHelpers;
+    size_t helperBytes;
+    double generateMs;
+    double reproduceBestMs;
+    double reproduceMedianMs;
+    double reproduceP99Ms;
+    double reproduceWorstMs;
+    size_t reproduced;
+    size_t trials;
+    size_t peakRssKiB;
+} BenchResult;
+
+static double nowMs(void) {
+#ifdef _WIN32
+    LARGE_INTEGER freq, count;
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&count);
+    return 1000.0 * (double)count.QuadPart / (double)freq.QuadPart;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return 1000.0 * (double)ts.tv_sec + (double)ts.tv_nsec / 1e6;
+#endif
+}
+
+//  Peak resident set size of the whole process so far. It never shrinks,
+//  so later rows report the maximum over all configurations run before.
+static size_t peakRssKiB(void) {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS pmc;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc))) return 0;
+    return (size_t)(pmc.PeakWorkingSetSize / 1024);
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+#ifdef __APPLE__
+    return (size_t)(usage.ru_maxrss / 1024);   // bytes on macOS
+#else
+    return (size_t)usage.ru_maxrss;            // KiB on Linux
+#endif
+#endif
+}
+
+static int compareDouble(const void* a, const void* b) {
+    double x = *(const double*)a;
+    double y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+//  Nearest-rank percentile of n sorted values.
+static double percentile(const double sorted[], size_t const n, double const pct) {
+    if (n == 0) return 0.0;
+    size_t rank = (size_t)ceil(pct / 100.0 * (double)n);
+    if (rank < 1) rank = 1;
+    if (rank > n) rank = n;
+    return sorted[rank - 1];
+}
+
+static int parseList(const char* arg, BenchList *const list) {
+    list->count = 0;
+    const char* p = arg;
+    while (*p) {
+        char* end;
+        double v = strtod(p, &end);
+        if (end == p || list->count == BENCH_MAX_VALUES) return -1;
+        list->values[list->count++] = v;
+        p = (*end == ',') ? end + 1 : end;
+        if (*end != ',' && *end != '\0') return -1;
+    }
+    return list->count ? 0 : -1;
+}
+
+static int parseLockers(const char* arg, BenchOptions *const o) {
+    static const struct { const char* name; LockerAlgorithm algorithm; } names[] = {
+        { "argon2id", LOCKER_ARGON2ID },
+        { "argon2i",  LOCKER_ARGON2I },
+        { "blake2b",  LOCKER_BLAKE2B },
+        { "pbkdf2",   LOCKER_PBKDF2_SHA256 },
+    };
+    o->numLockers = 0;
+    const char* p = arg;
+    while (*p) {
+        size_t n = strcspn(p, ",");
+        bool found = false;
+        for (size_t j = 0; j < sizeof(names) / sizeof(names[0]) && !found; j++) {
+            if (strlen(names[j].name) == n && strncmp(p, names[j].name, n) == 0) {
+                if (o->numLockers == BENCH_MAX_VALUES) return -1;
+                o->lockers[o->numLockers++] = names[j].algorithm;
+                found = true;
+            }
+        }
+        if (!found) return -1;
+        p += n;
+        if (*p == ',') p++;
+    }
+    return o->numLockers ? 0 : -1;
+}
+
+static void defaultOptions(BenchOptions *const o) {
+    parseList("16,32", &o->lengths);
+    parseList("2,4", &o->hamErrs);
+    parseList("0.001", &o->repErrs);
+    parseList("1,0", &o->threads);
+    parseLockers("argon2id,blake2b", o);
+    o->trials = 50;
+    o->csv = false;
+    o->output = 0;
+}
+
+static int parseOptions(int argc, char** argv, BenchOptions *const o) {
+    defaultOptions(o);
+    for (int a = 1; a < argc; a++) {
+        const char* opt = argv[a];
+        const char* arg = (a + 1 < argc) ? argv[a + 1] : 0;
+        int ret = 0;
+        if (!arg) {
+            ret = -1;
+        }
+        else if (strcmp(opt, "--length") == 0)  ret = parseList(arg, &o->lengths);
+        else if (strcmp(opt, "--hamerr") == 0)  ret = parseList(arg, &o->hamErrs);
+        else if (strcmp(opt, "--reperr") == 0)  ret = parseList(arg, &o->repErrs);
+        else if (strcmp(opt, "--threads") == 0) ret = parseList(arg, &o->threads);
+        else if (strcmp(opt, "--locker") == 0)  ret = parseLockers(arg, o);
+        else if (strcmp(opt, "--trials") == 0)  o->trials = (size_t)strtoul(arg, 0, 10);
+        else if (strcmp(opt, "--output") == 0)  o->output = arg;
+        else if (strcmp(opt, "--format") == 0) {
+            if (strcmp(arg, "csv") == 0) o->csv = true;
+            else if (strcmp(arg, "json") == 0) o->csv = false;
+            else ret = -1;
+        }
+        else {
+            ret = -1;
+        }
+        if (ret != 0) {
+            fprintf(stderr, "fuzzy_bench error: invalid option %s.\n", opt);
+            return -1;
+        }
+        a++;
+    }
+    if (o->trials == 0) o->trials = 1;
+    return 0;
+}
+
+//  Flips exactly hamErr distinct random bits of value.
+static void flipBits(unsigned char value[], size_t const len, size_t const hamErr) {
+    size_t bits = len * 8;
+    unsigned char flipped[bits];
+    memset(flipped, 0, bits);
+    for (size_t n = 0; n < hamErr && n < bits; ) {
+        uint32_t b = randombytes_uniform((uint32_t)bits);
+        if (flipped[b]) continue;
+        flipped[b] = 1;
+        value[b / 8] ^= (unsigned char)(1 << (b % 8));
+        n++;
+    }
+}
+
+static int runConfiguration(const BenchOptions *const o, BenchResult *const r) {
+    FEProperties p;
+    HelperData h;
+    initFEProperties(&p, r->length, r->hamErr, r->repErr);
+    initLockerParams(&p.locker, r->locker);
+    initHelperData(&h);
+    r->numHelpers = p.numHelpers;
+    r->trials = o->trials;
+
+    unsigned char value[r->length];
+    unsigned char noisy[r->length];
+    unsigned char key[r->length];
+    unsigned char reproduced[r->length];
+    randombytes_buf(value, r->length);
+
+    double start = nowMs();
+    int ret = feGenerateParallel(value, key, r->length, &h, &p, r->threads);
+    r->generateMs = nowMs() - start;
+    if (ret != 0) {
+        fprintf(stderr, "fuzzy_bench error: feGenerateParallel failed (%d).\n", ret);
+        return ret;
+    }
+    r->helperBytes = helperDataFileSize(&h);
+
+    double* times = (double*)malloc(o->trials * sizeof(double));
+    if (!times) {
+        freeHelperData(&h);
+        return -3;
+    }
+    r->reproduced = 0;
+    for (size_t t = 0; t < o->trials && ret == 0; t++) {
+        memcpy(noisy, value, r->length);
+        flipBits(noisy, r->length, r->hamErr);
+        memset(reproduced, 0, r->length);
+
+        start = nowMs();
+        ret = feReproduceParallel(noisy, reproduced, r->length, &h, r->threads);
+        times[t] = nowMs() - start;
+        r->reproduced += (ret == 0 && memcmp(key, reproduced, r->length) == 0);
+    }
+
+    if (ret == 0) {
+        qsort(times, o->trials, sizeof(double), compareDouble);
+        r->reproduceBestMs   = times[0];
+        r->reproduceMedianMs = percentile(times, o->trials, 50.0);
+        r->reproduceP99Ms    = percentile(times, o->trials, 99.0);
+        r->reproduceWorstMs  = times[o->trials - 1];
+        r->peakRssKiB = peakRssKiB();
+    }
+    else {
+        fprintf(stderr, "fuzzy_bench error: feReproduceParallel failed (%d).\n", ret);
+    }
+    free(times);
+    freeHelperData(&h);
+    return ret;
+}
+
+static void printResult(FILE* out, const BenchResult *const r, bool const csv, bool const first) {
+    if (csv) {
+        fprintf(out, "%zu,%zu,%g,%zu,%s,%zu,%zu,%.3f,%.3f,%.3f,%.3f,%.3f,%zu,%zu,%zu\n",
+                r->length, r->hamErr, r->repErr, r->threads, lockerName(r->locker),
+                r->numHelpers, r->helperBytes, r->generateMs,
+                r->reproduceBestMs, r->reproduceMedianMs, r->reproduceP99Ms, r->reproduceWorstMs,
+                r->reproduced, r->trials, r->peakRssKiB);
+        return;
+    }
+    fprintf(out, "%s  {\"length\": %zu, \"hamErr\": %zu, \"repErr\": %g, \"threads\": %zu, "
+            "\"locker\": \"%s\", \"numHelpers\": %zu, \"helperBytes\": %zu, \"generateMs\": %.3f, "
+            "\"reproduceMs\": {\"best\": %.3f, \"median\": %.3f, \"p99\": %.3f, \"worst\": %.3f}, "
+            "\"reproduced\": %zu, \"trials\": %zu, \"peakRssKiB\": %zu}",
+            first ? "" : ",\n",
+            r->length, r->hamErr, r->repErr, r->threads, lockerName(r->locker),
+            r->numHelpers, r->helperBytes, r->generateMs,
+            r->reproduceBestMs, r->reproduceMedianMs, r->reproduceP99Ms, r->reproduceWorstMs,
+            r->reproduced, r->trials, r->peakRssKiB);
+}
+
+int main(int argc, char** argv) {
+    BenchOptions o;
+    if (parseOptions(argc, argv, &o) != 0) {
+        return 1;
+    }
+    if (sodium_init() == -1) {
+        return 1;
+    }
+
+    FILE* out = stdout;
+    if (o.output) {
+        out = fopen(o.output, "w");
+        if (!out) {
+            fprintf(stderr, "fuzzy_bench error: could not open %s.\n", o.output);
+            return 1;
+        }
+    }
+
+    if (o.csv) {
+        fprintf(out, "length,hamErr,repErr,threads,locker,numHelpers,helperBytes,generateMs,"
+                "reproduceBestMs,reproduceMedianMs,reproduceP99Ms,reproduceWorstMs,"
+                "reproduced,trials,peakRssKiB\n");
+    }
+    else {
+        fprintf(out, "[\n");
+    }
+
+    int ret = 0;
+    bool first = true;
+    for (size_t l = 0; l < o.lengths.count; l++)
+    for (size_t e = 0; e < o.hamErrs.count; e++)
+    for (size_t q = 0; q < o.repErrs.count; q++)
+    for (size_t t = 0; t < o.threads.count; t++)
+    for (size_t k = 0; k < o.numLockers; k++) {
+        BenchResult r;
+        memset(&r, 0, sizeof(r));
+        r.length  = (size_t)o.lengths.values[l];
+        r.hamErr  = (size_t)o.hamErrs.values[e];
+        r.repErr  = o.repErrs.values[q];
+        r.threads = (size_t)o.threads.values[t];
+        if (r.threads == 0) r.threads = feNumCPUs();
+        r.locker  = o.lockers[k];
+
+        if (runConfiguration(&o, &r) != 0) {
+            ret = 1;
+            continue;
+        }
+        printResult(out, &r, o.csv, first);
+        fflush(out);
+        first = false;
+    }
+
+    if (!o.csv) {
+        fprintf(out, "%s]\n", first ? "" : "\n");
+    }
+    if (out != stdout) {
+        fclose(out);
+    }
+    return ret;
+}
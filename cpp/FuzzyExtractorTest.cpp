@@ -0,0 +1,130 @@
+//########################################################################
+// (C) Embedded Systems Lab
+// All rights reserved.
+// ------------------------------------------------------------
+// This document contains proprietary information belonging to
+// Research & Development FH OÖ Forschungs und Entwicklungs GmbH.
+// Using, passing on and copying of this document or parts of it
+// is generally not permitted without prior written authorization.
+// ------------------------------------------------------------
+// info(at)embedded-lab.at
+// https://www.embedded-lab.at/
+//########################################################################
+// *** File name: FuzzyExtractorTest.cpp
+// *** Date of file creation: 2022-02-07
+// *** List of autors: Lucas Drack
+// ***
+// *** Tests of the C++ front-end (FuzzyExtractor.hpp).
+//########################################################################
+
+#include <cstdio>
+#include <cstring>
+#include <utility>
+
+#include "FuzzyExtractor.hpp"
+#include "HelperDataFile.h"
+
+//  Same reporting as minunit in main.c.
+#define CHECK(message, test) do { if (!(test)) return message; } while (0)
+
+static int tests_run = 0;
+static int tests_failed = 0;
+
+static void runTest(const char* (*test)(), const char* name) {
+    const char* message = test();
+    tests_run++;
+    if (message) {
+        tests_failed++;
+        printf("[FAIL] error in %s\n%s\n", name, message);
+    }
+    printf("[OK] %s finished\n", name);
+}
+
+// The constexpr parameters must be the ones initFEProperties() computes.
+static const char* testProperties() {
+    FEProperties p;
+    initFEProperties(&p, 16, 4, 0.001);
+    CHECK("Error: numHelpers differs from initFEProperties.",
+            (fe::FuzzyExtractor<16, 4>::numHelpers == p.numHelpers));
+    CHECK("Error: cipherLen differs from initFEProperties.",
+            (fe::FuzzyExtractor<16, 4>::cipherLen == p.cipherLen));
+
+    initFEProperties(&p, 32, 6, 0.01);
+    CHECK("Error: numHelpers differs from initFEProperties.",
+            (fe::FuzzyExtractor<32, 6, std::ratio<1, 100>>::numHelpers == p.numHelpers));
+    return nullptr;
+}
+
+// Keys must be reproduced from a noisy value, and not from a different one.
+static const char* testGenerateReproduce() {
+    using FE = fe::FuzzyExtractor<16, 4>;
+    FE extractor(LOCKER_BLAKE2B);
+    FE::HelperData h;
+    FE::Value value;
+    FE::Value noisy;
+    FE::Key key;
+    FE::Key reproduced;
+
+    randombytes_buf(value.data(), value.size());
+    CHECK("Error: generate failed.", extractor.generate(value, key, h) == 0);
+
+    noisy = value;
+    noisy[3] ^= 0x11;
+    CHECK("Error: could not reproduce key from noisy value.",
+            extractor.reproduce(noisy, reproduced, h) == 0 && reproduced == key);
+
+    randombytes_buf(noisy.data(), noisy.size());
+    CHECK("Error: reproduced key from a different value.",
+            extractor.reproduce(noisy, reproduced, h) == -4);
+
+    FE moved(std::move(extractor));
+    FE::HelperData other(std::move(h));
+    CHECK("Error: moved-from helper data still valid.", !h.valid() && other.valid());
+    CHECK("Error: moved extractor does not reproduce.",
+            moved.reproduce(value, reproduced, other) == 0 && reproduced == key);
+    return nullptr;
+}
+
+// Helper data exported to C must work with feReproduce() and import back.
+static const char* testExportImport() {
+    using FE = fe::FuzzyExtractor<16, 4>;
+    FE extractor;
+    FE::HelperData h;
+    FE::HelperData imported;
+    FE::Value value;
+    FE::Key key;
+    FE::Key reproduced;
+    ::HelperData c;
+    initHelperData(&c);
+
+    randombytes_buf(value.data(), value.size());
+    CHECK("Error: generate failed.", extractor.generate(value, key, h) == 0);
+    CHECK("Error: exportTo failed.", h.exportTo(&c) == 0);
+
+    unsigned char cKey[16];
+    CHECK("Error: feReproduce failed on exported helper data.",
+            feReproduce(value.data(), cKey, 16, &c) == 0 && memcmp(cKey, key.data(), 16) == 0);
+
+    CHECK("Error: importFrom failed.", imported.importFrom(c) == 0);
+    CHECK("Error: could not reproduce from imported helper data.",
+            extractor.reproduce(value, reproduced, imported) == 0 && reproduced == key);
+
+    freeHelperData(&c);
+    return nullptr;
+}
+
+int main() {
+    if (sodium_init() == -1) {
+        return 1;
+    }
+
+    runTest(testProperties, "testProperties");
+    runTest(testGenerateReproduce, "testGenerateReproduce");
+    runTest(testExportImport, "testExportImport");
+
+    if (tests_failed == 0) {
+        printf("ALL TESTS PASSED\n");
+    }
+    printf("Tests run: %d\n", tests_run);
+    return tests_failed ? 1 : 0;
+}
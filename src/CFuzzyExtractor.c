@@ -23,60 +23,345 @@
 
 
 #include "CFuzzyExtractor.h"
+#include "HelperDataFile.h"
+#include "ThresholdFuzzyExtractor.h"
+#include "FESimd.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
 
 // Internal data type for brevity.
 typedef unsigned char byte;
 
+//  Cache line size used to align the helper data block and its arrays.
+#define FE_CACHE_LINE 64
+
+static size_t alignUp(size_t const n) {
+    return (n + FE_CACHE_LINE - 1) & ~(size_t)(FE_CACHE_LINE - 1);
+}
+
+static void* allocAligned(size_t const size) {
+#ifdef _WIN32
+    return _aligned_malloc(size, FE_CACHE_LINE);
+#else
+    void* ptr = 0;
+    if (posix_memalign(&ptr, FE_CACHE_LINE, size) != 0) return 0;
+    return ptr;
+#endif
+}
+
+static void freeAligned(void* ptr) {
+#ifdef _WIN32
+    _aligned_free(ptr);
+#else
+    free(ptr);
+#endif
+}
+
+//  Bytes one helper stores to select the bits of the value it locks:
+//  a mask of length bytes, or sampleBits indices.
+static size_t helperSelectorLen(const HelperData *const h) {
+    return h->sampleBits ? h->sampleBits * sizeof(uint32_t) : h->length;
+}
+
+//  Length in bytes of the vector that is hashed into a locker.
+static size_t helperInputLen(const HelperData *const h) {
+    return h->sampleBits ? (h->sampleBits + 7) / 8 : h->length;
+}
+
+//  The block holds the masks (or indices), nonces and ciphers of all helpers
+//  as flat arrays, each array starting on a cache line:  [masks | nonces | ciphers]
+//  Seeded helper data derives masks and nonces and only stores the ciphers.
+void layoutHelperData(HelperData *const h) {
+    byte* base = (byte*)h->block;
+    h->masks   = 0;
+    h->indices = 0;
+    if (h->seeded) {
+        h->nonces  = 0;
+        h->ciphers = base;
+        return;
+    }
+    if (h->sampleBits) {
+        h->indices = (uint32_t*)base;
+    }
+    else {
+        h->masks = base;
+    }
+    h->nonces  = base      + alignUp(h->numHelpers * helperSelectorLen(h));
+    h->ciphers = h->nonces + alignUp(h->numHelpers * h->nonceLen);
+}
+
+//  Adds alignUp(count * each) to *size. Dimensions may come from a file, so
+//  every step is checked for overflow.
+//
+//  returns: false on overflow
+static bool addArray(size_t* size, size_t const count, size_t const each) {
+    if (each && count > SIZE_MAX / each) return false;
+    size_t const n = count * each;
+    if (n > SIZE_MAX - FE_CACHE_LINE + 1) return false;
+    if (alignUp(n) > SIZE_MAX - *size) return false;
+    *size += alignUp(n);
+    return true;
+}
+
+size_t helperDataBlockSize(const HelperData *const h) {
+    size_t size = 0;
+    if (!addArray(&size, h->numHelpers, h->cipherLen)) return 0;
+    if (!h->seeded) {
+        if (!addArray(&size, h->numHelpers, helperSelectorLen(h)) ||
+            !addArray(&size, h->numHelpers, h->nonceLen)) return 0;
+    }
+    return size ? size : FE_CACHE_LINE;
+}
+
 void initHelperData(HelperData *const h) {
     if(!h) return;
     h->nonces  = 0;
     h->masks   = 0;
     h->ciphers = 0;
+    h->indices = 0;
+    h->sampleBits = 0;
+    h->block   = 0;
+    h->blockSize = 0;
+    h->seeded    = false;
+    h->readOnly  = false;
+    h->mapping   = 0;
+    h->mappingSize = 0;
 }
 
-void allocateHelperData(HelperData *const h, size_t const length, size_t const cipherLen, size_t const numHelpers) {
-    if(!h) return;
+//  Picks random nonces and masks (or indices) for helpers first to
+//  h->numHelpers - 1 and empties their ciphers. Seeded helper data derives
+//  them from the seed, so only the ciphers are touched.
+static void randomizeHelpers(HelperData *const h, size_t const first) {
+    size_t const count = h->numHelpers - first;
+    if (!h->seeded) {
+        randombytes_buf(helperNonce(h, first), count * h->nonceLen);
+        if (h->sampleBits) {
+            byte random[8 * h->sampleBits];
+            for (size_t i = first; i < h->numHelpers; i++) {
+                randombytes_buf(random, sizeof(random));
+                feSampleIndices(helperIndices(h, i), h->sampleBits, h->length * 8, random);
+            }
+        }
+        else {
+            randombytes_buf(helperMask(h, first), count * h->length);
+        }
+    }
+    memset(helperCipher(h, first), 0, count * h->cipherLen);
+}
+
+static int allocateHelperBlock(HelperData *const h, size_t const length, size_t const cipherLen,
+        size_t const numHelpers, size_t const sampleBits, bool const seeded) {
+    if(!h) return -1;
+    if(sampleBits > length * 8) {
+        printf("Error in allocateHelperData: more sample bits than the value has.\n");
+        return -2;
+    }
 
     h->length = length;
     h->nonceLen = crypto_pwhash_SALTBYTES; // fixed due to libsodiums Argon2 implementation
     h->cipherLen = cipherLen;
     h->numHelpers = numHelpers;
+    h->sampleBits = sampleBits;
+    h->seeded = seeded;
+    initLockerParams(&h->locker, LOCKER_ARGON2ID);
+
+    h->blockSize = helperDataBlockSize(h);
+    h->block = h->blockSize ? allocAligned(h->blockSize) : 0;
+    if(!h->block) {
+        printf("Error in allocateHelperData: malloc failed.\n");
+        initHelperData(h);
+        return -1;
+    }
+    layoutHelperData(h);
+
+    if (seeded) {
+        randombytes_buf(h->seed, sizeof(h->seed));
+    }
+    randomizeHelpers(h, 0);
+    return 0;
+}
 
-    h->nonces  = (byte**)malloc(numHelpers * sizeof(byte*));
-    h->masks   = (byte**)malloc(numHelpers * sizeof(byte*));
-    h->ciphers = (byte**)malloc(numHelpers * sizeof(byte*));
-    for (size_t i = 0; i < numHelpers; i++)
-    {
-        h->nonces[i]  = (byte*)malloc(h->nonceLen * sizeof(byte));
-        h->masks[i]   = (byte*)malloc(length * sizeof(byte));
-        h->ciphers[i] = (byte*)malloc(cipherLen * sizeof(byte));
-
-        if(!(h->nonces[i] && h->masks[i] && h->ciphers[i])) {
-            printf("Error in initHelperData: malloc failed.\n");
+int allocateHelperData(HelperData *const h, size_t const length, size_t const cipherLen, size_t const numHelpers) {
+    return allocateHelperBlock(h, length, cipherLen, numHelpers, 0, false);
+}
+
+int allocateSeededHelperData(HelperData *const h, size_t const length, size_t const cipherLen, size_t const numHelpers) {
+    return allocateHelperBlock(h, length, cipherLen, numHelpers, 0, true);
+}
+
+int allocateSampledHelperData(HelperData *const h, size_t const length, size_t const cipherLen,
+        size_t const numHelpers, size_t const sampleBits, bool const seeded) {
+    return allocateHelperBlock(h, length, cipherLen, numHelpers, sampleBits, seeded);
+}
+
+//  Expands the seed of h into nonce and mask (or indices) of helper i. The
+//  helper index is the ChaCha20 nonce, so every helper gets an independent
+//  keystream:  [nonce | mask]  or  [nonce | 8 bytes per sampled index]
+static void expandHelper(const HelperData *const h, size_t const i, byte mask[], uint32_t indices[],
+        byte nonce[]) {
+    byte stream[h->nonceLen + (h->sampleBits ? 8 * h->sampleBits : h->length)];
+    byte n[crypto_stream_chacha20_NONCEBYTES];
+    uint64_t index = (uint64_t)i;
+    for (size_t j = 0; j < sizeof(n); j++) {
+        n[j] = (byte)(index >> (8 * j));
+    }
+    crypto_stream_chacha20(stream, sizeof(stream), n, h->seed);
+    memcpy(nonce, stream, h->nonceLen);
+    if (h->sampleBits) {
+        feSampleIndices(indices, h->sampleBits, h->length * 8, stream + h->nonceLen);
+    }
+    else {
+        memcpy(mask, stream + h->nonceLen, h->length);
+    }
+    sodium_memzero(stream, sizeof(stream));
+}
+
+//  What a locker hashes: the value masked with mask, or the bits of the
+//  value at indices for sampled helper data.
+typedef struct {
+    const byte* mask;
+    const uint32_t* indices;
+    const byte* nonce;
+} LockerSelector;
+
+//  Number of uint32_t a caller provides to helperSelector() for derived
+//  masks or indices.
+static size_t selectorWords(const HelperData *const h) {
+    size_t words = h->sampleBits ? h->sampleBits : (h->length + 3) / 4;
+    return words ? words : 1;
+}
+
+//  Gets mask (or indices) and nonce of helper i without copying stored
+//  values: for seeded helper data they are derived into the given buffers,
+//  otherwise the pointers refer to the block.
+static void helperSelector(const HelperData *const h, size_t const i, uint32_t selBuf[], byte nonceBuf[],
+        LockerSelector *const sel) {
+    if (h->seeded) {
+        expandHelper(h, i, (byte*)selBuf, selBuf, nonceBuf);
+        sel->mask = (const byte*)selBuf;
+        sel->indices = selBuf;
+        sel->nonce = nonceBuf;
+    }
+    else {
+        sel->mask = h->masks ? helperMask(h, i) : 0;
+        sel->indices = h->indices ? helperIndices(h, i) : 0;
+        sel->nonce = helperNonce(h, i);
+    }
+}
+
+//  Writes the helperInputLen(h) bytes a locker hashes for value.
+static void lockerInput(const HelperData *const h, const LockerSelector *const sel,
+        const byte value[], byte vector[]) {
+    if (h->sampleBits) {
+        feSampleBits(value, sel->indices, h->sampleBits, vector);
+    }
+    else {
+        feMaskAnd(vector, value, sel->mask, h->length);
+    }
+}
+
+void getHelperMaskNonce(const HelperData *const h, size_t const i, unsigned char mask[], unsigned char nonce[]) {
+    if (!h || i >= h->numHelpers) return;
+    if (!h->sampleBits) {
+        if (h->seeded) {
+            expandHelper(h, i, mask, 0, nonce);
             return;
         }
+        memcpy(mask, helperMask(h, i), h->length);
+        memcpy(nonce, helperNonce(h, i), h->nonceLen);
+        return;
+    }
+
+    uint32_t selBuf[selectorWords(h)];
+    LockerSelector sel;
+    helperSelector(h, i, selBuf, nonce, &sel);
+    //  Seeded selectors are expanded into nonce already.
+    if (sel.nonce != nonce) memcpy(nonce, sel.nonce, h->nonceLen);
+    memset(mask, 0, h->length);
+    for (size_t j = 0; j < h->sampleBits; j++) {
+        mask[sel.indices[j] / 8] |= (byte)(1 << (sel.indices[j] % 8));
+    }
+}
+
+int copyHelperData(HelperData *const dst, const HelperData *const src) {
+    if(!dst || !src || !src->block) return -1;
+
+    freeHelperData(dst);
+    *dst = *src;
+    dst->readOnly = false;
+    dst->mapping = 0;
+    dst->mappingSize = 0;
+    dst->block = allocAligned(src->blockSize);
+    if(!dst->block) {
+        printf("Error in copyHelperData: malloc failed.\n");
+        initHelperData(dst);
+        return -1;
+    }
+    memcpy(dst->block, src->block, src->blockSize);
+    layoutHelperData(dst);
+    return 0;
+}
+
+int growHelperData(HelperData *const dst, const HelperData *const src, size_t const numHelpers) {
+    if(!dst || !src || !src->block) return -1;
+    if(numHelpers < src->numHelpers) {
+        printf("Error in growHelperData: cannot remove helpers.\n");
+        return -2;
+    }
+
+    //  The arrays move when the block grows, so they are copied one by one.
+    HelperData grown = *src;
+    grown.readOnly = false;
+    grown.mapping = 0;
+    grown.mappingSize = 0;
+    grown.numHelpers = numHelpers;
+    grown.blockSize = helperDataBlockSize(&grown);
+    grown.block = grown.blockSize ? allocAligned(grown.blockSize) : 0;
+    if(!grown.block) {
+        printf("Error in growHelperData: malloc failed.\n");
+        return -1;
+    }
+    layoutHelperData(&grown);
 
-        randombytes_buf(h->nonces[i], h->nonceLen);
-        randombytes_buf(h->masks[i], length);
-        for (size_t j = 0; j < cipherLen; j++)   h->ciphers[i][j] = 0;
+    size_t const old = src->numHelpers;
+    memcpy(grown.ciphers, src->ciphers, old * src->cipherLen);
+    if (!src->seeded) {
+        memcpy(grown.nonces, src->nonces, old * src->nonceLen);
+        if (src->sampleBits) {
+            memcpy(grown.indices, src->indices, old * src->sampleBits * sizeof(uint32_t));
+        }
+        else {
+            memcpy(grown.masks, src->masks, old * src->length);
+        }
     }
+    randomizeHelpers(&grown, old);
+
+    freeHelperData(dst);
+    *dst = grown;
+    return 0;
 }
 
 void freeHelperData(HelperData *const h) {
     if(!h) return;
-    if(!(h->nonces && h->masks && h->ciphers)) {
+    if(!h->block) {
         // printf("freeHelperData: nullptr in struct - abort.\n");
         return;
     }
-    
-    for (size_t i = 0; i < h->numHelpers; i++) {
-        free(h->nonces[i]);  h->nonces[i] = 0;
-        free(h->masks[i]);   h->masks[i] = 0;
-        free(h->ciphers[i]); h->ciphers[i] = 0;
+
+    if (h->mapping) {
+        unmapHelperDataFile(h->mapping, h->mappingSize);
+    }
+    else if (!h->readOnly) {
+        freeAligned(h->block);
     }
-    free(h->nonces);  h->nonces = 0;
-    free(h->masks);   h->masks = 0;
-    free(h->ciphers); h->ciphers = 0;
+    initHelperData(h);
 }
 
 void printHelperData(HelperData *const h, bool const printArrays) {
@@ -87,26 +372,37 @@ void printHelperData(HelperData *const h, bool const printArrays) {
     printf("Nonce Length: %d\n", h->nonceLen);
     printf("Cipher Length: %d\n", h->cipherLen);
     printf("# of helpers: %d\n", h->numHelpers);
+    if(h->sampleBits) printf("Sample bits: %zu\n", h->sampleBits);
+    printf("Locker: %s (ops %llu, mem %zu)\n", lockerName(h->locker.algorithm),
+            (unsigned long long)h->locker.opslimit, h->locker.memlimit);
 
-    size_t size = sizeof(unsigned char) * h->numHelpers * (h->length + h->cipherLen + h->nonceLen) +
-            sizeof(size_t) * 4 + sizeof(unsigned char**) * 3;
-    size_t sizeofh = sizeof(h);
+    size_t size = h->blockSize + sizeof(HelperData);
     printf("\nHelper data size: %d\n", size);
     
+    if(h->seeded) {
+        printf("Seed: ");
+        for (size_t j = 0; j < sizeof(h->seed); j++) printf("%d ", h->seed[j]);
+        printf("\n");
+    }
+
     if(printArrays) {
+        byte mask[h->length];
+        byte nonce[h->nonceLen];
         printf("Nonces:\n");
         for (size_t i = 0; i < h->numHelpers; i++) {
-            for (size_t j = 0; j < h->nonceLen; j++) printf("%d ", h->nonces[i][j]);
+            getHelperMaskNonce(h, i, mask, nonce);
+            for (size_t j = 0; j < h->nonceLen; j++) printf("%d ", nonce[j]);
             printf("\n");
         }
         printf("\nmasks:\n");
         for (size_t i = 0; i < h->numHelpers; i++) {
-            for (size_t j = 0; j < h->length; j++) printf("%d ", h->masks[i][j]);
+            getHelperMaskNonce(h, i, mask, nonce);
+            for (size_t j = 0; j < h->length; j++) printf("%d ", mask[j]);
             printf("\n");
         }
         printf("\nciphers:\n");
         for (size_t i = 0; i < h->numHelpers; i++) {
-            for (size_t j = 0; j < h->cipherLen; j++) printf("%d ", h->ciphers[i][j]);
+            for (size_t j = 0; j < h->cipherLen; j++) printf("%d ", helperCipher(h, i)[j]);
             printf("\n");
         }
     }
@@ -124,6 +420,9 @@ void initFEProperties(FEProperties *const p, size_t const length, size_t const h
     p->repErr = repErr;
     p->secLen = 2;      // fixed for now until further testing is needed
     p->nonceLen = crypto_pwhash_SALTBYTES;   // (16) fixed due to libsodium's Argon2 implementation
+    p->seeded = false;
+    p->sampleBits = 0;
+    initLockerParams(&p->locker, LOCKER_ARGON2ID);
 
     // Calculate the number of helper values needed to be able to reproduce
     // keys given ham_err and rep_err. See "Reusable Fuzzy Extractors for
@@ -136,6 +435,43 @@ void initFEProperties(FEProperties *const p, size_t const length, size_t const h
     p->numHelpers = (size_t)round(helpers);
 }
 
+void initFESampledProperties(FEProperties *const p, size_t const length, size_t const hamErr,
+        double const repErr, size_t const sampleBits) {
+    initFEProperties(p, length, hamErr, repErr);
+    if(!p || sampleBits == 0 || sampleBits > length * 8) return;
+
+    // A locker opens if none of the wrong bits is sampled:
+    // (1 - P(open))^numHelpers <= repErr
+    p->sampleBits = sampleBits;
+    double open = feSampleOpenProbability(length * 8, hamErr, sampleBits, 0);
+    if (open >= 1.0) {
+        p->numHelpers = 1;
+    }
+    else if (open <= 0.0) {
+        //  Every locker samples a wrong bit; feGenerate() rejects this.
+        printf("initFESampledProperties error: every sample of %zu bits hits one of %zu wrong bits.\n",
+                sampleBits, hamErr);
+        p->numHelpers = 0;
+    }
+    else {
+        p->numHelpers = (size_t)ceil(log(repErr) / log1p(-open));
+    }
+}
+
+int feSetSecLen(FEProperties *const p, size_t const secLen) {
+    if (!p) {
+        printf("feSetSecLen error: nullptr argument.\n");
+        return -1;
+    }
+    if (secLen == 0 || secLen > FE_MAX_SEC_LEN) {
+        printf("feSetSecLen error: secLen must be 1 to %d bytes.\n", FE_MAX_SEC_LEN);
+        return -2;
+    }
+    p->secLen = secLen;
+    p->cipherLen = p->length + secLen;
+    return 0;
+}
+
 void printFEProperties(FEProperties *const p) {
     if(!p) return;
 
@@ -147,73 +483,283 @@ void printFEProperties(FEProperties *const p) {
     printf("Nonce Len: %d\n", p->nonceLen);
     printf("Cipher Len: %d\n", p->cipherLen);
     printf("# of helpers: %d\n", p->numHelpers);
+    printf("Seeded: %s\n", p->seeded ? "yes" : "no");
+    printf("Sample bits: %zu\n", p->sampleBits);
+    printf("Locker: %s (ops %llu, mem %zu)\n", lockerName(p->locker.algorithm),
+            (unsigned long long)p->locker.opslimit, p->locker.memlimit);
 }
 
 
 /**********************************************************/
 
 
-int feGenerate(const unsigned char value[], unsigned char key[], 
+//  Locks key_padded into locker i of h: the value is masked with the i-th mask,
+//  hashed and the digest is XOR'd with the padded key.
+//
+//  returns: 0 on success, negative int on error
+static int lockLocker(const byte value[], const byte key_padded[], HelperData *const h, size_t const i) {
+    byte vector[helperInputLen(h)];
+    uint32_t selBuf[selectorWords(h)];
+    byte nonceBuf[h->nonceLen];
+    LockerSelector sel;
+    byte* cipher = helperCipher(h, i);
+    helperSelector(h, i, selBuf, nonceBuf, &sel);
+
+    //  By masking the value with random masks, we adjust the probability that given
+    //  another noisy reading of the same source, enough bits will match for the new
+    //  reading & mask to equal the old reading & mask. Sampled helper data only
+    //  keeps the bits at its indices, which has the same effect with a short input.
+    lockerInput(h, &sel, value, vector);
+
+    //  The "digital locker" is a simple crypto primitive made by hashing a "key"
+    //  xor a "value". The only efficient way to get the value back is to know
+    //  the key, which can then be hashed again xor the ciphertext. This is referred
+    //  to as locking and unlocking the digital locker, respectively.
+    // 
+    //  C. Yagemann's implementation uses PBKDF2_HMAC for key derivation.
+    //  Here, the more modern and robust Argon2 is used by default; the hash
+    //  is selected by h->locker (see Locker.h).
+
+    FE_STATS_TIMER(start);
+    if (lockerHash(&h->locker, cipher, h->cipherLen, vector, sizeof(vector), sel.nonce) != 0) {
+        return -3;
+    }
+    FE_STATS_RECORD(FE_HIST_LOCKER, FE_STATS_SINCE(start));
+
+    feXor(cipher, cipher, key_padded, h->cipherLen);
+    return 0;
+}
+
+//  Common start of feGenerate() and feGenerateParallel(): checks the arguments,
+//  allocates fresh helper data and produces a random key and its padded form.
+static int prepareGenerate(const char* caller, const byte value[], byte key[], byte key_padded[],
         const size_t len, HelperData *const h, const FEProperties *const p) {
     if (!value || !key || !h || !p) {
-        printf("feGenerate error: nullptr argument.\n");
+        printf("%s error: nullptr argument.\n", caller);
         return -1;
     }
     if (p->length != len) {
-        printf("feGenerate error: cannot produce key for value of different length.\n");
+        printf("%s error: cannot produce key for value of different length.\n", caller);
+        return -2;
+    }
+    if (!lockerParamsValid(&p->locker)) {
+        printf("%s error: invalid locker parameters.\n", caller);
+        return -2;
+    }
+    if (p->sampleBits > len * 8) {
+        printf("%s error: more sample bits than the value has.\n", caller);
+        return -2;
+    }
+    if (p->numHelpers == 0) {
+        printf("%s error: properties allow no locker to open.\n", caller);
+        return -2;
+    }
+    if (p->secLen == 0 || p->secLen > FE_MAX_SEC_LEN || p->cipherLen != p->length + p->secLen) {
+        printf("%s error: cipherLen does not match secLen, use feSetSecLen().\n", caller);
         return -2;
     }
 
     freeHelperData(h);
-    allocateHelperData(h, p->length, p->cipherLen, p->numHelpers);
+    int ret = allocateSampledHelperData(h, p->length, p->cipherLen, p->numHelpers, p->sampleBits, p->seeded);
+    if (ret != 0) {
+        printf("%s error: could not allocate helper data.\n", caller);
+        return -3;
+    }
+    h->locker = p->locker;
 
     //  Produce a random key. Hold on to this, because this is the key that
     //  is compared to the reproduced fingerprint for authentication.
     randombytes_buf(key, len);
-    byte key_padded[p->length + p->secLen];
     for (size_t i = 0; i < p->length; i++) {
         key_padded[i] = key[i];
     }
     for (size_t i = p->length; i < (p->length + p->secLen); i++) {
         key_padded[i] = 0;
     }
+    return 0;
+}
+
+int feGenerate(const unsigned char value[], unsigned char key[], 
+        const size_t len, HelperData *const h, const FEProperties *const p) {
+    byte key_padded[(p ? p->cipherLen : 1)];
+    FE_STATS_TIMER(start);
+    int ret = prepareGenerate("feGenerate", value, key, key_padded, len, h, p);
+    if (ret != 0) return ret;
 
-    byte vector[p->length];
     for (size_t i = 0; i < p->numHelpers; i++) {
+        if (lockLocker(value, key_padded, h, i) != 0) {
+            printf("feGenerate error: Ran out of memory during hashing.\n");
+            return -3;
+        }
+    }
+    FE_STATS_RECORD(FE_HIST_GENERATE, FE_STATS_SINCE(start));
+    return 0;
+}
 
 
-        //  By masking the value with random masks, we adjust the probability that given
-        //  another noisy reading of the same source, enough bits will match for the new
-        //  reading & mask to equal the old reading & mask.
-        for (size_t j = 0; j < p->length; j++) {
-            vector[j] = value[j] & h->masks[i][j];
-        }
+//  Stability of one mask over the enrollment readings, see feGenerateOrdered().
+typedef struct {
+    size_t stable;
+    size_t index;
+} LockerRank;
 
-        //  The "digital locker" is a simple crypto primitive made by hashing a "key"
-        //  xor a "value". The only efficient way to get the value back is to know
-        //  the key, which can then be hashed again xor the ciphertext. This is referred
-        //  to as locking and unlocking the digital locker, respectively.
-        // 
-        //  C. Yagemann's implementation uses PBKDF2_HMAC for key derivation.
-        //  Here, the more modern and robust Argon2 is used.
-
-        if (crypto_pwhash
-            (h->ciphers[i], p->cipherLen, vector, p->length, h->nonces[i],
-            crypto_pwhash_OPSLIMIT_MIN, crypto_pwhash_MEMLIMIT_MIN,
-            crypto_pwhash_ALG_DEFAULT) != 0) {
-            printf("feGenerate error: Ran out of memory during hashing.\n");
-            return -3;
+static int compareLockerRank(const void* a, const void* b) {
+    const LockerRank* x = (const LockerRank*)a;
+    const LockerRank* y = (const LockerRank*)b;
+    if (x->stable != y->stable) return (x->stable < y->stable) ? 1 : -1;
+    return (x->index > y->index) - (x->index < y->index);
+}
+
+int feGenerateOrdered(const unsigned char readings[], size_t const numReadings, unsigned char key[],
+        const size_t len, HelperData *const h, const FEProperties *const p) {
+    if (!readings || numReadings == 0) {
+        printf("feGenerateOrdered error: no readings.\n");
+        return -1;
+    }
+    if (!key || !h || !p || len == 0) {
+        printf("feGenerateOrdered error: nullptr argument.\n");
+        return -1;
+    }
+    if (p->seeded) {
+        //  Seeded masks are bound to their index and cannot be reordered.
+        printf("feGenerateOrdered error: seeded helper data cannot be ordered.\n");
+        return -2;
+    }
+
+    //  The enrolled value is the per-bit majority of all readings.
+    byte value[len];
+    for (size_t j = 0; j < len; j++) {
+        byte v = 0;
+        for (unsigned bit = 0; bit < 8; bit++) {
+            size_t ones = 0;
+            for (size_t r = 0; r < numReadings; r++) {
+                ones += (readings[r * len + j] >> bit) & 1;
+            }
+            if (2 * ones > numReadings) v |= (byte)(1 << bit);
         }
+        value[j] = v;
+    }
+
+    FE_STATS_TIMER(start);
+    byte key_padded[p->cipherLen];
+    int ret = prepareGenerate("feGenerateOrdered", value, key, key_padded, len, h, p);
+    if (ret != 0) return ret;
 
-        for (size_t j = 0; j < p->cipherLen; j++) {
-            h->ciphers[i][j] = key_padded[j] ^ h->ciphers[i][j];
+    //  Count for every mask how many readings it maps onto the enrolled
+    //  vector, i.e. how many readings would open its locker.
+    size_t selLen = helperSelectorLen(h);
+    byte* selectors = h->sampleBits ? (byte*)h->indices : h->masks;
+    LockerRank* ranks = (LockerRank*)malloc(h->numHelpers * sizeof(LockerRank));
+    byte* saved = (byte*)malloc(h->numHelpers * selLen);
+    if (!ranks || !saved) {
+        printf("feGenerateOrdered error: malloc failed.\n");
+        free(ranks); free(saved);
+        return -3;
+    }
+    byte enrolled[helperInputLen(h)];
+    byte vector[helperInputLen(h)];
+    for (size_t i = 0; i < h->numHelpers; i++) {
+        LockerSelector sel;
+        helperSelector(h, i, 0, 0, &sel);
+        lockerInput(h, &sel, value, enrolled);
+        size_t stable = 0;
+        for (size_t r = 0; r < numReadings; r++) {
+            lockerInput(h, &sel, readings + r * len, vector);
+            stable += (memcmp(vector, enrolled, sizeof(vector)) == 0);
         }
+        ranks[i].stable = stable;
+        ranks[i].index = i;
     }
+    sodium_memzero(enrolled, sizeof(enrolled));
+    sodium_memzero(vector, sizeof(vector));
 
+    //  Place the most stable masks first, so reproduction typically opens
+    //  one of the first lockers.
+    qsort(ranks, h->numHelpers, sizeof(LockerRank), compareLockerRank);
+    memcpy(saved, selectors, h->numHelpers * selLen);
+    for (size_t i = 0; i < h->numHelpers; i++) {
+        memcpy(selectors + i * selLen, saved + ranks[i].index * selLen, selLen);
+    }
+    free(ranks);
+    free(saved);
+
+    for (size_t i = 0; i < h->numHelpers && ret == 0; i++) {
+        ret = lockLocker(value, key_padded, h, i);
+    }
+    sodium_memzero(value, sizeof(value));
+
+    if (ret != 0) {
+        printf("feGenerateOrdered error: Ran out of memory during hashing.\n");
+        return -3;
+    }
+    FE_STATS_RECORD(FE_HIST_GENERATE, FE_STATS_SINCE(start));
     return 0;
 }
 
 
+//  Tries to open locker i of h with the given value. The vector is masked,
+//  hashed and XOR'd with the stored cipher. On success, the unlocked key is
+//  written to key.
+//
+//  returns: 1 if the locker opened, 0 if not, negative int on error
+static int openLocker(const byte value[], byte key[],
+        const HelperData *const h, size_t const i, FEStats *const stats) {
+    (void)stats;    // only used with FE_ENABLE_STATS
+    byte vector[helperInputLen(h)];
+    byte digest[h->cipherLen];
+    uint32_t selBuf[selectorWords(h)];
+    byte nonceBuf[h->nonceLen];
+    LockerSelector sel;
+    const byte* cipher = helperCipher(h, i);
+    helperSelector(h, i, selBuf, nonceBuf, &sel);
+
+    FE_STATS_TIMER(start);
+    lockerInput(h, &sel, value, vector);
+    FE_STATS_ADD(stats, maskNs, FE_STATS_SINCE(start));
+
+    FE_STATS_TIMER(hashStart);
+    if (lockerHash(&h->locker, digest, h->cipherLen, vector, sizeof(vector), sel.nonce) != 0) {
+        return -3;
+    }
+    FE_STATS_ADD(stats, hashNs, FE_STATS_SINCE(hashStart));
+    FE_STATS_RECORD(FE_HIST_LOCKER, FE_STATS_SINCE(hashStart));
+
+    //  When the key was stored in the digital locker, extra null bytes were added
+    //  onto the end, which makes it easy to detect if we've successfully unlocked
+    //  the locker.
+    if (!feXorIsZero(digest + h->length, cipher + h->length, h->cipherLen - h->length)) {
+        return 0;
+    }
+    feXor(key, digest, cipher, h->length);
+    return 1;
+}
+
+
+int feTryLocker(const unsigned char value[], unsigned char key[], const HelperData *const h, size_t const i) {
+    if (!value || !key || !h || i >= h->numHelpers) return -1;
+    return openLocker(value, key, h, i, 0);
+}
+
+//  Tries the lockers of h in index order until one opens. stats may be null.
+//
+//  returns: 1 if a locker opened, 0 if not, negative int on error
+static int reproduceSequential(const byte value[], byte key[], const HelperData *const h,
+        FEStats *const stats) {
+    FE_STATS_TIMER(start);
+    int ret = 0;
+    size_t i = 0;
+    for (; i < h->numHelpers && ret == 0; i++) {
+        ret = openLocker(value, key, h, i, stats);
+    }
+
+    if (stats) {
+        stats->lockersTried = i;
+        stats->openedIndex = (ret == 1) ? (int64_t)i - 1 : -1;
+    }
+    FE_STATS_RECORD(FE_HIST_REPRODUCE, FE_STATS_SINCE(start));
+    return ret;
+}
+
 int feReproduce(const unsigned char value[], unsigned char key[],
         const size_t len, const HelperData *const h) {
     if (!value || !key || !h) {
@@ -225,47 +771,475 @@ int feReproduce(const unsigned char value[], unsigned char key[],
         return -2;
     }
 
-    byte vector[h->length];
-    byte digest[h->cipherLen];
-    byte plain[h->cipherLen];
+    int ret = reproduceSequential(value, key, h, 0);
+
+    if (ret < 0) {
+        printf("feReproduce error: Ran out of memory during hashing.\n");
+        return ret;
+    }
+    if (ret == 1) {
+        // printf("feReproduce: SUCCESS.\n");
+        return 0;
+    }
+
+    // printf("feReproduce: FAIL. The value does not match.\n");
+    // TODO: determine behaviour
+    // return -4;
+    return 0;   // returning 0 tells the unit test that reproducing was ok, but the key delivered is still wrong
+}
+
+
+int feReproduceStats(const unsigned char value[], unsigned char key[],
+        const size_t len, const HelperData *const h, FEStats *const stats) {
+    if (!value || !key || !h || !stats) {
+        printf("feReproduceStats error: nullptr argument.\n");
+        return -1;
+    }
+    initFEStats(stats);
+    if (h->length != len) {
+        printf("feReproduceStats error: cannot produce key for value of different length.\n");
+        return -2;
+    }
+
+    int ret = reproduceSequential(value, key, h, stats);
+    if (ret < 0) {
+        printf("feReproduceStats error: Ran out of memory during hashing.\n");
+        return ret;
+    }
+    return (ret == 1) ? 0 : -4;
+}
 
-    for (size_t i = 0; i < h->numHelpers; i++) {
-        for (size_t j = 0; j < h->length; j++) {
-            vector[j] = value[j] & h->masks[i][j];
-        }
 
-        if (crypto_pwhash
-            (digest, h->cipherLen, vector, h->length, h->nonces[i],
-            crypto_pwhash_OPSLIMIT_MIN, crypto_pwhash_MEMLIMIT_MIN,
-            crypto_pwhash_ALG_DEFAULT) != 0) {
-            printf("feReproduce error: Ran out of memory during hashing.\n");
+static int compareSize(const void* a, const void* b) {
+    size_t x = *(const size_t*)a;
+    size_t y = *(const size_t*)b;
+    return (x > y) - (x < y);
+}
+
+int feReproduceHinted(const unsigned char value[], unsigned char key[], const size_t len,
+        const HelperData *const h, const size_t hints[], size_t const numHints, FEStats *const stats) {
+    if (!value || !key || !h || (!hints && numHints)) {
+        printf("feReproduceHinted error: nullptr argument.\n");
+        return -1;
+    }
+    FEStats local;
+    FEStats *const st = stats ? stats : &local;
+    initFEStats(st);
+    if (h->length != len) {
+        printf("feReproduceHinted error: cannot produce key for value of different length.\n");
+        return -2;
+    }
+    size_t* tried = 0;
+    if (numHints) {
+        tried = (size_t*)malloc(numHints * sizeof(size_t));
+        if (!tried) {
+            printf("feReproduceHinted error: malloc failed.\n");
             return -3;
         }
+    }
 
-        //  When the key was stored in the digital locker, extra null bytes were added
-        //  onto the end, which makes it easy to detect if we've successfully unlocked
-        //  the locker.
-        for (size_t j = 0; j < h->cipherLen; j++) {
-            plain[j] = digest[j] ^ h->ciphers[i][j];
+    FE_STATS_TIMER(start);
+    int ret = 0;
+    size_t numTried = 0;
+    int64_t opened = -1;
+
+    //  Hints first, in the given order. Invalid and repeated ones are skipped.
+    for (size_t k = 0; k < numHints && ret == 0; k++) {
+        size_t i = hints[k];
+        bool seen = (i >= h->numHelpers);
+        for (size_t j = 0; j < numTried && !seen; j++) {
+            seen = (tried[j] == i);
         }
+        if (seen) continue;
+        tried[numTried++] = i;
+        ret = openLocker(value, key, h, i, st);
+        if (ret == 1) opened = (int64_t)i;
+    }
+    st->lockersTried = numTried;
 
-        int sum = 0;
-        for (size_t s = h->length; s < h->cipherLen; s++) {
-            sum += plain[s];
+    //  Then all other lockers in index order.
+    if (ret == 0) {
+        if (numTried) qsort(tried, numTried, sizeof(size_t), compareSize);
+        size_t next = 0;
+        for (size_t i = 0; i < h->numHelpers && ret == 0; i++) {
+            if (next < numTried && tried[next] == i) {
+                next++;
+                continue;
+            }
+            ret = openLocker(value, key, h, i, st);
+            st->lockersTried++;
+            if (ret == 1) opened = (int64_t)i;
         }
+    }
+    free(tried);
+    st->openedIndex = opened;
+    FE_STATS_RECORD(FE_HIST_REPRODUCE, FE_STATS_SINCE(start));
+
+    if (ret < 0) {
+        printf("feReproduceHinted error: Ran out of memory during hashing.\n");
+        return ret;
+    }
+    return (ret == 1) ? 0 : -4;
+}
 
-        if (sum == 0) {
-            // printf("feReproduce: SUCCESS.\n");
-            for (size_t j = 0; j < h->length; j++) {
-                key[j] = plain[j];
+//  Masked vector of one pending reading in feReproduceBatch().
+typedef struct {
+    const byte* vector;
+    size_t reading;
+    size_t length;
+} BatchEntry;
+
+static int compareBatchEntry(const void* a, const void* b) {
+    const BatchEntry* x = (const BatchEntry*)a;
+    const BatchEntry* y = (const BatchEntry*)b;
+    int c = memcmp(x->vector, y->vector, x->length);
+    if (c != 0) return c;
+    return (x->reading > y->reading) - (x->reading < y->reading);
+}
+
+int feReproduceBatch(const unsigned char values[], size_t const numValues, unsigned char keys[],
+        int results[], const size_t len, const HelperData *const h) {
+    if (!values || !keys || !results || !h) {
+        printf("feReproduceBatch error: nullptr argument.\n");
+        return -1;
+    }
+    if (h->length != len) {
+        printf("feReproduceBatch error: cannot produce key for value of different length.\n");
+        return -2;
+    }
+    if (numValues == 0) return 0;
+
+    size_t inLen = helperInputLen(h);
+    byte* vectors = (byte*)malloc(numValues * inLen);
+    size_t* pending = (size_t*)malloc(numValues * sizeof(size_t));
+    BatchEntry* entries = (BatchEntry*)malloc(numValues * sizeof(BatchEntry));
+    if (!vectors || !pending || !entries) {
+        printf("feReproduceBatch error: malloc failed.\n");
+        free(vectors); free(pending); free(entries);
+        return -3;
+    }
+
+    size_t numPending = numValues;
+    for (size_t m = 0; m < numValues; m++) {
+        pending[m] = m;
+        results[m] = -4;
+    }
+
+    uint32_t selBuf[selectorWords(h)];
+    byte nonceBuf[h->nonceLen];
+    byte digest[h->cipherLen];
+    int ret = 0;
+
+    //  Lockers are tried in index order for every reading, so each reading
+    //  opens the same locker it would open in feReproduce(). Per locker, all
+    //  readings with the same masked vector share one hash.
+    for (size_t i = 0; i < h->numHelpers && numPending > 0 && ret == 0; i++) {
+        LockerSelector sel;
+        const byte* cipher = helperCipher(h, i);
+        helperSelector(h, i, selBuf, nonceBuf, &sel);
+
+        for (size_t n = 0; n < numPending; n++) {
+            byte* vector = vectors + n * inLen;
+            lockerInput(h, &sel, values + pending[n] * len, vector);
+            entries[n].vector = vector;
+            entries[n].reading = pending[n];
+            entries[n].length = inLen;
+        }
+        qsort(entries, numPending, sizeof(BatchEntry), compareBatchEntry);
+
+        size_t kept = 0;
+        for (size_t first = 0; first < numPending; ) {
+            size_t last = first + 1;
+            while (last < numPending && memcmp(entries[first].vector, entries[last].vector, inLen) == 0) {
+                last++;
             }
-            return 0;
+
+            ret = lockerHash(&h->locker, digest, h->cipherLen, entries[first].vector, inLen, sel.nonce);
+            if (ret != 0) break;
+
+            bool opened = feXorIsZero(digest + len, cipher + len, h->cipherLen - len);
+            for (size_t e = first; e < last; e++) {
+                size_t m = entries[e].reading;
+                if (opened) {
+                    feXor(keys + m * len, digest, cipher, len);
+                    results[m] = 0;
+                }
+                else {
+                    pending[kept++] = m;
+                }
+            }
+            first = last;
         }
+        if (ret == 0) numPending = kept;
     }
 
-    // printf("feReproduce: FAIL. The value does not match.\n");
-    // TODO: determine behaviour
-    // return -4;
-    return 0;   // returning 0 tells the unit test that reproducing was ok, but the key delivered is still wrong
+    sodium_memzero(vectors, numValues * inLen);
+    free(vectors);
+    free(pending);
+    free(entries);
+
+    if (ret != 0) {
+        printf("feReproduceBatch error: Ran out of memory during hashing.\n");
+        return -3;
+    }
+    return 0;
 }
 
+
+/**********************************************************/
+
+
+size_t feNumCPUs(void) {
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    long n = (long)info.dwNumberOfProcessors;
+#else
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+    return (n > 0) ? (size_t)n : 1;
+}
+
+//  State shared by all workers of one feReproduceParallel() call.
+//  Helper indices are handed out in increasing order under lock. opened holds
+//  the lowest index that opened so far; no index above it is handed out
+//  anymore, which cancels the remaining workers.
+typedef struct {
+    const byte* value;
+    const HelperData* h;
+    byte* key;
+
+    pthread_mutex_t lock;
+    size_t next;
+    size_t opened;
+    int error;
+} ReproduceJob;
+
+static void* reproduceWorker(void* arg) {
+    ReproduceJob *const job = (ReproduceJob*)arg;
+    byte key[job->h->length];
+
+    for (;;) {
+        pthread_mutex_lock(&job->lock);
+        size_t i = job->next;
+        if (i >= job->opened || job->error) {
+            pthread_mutex_unlock(&job->lock);
+            break;
+        }
+        job->next++;
+        pthread_mutex_unlock(&job->lock);
+
+        int ret = openLocker(job->value, key, job->h, i, 0);
+        if (ret == 0) continue;
+
+        pthread_mutex_lock(&job->lock);
+        if (ret < 0) {
+            job->error = ret;
+        }
+        else if (i < job->opened) {
+            //  A worker may open a locker after another worker already opened
+            //  one with a higher index. Keep the lowest one, so the key is
+            //  the same the sequential feReproduce() would deliver.
+            job->opened = i;
+            memcpy(job->key, key, job->h->length);
+        }
+        pthread_mutex_unlock(&job->lock);
+    }
+    return NULL;
+}
+
+int feReproduceParallel(const unsigned char value[], unsigned char key[],
+        const size_t len, const HelperData *const h, size_t numThreads) {
+    if (!value || !key || !h) {
+        printf("feReproduceParallel error: nullptr argument.\n");
+        return -1;
+    }
+    if (h->length != len) {
+        printf("feReproduceParallel error: cannot produce key for value of different length.\n");
+        return -2;
+    }
+
+    if (numThreads == 0) numThreads = feNumCPUs();
+    if (numThreads > h->numHelpers) numThreads = h->numHelpers;
+    if (numThreads <= 1) return feReproduce(value, key, len, h);
+
+    FE_STATS_TIMER(start);
+    byte found[h->length];
+    ReproduceJob job;
+    job.value = value;
+    job.h = h;
+    job.key = found;
+    job.next = 0;
+    job.opened = h->numHelpers;
+    job.error = 0;
+    pthread_mutex_init(&job.lock, NULL);
+
+    //  The calling thread is one of the workers.
+    pthread_t threads[numThreads - 1];
+    size_t started = 0;
+    for (; started < numThreads - 1; started++) {
+        if (pthread_create(&threads[started], NULL, reproduceWorker, &job) != 0) break;
+    }
+    reproduceWorker(&job);
+    for (size_t t = 0; t < started; t++) {
+        pthread_join(threads[t], NULL);
+    }
+    pthread_mutex_destroy(&job.lock);
+    FE_STATS_RECORD(FE_HIST_REPRODUCE, FE_STATS_SINCE(start));
+
+    if (job.error) {
+        printf("feReproduceParallel error: Ran out of memory during hashing.\n");
+        return job.error;
+    }
+    if (job.opened < h->numHelpers) {
+        memcpy(key, found, h->length);
+    }
+
+    // Same as feReproduce(): a value that does not match returns 0, but the
+    // key is left untouched.
+    return 0;
+}
+
+
+//  State shared by all workers of one feGenerateParallel() call. Each worker
+//  takes the next unfilled helper index, so every slot is written by exactly
+//  one thread.
+typedef struct {
+    const byte* value;
+    const byte* key_padded;
+    HelperData* h;
+
+    pthread_mutex_t lock;
+    size_t next;
+    int error;
+} GenerateJob;
+
+static void* generateWorker(void* arg) {
+    GenerateJob *const job = (GenerateJob*)arg;
+
+    for (;;) {
+        pthread_mutex_lock(&job->lock);
+        size_t i = job->next;
+        if (i >= job->h->numHelpers || job->error) {
+            pthread_mutex_unlock(&job->lock);
+            break;
+        }
+        job->next++;
+        pthread_mutex_unlock(&job->lock);
+
+        int ret = lockLocker(job->value, job->key_padded, job->h, i);
+        if (ret != 0) {
+            pthread_mutex_lock(&job->lock);
+            job->error = ret;
+            pthread_mutex_unlock(&job->lock);
+        }
+    }
+    return NULL;
+}
+
+int feGenerateParallel(const unsigned char value[], unsigned char key[], 
+        const size_t len, HelperData *const h, const FEProperties *const p, size_t numThreads) {
+    byte key_padded[(p ? p->cipherLen : 1)];
+    FE_STATS_TIMER(start);
+    int ret = prepareGenerate("feGenerateParallel", value, key, key_padded, len, h, p);
+    if (ret != 0) return ret;
+
+    if (numThreads == 0) numThreads = feNumCPUs();
+    if (numThreads > h->numHelpers) numThreads = h->numHelpers;
+    if (numThreads == 0) numThreads = 1;
+
+    GenerateJob job;
+    job.value = value;
+    job.key_padded = key_padded;
+    job.h = h;
+    job.next = 0;
+    job.error = 0;
+    pthread_mutex_init(&job.lock, NULL);
+
+    //  The calling thread is one of the workers.
+    pthread_t threads[numThreads];
+    size_t started = 0;
+    for (; started < numThreads - 1; started++) {
+        if (pthread_create(&threads[started], NULL, generateWorker, &job) != 0) break;
+    }
+    generateWorker(&job);
+    for (size_t t = 0; t < started; t++) {
+        pthread_join(threads[t], NULL);
+    }
+    pthread_mutex_destroy(&job.lock);
+
+    if (job.error) {
+        printf("feGenerateParallel error: Ran out of memory during hashing.\n");
+        return job.error;
+    }
+    FE_STATS_RECORD(FE_HIST_GENERATE, FE_STATS_SINCE(start));
+    return 0;
+}
+
+
+int feFillLocker(const unsigned char value[], const unsigned char key[],
+        HelperData *const h, size_t const i) {
+    if (!value || !key || !h || i >= h->numHelpers) return -1;
+    if (h->readOnly) return -2;
+
+    byte key_padded[h->cipherLen];
+    memcpy(key_padded, key, h->length);
+    memset(key_padded + h->length, 0, h->cipherLen - h->length);
+    int ret = lockLocker(value, key_padded, h, i);
+    sodium_memzero(key_padded, sizeof(key_padded));
+    return ret;
+}
+
+int feExtend(const unsigned char value[], const unsigned char key[],
+        const size_t len, HelperData *const h, size_t const numHelpers) {
+    if (!value || !key || !h || !h->block) {
+        printf("feExtend error: nullptr argument.\n");
+        return -1;
+    }
+    if (h->length != len) {
+        printf("feExtend error: cannot extend helper data for value of different length.\n");
+        return -2;
+    }
+    if (numHelpers < h->numHelpers) {
+        printf("feExtend error: cannot remove lockers.\n");
+        return -2;
+    }
+    if (numHelpers == h->numHelpers) return 0;
+
+    //  The enrolled value opens every locker. Locking a different key or
+    //  value into the new lockers would silently break reproduction.
+    if (h->numHelpers > 0) {
+        byte opened[len];
+        int ret = openLocker(value, opened, h, 0, 0);
+        bool same = (ret == 1) && sodium_memcmp(opened, key, len) == 0;
+        sodium_memzero(opened, len);
+        if (ret < 0) {
+            printf("feExtend error: Ran out of memory during hashing.\n");
+            return -3;
+        }
+        if (!same) {
+            printf("feExtend error: value and key do not match the helper data.\n");
+            return -2;
+        }
+    }
+
+    HelperData grown;
+    initHelperData(&grown);
+    if (growHelperData(&grown, h, numHelpers) != 0) {
+        printf("feExtend error: could not allocate helper data.\n");
+        return -3;
+    }
+    int ret = 0;
+    for (size_t i = h->numHelpers; i < numHelpers && ret == 0; i++) {
+        ret = feFillLocker(value, key, &grown, i);
+    }
+
+    if (ret != 0) {
+        freeHelperData(&grown);
+        printf("feExtend error: Ran out of memory during hashing.\n");
+        return -3;
+    }
+    freeHelperData(h);
+    *h = grown;
+    return 0;
+}
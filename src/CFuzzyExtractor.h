@@ -28,6 +28,14 @@
 #include <math.h>
 #include <sodium.h>
 #include <assert.h>
+#include <stdint.h>
+
+#include "Locker.h"
+#include "FEStats.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
 
 // TODO:  libsodium wird als Crypto-Library verwendet.
 //        Modern, bietet sicheren RNG und Cryptographie (Pwd-hashing) und ist
@@ -51,6 +59,26 @@
  *  nonces:     Nonces (salts) used during hashing
  *  masks:      Masks that are XOR'd with the values to be hashed.
  *  ciphers:    Ciphers resulting from the hashing algorithm.
+ *  sampleBits: If not 0, every locker samples this many bit positions of
+ *              the value instead of masking it (index-subset sampling).
+ *              masks is null and indices holds the positions.
+ *  indices:    Sorted bit positions sampled by each locker.
+ *  seeded:     If set, nonces and masks (or indices) are not stored (all
+ *              null). They are derived per helper from seed with ChaCha20.
+ *  seed:       Public seed of seeded helper data.
+ *  locker:     Hash backend and cost parameters the lockers were made with.
+ *  block:      Single cache-line aligned allocation holding masks (or
+ *              indices), nonces and ciphers as flat arrays. Copying or persisting the helper
+ *              data is a copy of this block.
+ *  blockSize:  Size in bytes of block.
+ *  readOnly:   Set if block is not owned by h, i.e. it points into a file
+ *              mapping or a caller's buffer (see HelperDataFile.h).
+ *  mapping:    File mapping backing block, released by freeHelperData().
+ *  mappingSize: Size in bytes of mapping.
+ *
+ *  Use helperNonce(), helperMask(), helperIndices() and helperCipher() to access the values
+ *  of a single helper, or getHelperMaskNonce() which also covers seeded
+ *  helper data.
  */
 typedef struct {
     size_t length;
@@ -58,17 +86,129 @@ typedef struct {
     size_t cipherLen;
     size_t numHelpers;
 
-    unsigned char** nonces;      // char[numHelpers][nonceLen]
-    unsigned char** masks;       // char[numHelpers][length]
-    unsigned char** ciphers;     // char[numHelpers][cipherLen]
+    unsigned char* nonces;      // char[numHelpers * nonceLen]
+    unsigned char* masks;       // char[numHelpers * length]
+    unsigned char* ciphers;     // char[numHelpers * cipherLen]
+
+    size_t sampleBits;
+    uint32_t* indices;          // uint32_t[numHelpers * sampleBits]
+
+    bool seeded;
+    unsigned char seed[32];
+    LockerParams locker;
+
+    void* block;
+    size_t blockSize;
+
+    bool readOnly;
+    void* mapping;
+    size_t mappingSize;
 } HelperData;
 
+static inline unsigned char* helperNonce(const HelperData *const h, size_t const i) {
+    return h->nonces + i * h->nonceLen;
+}
+
+static inline unsigned char* helperMask(const HelperData *const h, size_t const i) {
+    return h->masks + i * h->length;
+}
+
+static inline uint32_t* helperIndices(const HelperData *const h, size_t const i) {
+    return h->indices + i * h->sampleBits;
+}
+
+static inline unsigned char* helperCipher(const HelperData *const h, size_t const i) {
+    return h->ciphers + i * h->cipherLen;
+}
+
 void initHelperData(HelperData *const h);
 
-void allocateHelperData(HelperData *const h, size_t const length, size_t const cipherLen, size_t const numHelpers);
+/*
+ * Function: allocateHelperData
+ * --------------------
+ *   Allocates the helper data block in a single allocation and fills
+ *   nonces and masks with random bytes. On failure, h is left empty.
+ *
+ *   returns: 0 on success, negative int otherwise
+ */
+int allocateHelperData(HelperData *const h, size_t const length, size_t const cipherLen, size_t const numHelpers);
+
+/*
+ * Function: allocateSeededHelperData
+ * --------------------
+ *   Like allocateHelperData(), but only the ciphers are stored. A random
+ *   seed is picked from which masks and nonces are derived.
+ *
+ *   returns: 0 on success, negative int otherwise
+ */
+int allocateSeededHelperData(HelperData *const h, size_t const length, size_t const cipherLen, size_t const numHelpers);
+
+/*
+ * Function: allocateSampledHelperData
+ * --------------------
+ *   Like allocateHelperData(), but every helper stores sampleBits distinct,
+ *   sorted bit positions instead of a mask. If seeded is set, only the
+ *   ciphers are stored, see allocateSeededHelperData().
+ *
+ *   returns: 0 on success, negative int otherwise
+ */
+int allocateSampledHelperData(HelperData *const h, size_t const length, size_t const cipherLen,
+        size_t const numHelpers, size_t const sampleBits, bool const seeded);
+
+/*
+ * Function: getHelperMaskNonce
+ * --------------------
+ *   Copies (or, for seeded helper data, derives) mask and nonce of helper i.
+ *   For sampled helper data, mask has exactly the sampled bits set.
+ *
+ *   mask:  receives h->length bytes
+ *   nonce: receives h->nonceLen bytes
+ */
+void getHelperMaskNonce(const HelperData *const h, size_t const i, unsigned char mask[], unsigned char nonce[]);
+
+/*
+ * Function: copyHelperData
+ * --------------------
+ *   Makes dst an independent deep copy of src. Any helper data previously
+ *   held by dst is freed.
+ *
+ *   returns: 0 on success, negative int otherwise
+ */
+int copyHelperData(HelperData *const dst, const HelperData *const src);
+
+/*
+ * Function: growHelperData
+ * --------------------
+ *   Makes dst a copy of src with numHelpers helpers. The helpers of src are
+ *   kept as they are; the added ones get fresh random masks (or indices)
+ *   and nonces, derived from the seed for seeded helper data, and empty
+ *   ciphers that MUST be filled with feFillLocker() before dst is used.
+ *   dst may be src. Any helper data previously held by dst is freed.
+ *
+ *   returns: 0 on success, -2 if numHelpers is below src->numHelpers,
+ *            other negative int otherwise
+ */
+int growHelperData(HelperData *const dst, const HelperData *const src, size_t const numHelpers);
 
 void freeHelperData(HelperData *const h);
 
+/*
+ * Function: helperDataBlockSize
+ * --------------------
+ *   returns: the size in bytes of the block backing a HelperData with the
+ *            dimensions and seeded flag stored in h, 0 if it does not fit
+ *            into size_t
+ */
+size_t helperDataBlockSize(const HelperData *const h);
+
+/*
+ * Function: layoutHelperData
+ * --------------------
+ *   Points nonces, masks (or indices) and ciphers of h into h->block according to the
+ *   dimensions stored in h.
+ */
+void layoutHelperData(HelperData *const h);
+
 void printHelperData(HelperData *const h, bool const printArrays);
 
 
@@ -81,8 +221,17 @@ void printHelperData(HelperData *const h, bool const printArrays);
  *  repErr:     Reproduce error. The probability that a source value within hamErr
  *              will not produce the same key (default: 0.001).
  *  secLen:     Security parameter. This is used to determine if the locker is 
- *              unlocked successfully with accuracy (1 - 2 ^ -secLen) (default: 2).
+ *              unlocked successfully: bytes of zero padding behind the key, so
+ *              a wrong value opens a locker with probability 2^-(8 * secLen)
+ *              (default: 2). Change it with feSetSecLen(), which keeps
+ *              cipherLen = length + secLen.
  *  nonceLen:   Length in bytes of nonce (salt) used in digital locker (default: 16).
+ *  seeded:     If set, masks and nonces are derived from a single public seed
+ *              and only the ciphers are stored (default: false).
+ *  locker:     Hash backend and cost parameters of the digital lockers
+ *              (default: Argon2id with libsodium's minimum cost).
+ *  sampleBits: Bit positions sampled per locker, 0 for random byte masks
+ *              (default: 0, see initFESampledProperties()).
  *  numHelpers: Calculate the number of helper values needed to be able to 
  *              reproduce keys given hamErr and repErr.
  */
@@ -92,6 +241,9 @@ typedef struct {
     double repErr;
     size_t secLen;
     size_t nonceLen;
+    bool seeded;
+    LockerParams locker;
+    size_t sampleBits;
         
     size_t cipherLen;
     size_t numHelpers;
@@ -99,6 +251,41 @@ typedef struct {
 
 void initFEProperties(FEProperties *const p, size_t const length, size_t const hamErr, double const repErr);
 
+//  Largest secLen, see feSetSecLen().
+#define FE_MAX_SEC_LEN 64
+
+/*
+ * Function: feSetSecLen
+ * --------------------
+ *   Sets the security length of p and the cipher length that depends on
+ *   it. Raise it when many lockers are tried against wrong values, e.g. to
+ *   identify among many devices (see FEIdentify.h).
+ *
+ *   secLen: 1 to FE_MAX_SEC_LEN bytes
+ *
+ *   returns: 0 on success, negative int otherwise
+ */
+int feSetSecLen(FEProperties *const p, size_t const secLen);
+
+/*
+ * Function: initFESampledProperties
+ * --------------------
+ *   Like initFEProperties(), but selects index-subset sampling as in
+ *   Canetti et al.: every locker hashes sampleBits randomly chosen bits of
+ *   the value instead of a random byte mask of it. Helper storage and hash
+ *   input then grow with sampleBits instead of length.
+ *
+ *   A locker opens if none of the hamErr wrong bits is sampled, so
+ *   numHelpers = ceil(log(repErr) / log(1 - P(open))). Each locker protects
+ *   the key with only sampleBits bits of the value, so sampleBits must not
+ *   be chosen too small. 0 or more than length * 8 bits keeps random masks.
+ *   If every choice of sampleBits bits includes a wrong bit, no locker can
+ *   open: an error is printed and numHelpers is 0, which feGenerate()
+ *   rejects.
+ */
+void initFESampledProperties(FEProperties *const p, size_t const length, size_t const hamErr,
+        double const repErr, size_t const sampleBits);
+
 void printFEProperties(FEProperties *const p);
 
 /*
@@ -123,6 +310,70 @@ void printFEProperties(FEProperties *const p);
 int feGenerate(const unsigned char value[], unsigned char key[], 
         const size_t len, HelperData *const h, const FEProperties *const p);
 
+/*
+ * Function: feGenerateParallel
+ * --------------------
+ *   Multi-threaded variant of feGenerate(). The lockers do not depend on
+ *   each other, so numThreads workers fill disjoint helper slots
+ *   concurrently. The resulting helper data has the same layout as the
+ *   one produced by feGenerate().
+ *
+ *   value:      the source value
+ *   key:        the key derived from the source
+ *   len:        length of value and key (bytes)
+ *   h:          Public helper data, see feGenerate(). The caller MUST call
+ *               freeHelperData() on h before discarding it.
+ *   p:          Holds the parameters of the fuzzy extractor.
+ *   numThreads: number of worker threads including the calling thread.
+ *               0 uses one thread per online CPU.
+ *
+ *   returns: 0 on success, negative int otherwise
+ */
+int feGenerateParallel(const unsigned char value[], unsigned char key[], 
+        const size_t len, HelperData *const h, const FEProperties *const p, size_t numThreads);
+
+/*
+ * Function: feExtend
+ * --------------------
+ *   Appends lockers to existing helper data until it has numHelpers, for
+ *   the same key and source value. The existing lockers are kept, so the
+ *   key does not change and only the added lockers are hashed. Use it after
+ *   tightening repErr or raising hamErr, with p.numHelpers of the new
+ *   properties.
+ *
+ *   value: the enrolled source value (not a noisy reading)
+ *   key:   the key of h. value and key are checked against the first
+ *          locker of h before anything is added.
+ *   len:   length of value and key (bytes)
+ *   h:     the helper data to extend. Read-only helper data becomes an
+ *          owned copy; it is left unchanged on failure.
+ *
+ *   returns: 0 on success, -2 if value and key do not match h or
+ *            numHelpers is below h->numHelpers, other negative int otherwise
+ */
+int feExtend(const unsigned char value[], const unsigned char key[],
+        const size_t len, HelperData *const h, size_t const numHelpers);
+
+/*
+ * Function: feGenerateOrdered
+ * --------------------
+ *   Enrollment from several readings of the same source. The enrolled value
+ *   is the per-bit majority of the readings. For every random mask, the
+ *   number of readings that match the enrolled value under the mask is
+ *   counted, and the lockers are stored most stable first. feReproduce()
+ *   tries lockers in index order, so a typical reading opens one of the
+ *   first lockers instead of hundreds.
+ *
+ *   readings:    numReadings readings of len bytes each, back to back
+ *   numReadings: number of readings (at least 1)
+ *   key, len, h, p: see feGenerate(). p->seeded is not supported, since
+ *               seeded masks cannot be reordered.
+ *
+ *   returns: 0 on success, negative int otherwise
+ */
+int feGenerateOrdered(const unsigned char readings[], size_t const numReadings, unsigned char key[],
+        const size_t len, HelperData *const h, const FEProperties *const p);
+
 /*
  * Function: feReproduce
  * --------------------
@@ -141,7 +392,126 @@ int feGenerate(const unsigned char value[], unsigned char key[],
 int feReproduce(const unsigned char value[], unsigned char key[],
         const size_t len, const HelperData *const h);
 
+/*
+ * Function: feTryLocker
+ * --------------------
+ *   Tries to open the single locker i of h with value. Building block for
+ *   callers that schedule lockers themselves (see FEAsync.h).
+ *
+ *   value: the value to reproduce a key for, h->length bytes
+ *   key:   receives the key if the locker opened
+ *
+ *   returns: 1 if the locker opened, 0 if not, negative int on error
+ */
+int feTryLocker(const unsigned char value[], unsigned char key[], const HelperData *const h, size_t const i);
+
+/*
+ * Function: feFillLocker
+ * --------------------
+ *   Locks key into the single locker i of h, replacing its cipher.
+ *   Building block for callers that fill lockers themselves (see
+ *   feExtendSubmit() in FEAsync.h).
+ *
+ *   value: the enrolled source value, h->length bytes
+ *   key:   the key to lock, h->length bytes
+ *
+ *   returns: 0 on success, -2 if h is read-only, other negative int on error
+ */
+int feFillLocker(const unsigned char value[], const unsigned char key[], HelperData *const h, size_t const i);
+
+/*
+ * Function: feReproduceStats
+ * --------------------
+ *   Same as feReproduce(), but reports whether a locker opened and how much
+ *   work it took. lockersTried and openedIndex are always filled in; the
+ *   timings and allocation count only if the library was built with
+ *   FE_ENABLE_STATS (see FEStats.h).
+ *
+ *   value, key, len, h: see feReproduce()
+ *   stats: receives the statistics of this call
+ *
+ *   returns: 0 on success, -4 if no locker opened, other negative int on error
+ */
+int feReproduceStats(const unsigned char value[], unsigned char key[],
+        const size_t len, const HelperData *const h, FEStats *const stats);
+
+/*
+ * Function: feReproduceHinted
+ * --------------------
+ *   Same as feReproduceStats(), but tries the lockers in hints first, in
+ *   the given order, and then all others in index order. A device tends to
+ *   open the same few lockers every time, so passing the openedIndex of
+ *   earlier reproductions (see FEHintCache.h) usually opens the first
+ *   locker tried. Indices out of range and repeated hints are skipped.
+ *
+ *   value, key, len, h: see feReproduce()
+ *   hints:     numHints locker indices to try first, may be null if numHints is 0
+ *   stats:     receives lockersTried and openedIndex, see feReproduceStats().
+ *              May be null.
+ *
+ *   returns: 0 on success, -4 if no locker opened, other negative int on error
+ */
+int feReproduceHinted(const unsigned char value[], unsigned char key[], const size_t len,
+        const HelperData *const h, const size_t hints[], size_t const numHints, FEStats *const stats);
+
+/*
+ * Function: feReproduceParallel
+ * --------------------
+ *   Multi-threaded variant of feReproduce(). The helper indices are shared
+ *   among numThreads workers, each trying one locker at a time. As soon as
+ *   a locker opens, no further lockers are handed out and all workers stop
+ *   after the locker they are currently hashing.
+ *
+ *   The key is always taken from the lowest-index locker that opens, so it
+ *   is identical to the one feReproduce() delivers.
+ *
+ *   value:      the value to reproduce a key for
+ *   key:        the reproduced key
+ *   len:        length of value and key (bytes)
+ *   h:          the previously generated public helper data
+ *   numThreads: number of worker threads including the calling thread.
+ *               0 uses one thread per online CPU.
+ *
+ *   returns: 0 on success, negative int otherwise
+ */
+int feReproduceParallel(const unsigned char value[], unsigned char key[],
+        const size_t len, const HelperData *const h, size_t numThreads);
+
+/*
+ * Function: feReproduceBatch
+ * --------------------
+ *   Reproduces keys for numValues readings against the same helper data.
+ *   Every reading opens the same locker as with feReproduce(), but for each
+ *   locker the readings are grouped by their masked vector and every
+ *   distinct vector is hashed only once. Readings of one device often mask
+ *   to identical vectors, so this saves most of the hashing work.
+ *
+ *   values:    numValues readings of len bytes each, back to back
+ *   numValues: number of readings
+ *   keys:      receives numValues keys of len bytes each. Keys of readings
+ *              that open no locker are left untouched.
+ *   results:   receives per reading 0 if the key was reproduced, -4 if
+ *              no locker opened
+ *   len:       length of each value and key (bytes)
+ *   h:         the previously generated public helper data
+ *
+ *   returns: 0 on success, negative int otherwise
+ */
+int feReproduceBatch(const unsigned char values[], size_t const numValues, unsigned char keys[],
+        int results[], const size_t len, const HelperData *const h);
+
+/*
+ * Function: feNumCPUs
+ * --------------------
+ *   returns: the number of online CPUs (at least 1)
+ */
+size_t feNumCPUs(void);
+
+
 
 
+#ifdef __cplusplus
+}
+#endif
 
 #endif // __C_FUZZYEXTRACTOR_H__
@@ -0,0 +1,539 @@
+//########################################################################
+// (C) Embedded Systems Lab
+// All rights reserved.
+// ------------------------------------------------------------
+// This document contains proprietary information belonging to
+// Research & Development FH OÖ Forschungs und Entwicklungs GmbH.
+// Using, passing on and copying of this document or parts of it
+// is generally not permitted without prior written authorization.
+// ------------------------------------------------------------
+// info(at)embedded-lab.at
+// https://www.embedded-lab.at/
+//########################################################################
+// *** File name: FEAsync.c
+// *** Date of file creation: 2022-02-07
+// *** List of autors: Lucas Drack
+// ***
+// *** Asynchronous, cancellable key reproduction on a shared executor.
+//########################################################################
+
+#include "FEAsync.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+#ifdef __linux__
+#include <sys/eventfd.h>
+#endif
+
+// Internal data type for brevity.
+typedef unsigned char byte;
+
+struct FEReproduceJob {
+    FEExecutor* executor;
+    const HelperData* h;
+    byte* value;
+    byte* key;
+    size_t len;
+    FEReproduceOptions options;
+    int fds[2];             // [read, write], both the same for an eventfd
+
+    //  Fill jobs lock key into lockers next.. of grown instead; h is null.
+    HelperData* grown;
+
+    //  Guarded by lock. refs counts the caller's handle and the executor.
+    //  released is set once the caller gave up its handle; inCallback while
+    //  callbackThread runs the callback.
+    pthread_mutex_t lock;
+    pthread_cond_t doneCond;
+    int refs;
+    bool cancelled;
+    bool done;
+    bool released;
+    bool inCallback;
+    pthread_t callbackThread;
+    int result;
+
+    //  Only touched by the worker holding the job.
+    size_t next;
+    FEReproduceJob* queueNext;
+};
+
+struct FEExecutor {
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    FEReproduceJob* head;
+    FEReproduceJob* tail;
+    bool stop;
+
+    size_t numThreads;
+    pthread_t* threads;
+};
+
+void initFEReproduceOptions(FEReproduceOptions *const options) {
+    if (!options) return;
+    options->callback = 0;
+    options->userData = 0;
+    options->eventFd = false;
+    options->lockersPerSlice = 1;
+}
+
+
+/**********************************************************/
+
+
+static int openEventFd(int fds[2]) {
+#if defined(__linux__)
+    int fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    fds[0] = fds[1] = fd;
+    return (fd >= 0) ? 0 : -1;
+#elif !defined(_WIN32)
+    if (pipe(fds) != 0) {
+        fds[0] = fds[1] = -1;
+        return -1;
+    }
+    for (int j = 0; j < 2; j++) {
+        fcntl(fds[j], F_SETFL, fcntl(fds[j], F_GETFL) | O_NONBLOCK);
+        fcntl(fds[j], F_SETFD, FD_CLOEXEC);
+    }
+    return 0;
+#else
+    fds[0] = fds[1] = -1;
+    return -1;
+#endif
+}
+
+static void signalEventFd(const int fds[2]) {
+#ifndef _WIN32
+    if (fds[1] < 0) return;
+#if defined(__linux__)
+    uint64_t one = 1;
+    ssize_t n = write(fds[1], &one, sizeof(one));
+#else
+    byte one = 1;
+    ssize_t n = write(fds[1], &one, 1);
+#endif
+    (void)n;
+#endif
+}
+
+static void closeEventFd(int fds[2]) {
+#ifndef _WIN32
+    if (fds[0] >= 0) close(fds[0]);
+    if (fds[1] >= 0 && fds[1] != fds[0]) close(fds[1]);
+#endif
+    fds[0] = fds[1] = -1;
+}
+
+static void freeJob(FEReproduceJob* job) {
+    closeEventFd(job->fds);
+    sodium_memzero(job->value, job->len);
+    sodium_memzero(job->key, job->len);
+    free(job->value);
+    free(job->key);
+    if (job->grown) {
+        freeHelperData(job->grown);
+        free(job->grown);
+    }
+    pthread_cond_destroy(&job->doneCond);
+    pthread_mutex_destroy(&job->lock);
+    free(job);
+}
+
+//  Drops one reference, freeing the job with the last one.
+static void unrefJob(FEReproduceJob* job) {
+    pthread_mutex_lock(&job->lock);
+    int refs = --job->refs;
+    pthread_mutex_unlock(&job->lock);
+    if (refs == 0) freeJob(job);
+}
+
+//  Publishes the result, signals the caller and drops the executor's
+//  reference. The callback only runs while the caller holds the handle.
+static void completeJob(FEReproduceJob* job, int const result) {
+    pthread_mutex_lock(&job->lock);
+    job->result = result;
+    job->done = true;
+    bool const notify = job->options.callback && !job->released;
+    if (notify) {
+        job->inCallback = true;
+        job->callbackThread = pthread_self();
+    }
+    pthread_cond_broadcast(&job->doneCond);
+    pthread_mutex_unlock(&job->lock);
+
+    signalEventFd(job->fds);
+    if (notify) {
+        job->options.callback(job, job->options.userData);
+        pthread_mutex_lock(&job->lock);
+        job->inCallback = false;
+        pthread_cond_broadcast(&job->doneCond);
+        pthread_mutex_unlock(&job->lock);
+    }
+    unrefJob(job);
+}
+
+static void enqueue(FEExecutor *const ex, FEReproduceJob* job) {
+    job->queueNext = 0;
+    if (ex->tail) ex->tail->queueNext = job;
+    else ex->head = job;
+    ex->tail = job;
+}
+
+static FEReproduceJob* dequeue(FEExecutor *const ex) {
+    FEReproduceJob* job = ex->head;
+    if (job) {
+        ex->head = job->queueNext;
+        if (!ex->head) ex->tail = 0;
+    }
+    return job;
+}
+
+//  Tries (or, for fill jobs, fills) up to lockersPerSlice lockers of job.
+//  returns: 1 if the job is done (result in *result), 0 to requeue it
+static int runSlice(FEReproduceJob* job, int* result) {
+    for (size_t n = 0; n < job->options.lockersPerSlice; n++) {
+        pthread_mutex_lock(&job->lock);
+        bool cancelled = job->cancelled;
+        pthread_mutex_unlock(&job->lock);
+        if (cancelled) {
+            *result = FE_ASYNC_CANCELLED;
+            return 1;
+        }
+        if (job->grown) {
+            if (job->next >= job->grown->numHelpers) {
+                *result = 0;
+                return 1;
+            }
+            if (feFillLocker(job->value, job->key, job->grown, job->next++) != 0) {
+                *result = -3;
+                return 1;
+            }
+            continue;
+        }
+        if (job->next >= job->h->numHelpers) {
+            *result = -4;
+            return 1;
+        }
+
+        int ret = feTryLocker(job->value, job->key, job->h, job->next++);
+        if (ret != 0) {
+            *result = (ret == 1) ? 0 : -3;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static void* executorWorker(void* arg) {
+    FEExecutor *const ex = (FEExecutor*)arg;
+
+    pthread_mutex_lock(&ex->lock);
+    for (;;) {
+        while (!ex->head && !ex->stop) {
+            pthread_cond_wait(&ex->wake, &ex->lock);
+        }
+        if (ex->stop) break;
+        FEReproduceJob* job = dequeue(ex);
+        pthread_mutex_unlock(&ex->lock);
+
+        int result;
+        bool done = runSlice(job, &result);
+        if (done) {
+            completeJob(job, result);
+        }
+
+        pthread_mutex_lock(&ex->lock);
+        if (!done) {
+            //  Back to the end of the queue, so all jobs make progress.
+            enqueue(ex, job);
+        }
+    }
+    pthread_mutex_unlock(&ex->lock);
+
+    return NULL;
+}
+
+
+/**********************************************************/
+
+
+int feExecutorCreate(FEExecutor** executor, size_t numThreads) {
+    if (!executor) {
+        printf("feExecutorCreate error: nullptr argument.\n");
+        return -1;
+    }
+    *executor = 0;
+    if (numThreads == 0) numThreads = feNumCPUs();
+
+    FEExecutor* ex = (FEExecutor*)calloc(1, sizeof(FEExecutor));
+    pthread_t* threads = (pthread_t*)malloc(numThreads * sizeof(pthread_t));
+    if (!ex || !threads) {
+        printf("feExecutorCreate error: malloc failed.\n");
+        free(ex); free(threads);
+        return -3;
+    }
+    pthread_mutex_init(&ex->lock, NULL);
+    pthread_cond_init(&ex->wake, NULL);
+    ex->threads = threads;
+
+    for (; ex->numThreads < numThreads; ex->numThreads++) {
+        if (pthread_create(&ex->threads[ex->numThreads], NULL, executorWorker, ex) != 0) break;
+    }
+    if (ex->numThreads == 0) {
+        printf("feExecutorCreate error: could not start worker threads.\n");
+        feExecutorDestroy(ex);
+        return -3;
+    }
+    *executor = ex;
+    return 0;
+}
+
+void feExecutorDestroy(FEExecutor* executor) {
+    if (!executor) return;
+    FEExecutor *const ex = executor;
+
+    pthread_mutex_lock(&ex->lock);
+    ex->stop = true;
+    pthread_cond_broadcast(&ex->wake);
+    pthread_mutex_unlock(&ex->lock);
+    for (size_t t = 0; t < ex->numThreads; t++) {
+        pthread_join(ex->threads[t], NULL);
+    }
+
+    //  Workers requeue their current job before they exit, so every job
+    //  that is not done is in the queue now.
+    FEReproduceJob* job;
+    while ((job = dequeue(ex)) != 0) {
+        completeJob(job, FE_ASYNC_CANCELLED);
+    }
+
+    pthread_cond_destroy(&ex->wake);
+    pthread_mutex_destroy(&ex->lock);
+    free(ex->threads);
+    free(ex);
+}
+
+//  Allocates a job holding a copy of value and, if given, key, with one
+//  reference for the caller and one for the executor.
+static FEReproduceJob* newJob(const char* caller, const byte value[], const byte key[], size_t const len,
+        const FEReproduceOptions *const options) {
+    FEReproduceJob* j = (FEReproduceJob*)calloc(1, sizeof(FEReproduceJob));
+    byte* valueCopy = (byte*)malloc(len ? len : 1);
+    byte* keyCopy = (byte*)calloc(1, len ? len : 1);
+    if (!j || !valueCopy || !keyCopy) {
+        printf("%s error: malloc failed.\n", caller);
+        free(j); free(valueCopy); free(keyCopy);
+        return 0;
+    }
+    memcpy(valueCopy, value, len);
+    if (key) memcpy(keyCopy, key, len);
+    j->value = valueCopy;
+    j->key = keyCopy;
+    j->len = len;
+    if (options) j->options = *options;
+    else initFEReproduceOptions(&j->options);
+    if (j->options.lockersPerSlice == 0) j->options.lockersPerSlice = 1;
+    j->fds[0] = j->fds[1] = -1;
+    pthread_mutex_init(&j->lock, NULL);
+    pthread_cond_init(&j->doneCond, NULL);
+    j->refs = 2;
+    j->result = FE_ASYNC_PENDING;
+    return j;
+}
+
+//  Hands j to the executor. On failure j is freed.
+static int submitJob(const char* caller, FEExecutor *const executor, FEReproduceJob* j,
+        FEReproduceJob** job) {
+    j->executor = executor;
+    if (j->options.eventFd && openEventFd(j->fds) != 0) {
+        printf("%s error: could not create event fd.\n", caller);
+        j->refs = 1;
+        unrefJob(j);
+        return -3;
+    }
+
+    pthread_mutex_lock(&executor->lock);
+    if (executor->stop) {
+        pthread_mutex_unlock(&executor->lock);
+        printf("%s error: executor is stopping.\n", caller);
+        j->refs = 1;
+        unrefJob(j);
+        return -2;
+    }
+    enqueue(executor, j);
+    pthread_cond_signal(&executor->wake);
+    pthread_mutex_unlock(&executor->lock);
+
+    *job = j;
+    return 0;
+}
+
+int feReproduceSubmit(FEExecutor *const executor, const unsigned char value[], size_t const len,
+        const HelperData *const h, const FEReproduceOptions *const options, FEReproduceJob** job) {
+    if (!executor || !value || !h || !job) {
+        printf("feReproduceSubmit error: nullptr argument.\n");
+        return -1;
+    }
+    *job = 0;
+    if (h->length != len) {
+        printf("feReproduceSubmit error: cannot produce key for value of different length.\n");
+        return -2;
+    }
+
+    FEReproduceJob* j = newJob("feReproduceSubmit", value, 0, len, options);
+    if (!j) return -3;
+    j->h = h;
+    return submitJob("feReproduceSubmit", executor, j, job);
+}
+
+//  Queues a fill job for the lockers h->numHelpers.. of a grown copy of h.
+static int submitExtend(const char* caller, FEExecutor *const executor, const byte value[],
+        const byte key[], const HelperData *const h, size_t const numHelpers,
+        const FEReproduceOptions *const options, FEReproduceJob** job) {
+    FEReproduceJob* j = newJob(caller, value, key, h->length, options);
+    if (!j) return -3;
+    j->grown = (HelperData*)malloc(sizeof(HelperData));
+    if (j->grown) initHelperData(j->grown);
+    if (!j->grown || growHelperData(j->grown, h, numHelpers) != 0) {
+        printf("%s error: could not allocate helper data.\n", caller);
+        j->refs = 1;
+        unrefJob(j);
+        return -3;
+    }
+    j->next = h->numHelpers;
+    return submitJob(caller, executor, j, job);
+}
+
+int feExtendSubmit(FEExecutor *const executor, const unsigned char value[], const unsigned char key[],
+        size_t const len, const HelperData *const h, size_t const numHelpers,
+        const FEReproduceOptions *const options, FEReproduceJob** job) {
+    if (!executor || !value || !key || !h || !h->block || !job) {
+        printf("feExtendSubmit error: nullptr argument.\n");
+        return -1;
+    }
+    *job = 0;
+    if (h->length != len) {
+        printf("feExtendSubmit error: cannot extend helper data for value of different length.\n");
+        return -2;
+    }
+    if (numHelpers < h->numHelpers) {
+        printf("feExtendSubmit error: cannot remove lockers.\n");
+        return -2;
+    }
+
+    //  Same check as feExtend(): the enrolled value opens the first locker.
+    if (h->numHelpers > 0) {
+        byte opened[len];
+        int ret = feTryLocker(value, opened, h, 0);
+        bool same = (ret == 1) && sodium_memcmp(opened, key, len) == 0;
+        sodium_memzero(opened, len);
+        if (ret < 0) {
+            printf("feExtendSubmit error: Ran out of memory during hashing.\n");
+            return -3;
+        }
+        if (!same) {
+            printf("feExtendSubmit error: value and key do not match the helper data.\n");
+            return -2;
+        }
+    }
+    return submitExtend("feExtendSubmit", executor, value, key, h, numHelpers, options, job);
+}
+
+int feGenerateLazy(FEExecutor *const executor, const unsigned char value[], unsigned char key[],
+        size_t const len, HelperData *const h, const FEProperties *const p, size_t numReady,
+        const FEReproduceOptions *const options, FEReproduceJob** job) {
+    if (!executor || !value || !key || !h || !p || !job) {
+        printf("feGenerateLazy error: nullptr argument.\n");
+        return -1;
+    }
+    *job = 0;
+
+    //  The first lockers are made right away, the rest by the executor.
+    FEProperties first = *p;
+    if (numReady == 0) numReady = 1;
+    if (numReady < first.numHelpers) first.numHelpers = numReady;
+    int ret = feGenerate(value, key, len, h, &first);
+    if (ret != 0) return ret;
+
+    ret = submitExtend("feGenerateLazy", executor, value, key, h, p->numHelpers, options, job);
+    if (ret != 0) {
+        sodium_memzero(key, len);
+        freeHelperData(h);
+    }
+    return ret;
+}
+
+int feExtendTake(FEReproduceJob *const job, HelperData *const h) {
+    if (!job || !h || !job->grown) return -1;
+    pthread_mutex_lock(&job->lock);
+    int result = job->result;
+    if (job->done && result == 0) {
+        if (job->grown->block) {
+            freeHelperData(h);
+            *h = *job->grown;
+            initHelperData(job->grown);
+        }
+        else {
+            result = -1;    // taken before
+        }
+    }
+    pthread_mutex_unlock(&job->lock);
+    return result;
+}
+
+int feReproduceEventFd(const FEReproduceJob *const job) {
+    return job ? job->fds[0] : -1;
+}
+
+void feReproduceCancel(FEReproduceJob *const job) {
+    if (!job) return;
+    pthread_mutex_lock(&job->lock);
+    job->cancelled = true;
+    pthread_mutex_unlock(&job->lock);
+}
+
+int feReproduceResult(FEReproduceJob *const job, unsigned char key[]) {
+    if (!job) return -1;
+    pthread_mutex_lock(&job->lock);
+    int result = job->result;
+    if (job->done && result == 0 && key) {
+        memcpy(key, job->key, job->len);
+    }
+    pthread_mutex_unlock(&job->lock);
+    return result;
+}
+
+int feReproduceWait(FEReproduceJob *const job, unsigned char key[]) {
+    if (!job) return -1;
+    pthread_mutex_lock(&job->lock);
+    while (!job->done) {
+        pthread_cond_wait(&job->doneCond, &job->lock);
+    }
+    pthread_mutex_unlock(&job->lock);
+    return feReproduceResult(job, key);
+}
+
+void feReproduceRelease(FEReproduceJob* job) {
+    if (!job) return;
+    pthread_mutex_lock(&job->lock);
+    if (job->released) {
+        //  Released by another thread while the callback ran.
+        pthread_mutex_unlock(&job->lock);
+        return;
+    }
+    job->released = true;
+    job->cancelled = true;
+    //  A callback running on another thread finishes before the handle
+    //  goes away; the callback itself may release right away.
+    while (job->inCallback && !pthread_equal(job->callbackThread, pthread_self())) {
+        pthread_cond_wait(&job->doneCond, &job->lock);
+    }
+    int refs = --job->refs;
+    pthread_mutex_unlock(&job->lock);
+    if (refs == 0) freeJob(job);
+}
@@ -0,0 +1,213 @@
+//########################################################################
+// (C) Embedded Systems Lab
+// All rights reserved.
+// ------------------------------------------------------------
+// This document contains proprietary information belonging to
+// Research & Development FH OÖ Forschungs und Entwicklungs GmbH.
+// Using, passing on and copying of this document or parts of it
+// is generally not permitted without prior written authorization.
+// ------------------------------------------------------------
+// info(at)embedded-lab.at
+// https://www.embedded-lab.at/
+//########################################################################
+// *** File name: FEAsync.h
+// *** Date of file creation: 2022-02-07
+// *** List of autors: Lucas Drack
+// ***
+// *** Asynchronous, cancellable key reproduction on a shared executor.
+//########################################################################
+
+#ifndef __FE_ASYNC_H__
+#define __FE_ASYNC_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "CFuzzyExtractor.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//  feReproduce() blocks for up to numHelpers hashes. For event loop servers,
+//  reproductions are submitted to an executor instead: a fixed pool of
+//  worker threads that takes jobs round robin, a few lockers at a time, so
+//  thousands of jobs can be in flight with a handful of threads. Completion
+//  is signalled through a callback and/or a pollable file descriptor, and
+//  a job can be cancelled between two lockers.
+//
+//  Each job tries its lockers in index order, so the key is the same one
+//  feReproduce() delivers.
+
+typedef struct FEExecutor FEExecutor;
+typedef struct FEReproduceJob FEReproduceJob;
+
+//  Called on a worker thread once the job is done (opened, exhausted,
+//  cancelled or failed), but only while the caller holds the handle: once
+//  feReproduceRelease() returns, the callback has finished or never runs.
+//  It must not block; calling feReproduceResult() and
+//  feReproduceRelease() on job is allowed.
+typedef void (*FEReproduceCallback)(FEReproduceJob* job, void* userData);
+
+//  Result codes in addition to those of feReproduceStats().
+#define FE_ASYNC_CANCELLED  -5
+#define FE_ASYNC_PENDING    -6
+
+/*
+ * Struct: FEReproduceOptions
+ * --------------------
+ *  callback:        Completion callback, may be null
+ *  userData:        Passed to callback
+ *  eventFd:         If set, the job gets a file descriptor that becomes
+ *                   readable on completion (eventfd on Linux, a pipe on
+ *                   other POSIX systems, unavailable on Windows)
+ *  lockersPerSlice: Lockers a worker tries before moving on to the next job
+ *                   (default: 1). Larger slices mean less scheduling
+ *                   overhead for cheap lockers, but coarser fairness and
+ *                   cancellation.
+ */
+typedef struct {
+    FEReproduceCallback callback;
+    void* userData;
+    bool eventFd;
+    size_t lockersPerSlice;
+} FEReproduceOptions;
+
+void initFEReproduceOptions(FEReproduceOptions *const options);
+
+/*
+ * Function: feExecutorCreate
+ * --------------------
+ *   Starts an executor with numThreads workers (0: one per online CPU).
+ *
+ *   returns: 0 on success, negative int otherwise
+ */
+int feExecutorCreate(FEExecutor** executor, size_t numThreads);
+
+/*
+ * Function: feExecutorDestroy
+ * --------------------
+ *   Stops the workers. Jobs that are not done yet complete as cancelled
+ *   (their callbacks still run unless released). Job handles stay valid
+ *   until released.
+ */
+void feExecutorDestroy(FEExecutor* executor);
+
+/*
+ * Function: feReproduceSubmit
+ * --------------------
+ *   Queues a reproduction of value against h. value is copied; h must stay
+ *   valid until the job is done.
+ *
+ *   options: may be null for the defaults
+ *   job:     receives the job handle. The caller MUST call
+ *            feReproduceRelease() on it.
+ *
+ *   returns: 0 on success, negative int otherwise
+ */
+int feReproduceSubmit(FEExecutor *const executor, const unsigned char value[], size_t const len,
+        const HelperData *const h, const FEReproduceOptions *const options, FEReproduceJob** job);
+
+/*
+ * Function: feExtendSubmit
+ * --------------------
+ *   Queues feExtend() of h to numHelpers lockers. The executor fills a
+ *   grown copy, so h stays usable with its current lockers meanwhile; once
+ *   the job is done, feExtendTake() swaps the grown helper data in. Fill
+ *   jobs share the queue with reproductions, are waited for, cancelled and
+ *   released like them, and complete with 0 once every locker is filled.
+ *
+ *   value, key: the enrolled value and its key, checked against the first
+ *               locker of h as by feExtend(). Both are copied.
+ *   options:    may be null for the defaults
+ *   job:        receives the job handle. The caller MUST call
+ *               feReproduceRelease() on it.
+ *
+ *   returns: 0 on success, -2 if value and key do not match h, other
+ *            negative int otherwise
+ */
+int feExtendSubmit(FEExecutor *const executor, const unsigned char value[], const unsigned char key[],
+        size_t const len, const HelperData *const h, size_t const numHelpers,
+        const FEReproduceOptions *const options, FEReproduceJob** job);
+
+/*
+ * Function: feGenerateLazy
+ * --------------------
+ *   feGenerate() that returns after the first numReady lockers (at least
+ *   one) and leaves the remaining p->numHelpers - numReady to the executor,
+ *   as feExtendSubmit() does. h reproduces the key right away, only with
+ *   a higher reproduce error until feExtendTake() installs all lockers.
+ *
+ *   value, key, len, h, p: see feGenerate()
+ *   options, job:          see feExtendSubmit()
+ *
+ *   returns: 0 on success, negative int otherwise
+ */
+int feGenerateLazy(FEExecutor *const executor, const unsigned char value[], unsigned char key[],
+        size_t const len, HelperData *const h, const FEProperties *const p, size_t numReady,
+        const FEReproduceOptions *const options, FEReproduceJob** job);
+
+/*
+ * Function: feExtendTake
+ * --------------------
+ *   Replaces h with the helper data a fill job completed. h must not be in
+ *   use by other threads during the call. Each job hands its result out
+ *   once.
+ *
+ *   returns: 0 if h was replaced, FE_ASYNC_PENDING while the job runs,
+ *            FE_ASYNC_CANCELLED, other negative int on error
+ */
+int feExtendTake(FEReproduceJob *const job, HelperData *const h);
+
+/*
+ * Function: feReproduceEventFd
+ * --------------------
+ *   returns: the completion file descriptor of job, -1 if it has none.
+ *            It is closed by feReproduceRelease().
+ */
+int feReproduceEventFd(const FEReproduceJob *const job);
+
+/*
+ * Function: feReproduceCancel
+ * --------------------
+ *   Requests cancellation. The job stops before its next locker and
+ *   completes with FE_ASYNC_CANCELLED, unless it is already done.
+ */
+void feReproduceCancel(FEReproduceJob *const job);
+
+/*
+ * Function: feReproduceResult
+ * --------------------
+ *   key: receives the reproduced key if the result is 0, may be null
+ *
+ *   returns: 0 if a locker opened, -4 if none did, FE_ASYNC_CANCELLED,
+ *            FE_ASYNC_PENDING while the job runs, other negative int on error
+ */
+int feReproduceResult(FEReproduceJob *const job, unsigned char key[]);
+
+/*
+ * Function: feReproduceWait
+ * --------------------
+ *   Blocks until job is done.
+ *
+ *   returns: see feReproduceResult()
+ */
+int feReproduceWait(FEReproduceJob *const job, unsigned char key[]);
+
+/*
+ * Function: feReproduceRelease
+ * --------------------
+ *   Releases the caller's handle. A job that is still running is cancelled
+ *   and its callback no longer runs; its memory is freed once the executor
+ *   is done with it. Release each handle once, either in the callback or
+ *   elsewhere. Should both race, e.g. a release on client disconnect while
+ *   the callback releases, the later one waits for the callback and does
+ *   nothing.
+ */
+void feReproduceRelease(FEReproduceJob* job);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __FE_ASYNC_H__
@@ -0,0 +1,252 @@
+//########################################################################
+// (C) Embedded Systems Lab
+// All rights reserved.
+// ------------------------------------------------------------
+// This document contains proprietary information belonging to
+// Research & Development FH OÖ Forschungs und Entwicklungs GmbH.
+// Using, passing on and copying of this document or parts of it
+// is generally not permitted without prior written authorization.
+// ------------------------------------------------------------
+// info(at)embedded-lab.at
+// https://www.embedded-lab.at/
+//########################################################################
+// *** File name: FECalibrate.c
+// *** Date of file creation: 2022-02-07
+// *** List of autors: Lucas Drack
+// ***
+// *** Calibration of the locker hash cost to a reproduce latency budget.
+//########################################################################
+
+#include "FECalibrate.h"
+#include "FEStats.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+
+// Internal data type for brevity.
+typedef unsigned char byte;
+
+//  Argon2 memory is allocated in blocks of 1 KiB.
+#define ARGON2_BLOCK 1024
+
+void initFECalibrateOptions(FECalibrateOptions *const options) {
+    if (!options) return;
+    options->budgetMs = 200.0;
+    options->numThreads = 0;
+    options->algorithm = LOCKER_ARGON2ID;
+    options->maxMemlimit = (size_t)64 << 20;
+    options->maxOpslimit = 4294967295u;
+    options->headroom = 0.9;
+    options->sampleMs = 20.0;
+}
+
+
+/**********************************************************/
+
+
+//  One worker of feMeasureLocker(): hashes until its own deadline and
+//  reports how many lockers it got through in how much time.
+typedef struct {
+    const LockerParams* lp;
+    size_t inLen;
+    size_t outLen;
+    uint64_t sampleNs;
+
+    uint64_t hashes;
+    uint64_t elapsedNs;
+    int error;
+} MeasureWorker;
+
+static void* measureWorker(void* arg) {
+    MeasureWorker *const w = (MeasureWorker*)arg;
+    byte in[w->inLen ? w->inLen : 1];
+    byte out[w->outLen];
+    byte nonce[LOCKER_NONCE_LEN];
+    randombytes_buf(in, sizeof(in));
+    randombytes_buf(nonce, sizeof(nonce));
+
+    //  The first locker warms up caches and is not counted.
+    w->error = lockerHash(w->lp, out, w->outLen, in, w->inLen, nonce);
+    uint64_t start = feStatsNow();
+    uint64_t now = start;
+    while (w->error == 0 && (w->hashes == 0 || now - start < w->sampleNs)) {
+        in[0]++;
+        w->error = lockerHash(w->lp, out, w->outLen, in, w->inLen, nonce);
+        w->hashes++;
+        now = feStatsNow();
+    }
+    w->elapsedNs = now - start;
+    return NULL;
+}
+
+double feMeasureLocker(const LockerParams *const lp, size_t const inLen, size_t const outLen,
+        size_t numThreads, double const sampleMs) {
+    if (!lp || !lockerParamsValid(lp) || outLen == 0) {
+        printf("feMeasureLocker error: invalid locker parameters.\n");
+        return -2.0;
+    }
+    if (numThreads == 0) numThreads = feNumCPUs();
+
+    MeasureWorker workers[numThreads];
+    pthread_t threads[numThreads];
+    for (size_t t = 0; t < numThreads; t++) {
+        workers[t].lp = lp;
+        workers[t].inLen = inLen;
+        workers[t].outLen = outLen;
+        workers[t].sampleNs = (uint64_t)(sampleMs > 0.0 ? sampleMs * 1e6 : 0.0);
+        workers[t].hashes = 0;
+        workers[t].elapsedNs = 0;
+        workers[t].error = 0;
+    }
+
+    //  The calling thread is one of the workers.
+    size_t started = 0;
+    for (; started + 1 < numThreads; started++) {
+        if (pthread_create(&threads[started], NULL, measureWorker, &workers[started + 1]) != 0) break;
+    }
+    measureWorker(&workers[0]);
+    for (size_t t = 0; t < started; t++) {
+        pthread_join(threads[t], NULL);
+    }
+
+    //  Lockers per second of all workers together.
+    double throughput = 0.0;
+    for (size_t t = 0; t <= started; t++) {
+        if (workers[t].error != 0) {
+            printf("feMeasureLocker error: Ran out of memory during hashing.\n");
+            return -3.0;
+        }
+        throughput += (double)workers[t].hashes / ((double)(workers[t].elapsedNs ? workers[t].elapsedNs : 1) / 1e9);
+    }
+    return 1e9 / throughput;
+}
+
+
+/**********************************************************/
+
+
+//  State of one calibration: the best parameters so far and what one
+//  locker may cost.
+typedef struct {
+    LockerParams lp;
+    double lockerNs;
+    double budgetNs;
+    size_t inLen;
+    size_t outLen;
+    size_t numThreads;
+    double sampleMs;
+} Calibration;
+
+static uint64_t getCost(const LockerParams *const lp, bool const memory) {
+    return memory ? (uint64_t)lp->memlimit : lp->opslimit;
+}
+
+static void setCost(LockerParams *const lp, bool const memory, uint64_t const cost) {
+    if (memory) lp->memlimit = (size_t)(cost / ARGON2_BLOCK * ARGON2_BLOCK);
+    else lp->opslimit = cost;
+}
+
+//  Doubles one cost parameter while the measured locker stays within the
+//  budget, then interpolates linearly into the last step, since the time
+//  grows about linearly with memory and passes.
+//
+//  returns: 0 on success, negative int on error
+static int growCost(Calibration *const c, bool const memory, uint64_t const max) {
+    for (;;) {
+        uint64_t cur = getCost(&c->lp, memory);
+        if (cur >= max) return 0;
+        uint64_t next = (cur > max / 2) ? max : 2 * cur;
+
+        LockerParams candidate = c->lp;
+        setCost(&candidate, memory, next);
+        double t = feMeasureLocker(&candidate, c->inLen, c->outLen, c->numThreads, c->sampleMs);
+        if (t < 0.0) return -3;
+        if (t <= c->budgetNs) {
+            c->lp = candidate;
+            c->lockerNs = t;
+            continue;
+        }
+
+        double fraction = (c->budgetNs - c->lockerNs) / (t - c->lockerNs);
+        uint64_t between = cur + (uint64_t)((double)(next - cur) * fraction);
+        setCost(&candidate, memory, between);
+        if (getCost(&candidate, memory) > cur) {
+            t = feMeasureLocker(&candidate, c->inLen, c->outLen, c->numThreads, c->sampleMs);
+            if (t < 0.0) return -3;
+            if (t <= c->budgetNs) {
+                c->lp = candidate;
+                c->lockerNs = t;
+            }
+        }
+        return 0;
+    }
+}
+
+static void fillCalibration(const Calibration *const c, size_t const numHelpers, double const budgetNs,
+        FECalibration *const result) {
+    if (!result) return;
+    result->lockerMs = c->lockerNs / 1e6;
+    result->worstCaseMs = c->lockerNs * (double)numHelpers / 1e6;
+    double fit = floor(budgetNs / c->lockerNs);
+    result->maxHelpers = (fit < (double)SIZE_MAX) ? (size_t)fit : SIZE_MAX;
+}
+
+int feCalibrate(FEProperties *const p, const FECalibrateOptions *const options,
+        FECalibration *const result) {
+    if (!p) {
+        printf("feCalibrate error: nullptr argument.\n");
+        return -1;
+    }
+    FECalibrateOptions o;
+    if (options) o = *options;
+    else initFECalibrateOptions(&o);
+    if (o.numThreads == 0) o.numThreads = feNumCPUs();
+    if (p->numHelpers == 0 || !(o.budgetMs > 0.0) || !(o.headroom > 0.0)) {
+        printf("feCalibrate error: no lockers or no budget.\n");
+        return -2;
+    }
+
+    Calibration c;
+    if (initLockerParams(&c.lp, o.algorithm) != 0) {
+        printf("feCalibrate error: unknown locker algorithm.\n");
+        return -2;
+    }
+    double const budgetNs = o.budgetMs * 1e6 * o.headroom;
+    c.budgetNs = budgetNs / (double)p->numHelpers;
+    c.inLen = p->sampleBits ? (p->sampleBits + 7) / 8 : p->length;
+    c.outLen = p->cipherLen;
+    c.numThreads = o.numThreads;
+    c.sampleMs = o.sampleMs;
+
+    c.lockerNs = feMeasureLocker(&c.lp, c.inLen, c.outLen, c.numThreads, c.sampleMs);
+    if (c.lockerNs < 0.0) return -3;
+    if (c.lockerNs > c.budgetNs) {
+        p->locker = c.lp;
+        fillCalibration(&c, p->numHelpers, budgetNs, result);
+        printf("feCalibrate error: %zu lockers exceed the budget even at the lowest cost.\n",
+                p->numHelpers);
+        return -5;
+    }
+
+    int ret = 0;
+    switch (c.lp.algorithm) {
+        case LOCKER_ARGON2I:
+        case LOCKER_ARGON2ID:
+            //  Memory first: it is what makes guessing expensive on GPUs.
+            ret = growCost(&c, true, o.maxMemlimit);
+            if (ret == 0) ret = growCost(&c, false, o.maxOpslimit);
+            break;
+        case LOCKER_PBKDF2_SHA256:
+            ret = growCost(&c, false, o.maxOpslimit);
+            break;
+        default:
+            break;
+    }
+    if (ret != 0) return ret;
+
+    p->locker = c.lp;
+    fillCalibration(&c, p->numHelpers, budgetNs, result);
+    return 0;
+}
@@ -0,0 +1,123 @@
+//########################################################################
+// (C) Embedded Systems Lab
+// All rights reserved.
+// ------------------------------------------------------------
+// This document contains proprietary information belonging to
+// Research & Development FH OÖ Forschungs und Entwicklungs GmbH.
+// Using, passing on and copying of this document or parts of it
+// is generally not permitted without prior written authorization.
+// ------------------------------------------------------------
+// info(at)embedded-lab.at
+// https://www.embedded-lab.at/
+//########################################################################
+// *** File name: FECalibrate.h
+// *** Date of file creation: 2022-02-07
+// *** List of autors: Lucas Drack
+// ***
+// *** Calibration of the locker hash cost to a reproduce latency budget.
+//########################################################################
+
+#ifndef __FE_CALIBRATE_H__
+#define __FE_CALIBRATE_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "CFuzzyExtractor.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//  The worst case of a reproduction is a reading that opens no locker (or
+//  only the last one): all numHelpers lockers are hashed. On numThreads
+//  workers (feReproduceParallel(), an executor) that takes
+//
+//      numHelpers * (wall time per locker while all workers hash)
+//
+//  The calibration measures the locker hash on this host with numThreads
+//  workers hashing concurrently, so memory bandwidth and shared caches are
+//  accounted for, and raises the cost parameters of the lockers as far as
+//  the budget allows: Argon2 first gets more memory, up to maxMemlimit,
+//  then more passes; PBKDF2 gets more iterations. BLAKE2b has no cost
+//  parameter and is only checked against the budget.
+//
+//  The chosen parameters are written to p->locker, so feGenerate() stores
+//  them in the helper data and every reproduction uses the same ones.
+
+
+/*
+ * Struct: FECalibrateOptions
+ * --------------------
+ *  budgetMs:     Worst case reproduce time in milliseconds (default: 200)
+ *  numThreads:   Workers a reproduction runs on (default 0: one per
+ *                online CPU)
+ *  algorithm:    Locker hash to calibrate (default: LOCKER_ARGON2ID)
+ *  maxMemlimit:  Largest Argon2 memory per locker in bytes (default: 64 MiB).
+ *                Every worker holds this much while hashing.
+ *  maxOpslimit:  Largest number of Argon2 passes or PBKDF2 iterations
+ *                (default: 2^32 - 1)
+ *  headroom:     Fraction of the budget the prediction may use, for
+ *                measurement noise and load (default: 0.9)
+ *  sampleMs:     Time spent measuring each candidate (default: 20)
+ */
+typedef struct {
+    double budgetMs;
+    size_t numThreads;
+    LockerAlgorithm algorithm;
+    size_t maxMemlimit;
+    uint64_t maxOpslimit;
+    double headroom;
+    double sampleMs;
+} FECalibrateOptions;
+
+void initFECalibrateOptions(FECalibrateOptions *const options);
+
+/*
+ * Struct: FECalibration
+ * --------------------
+ *  lockerMs:    Measured wall time per locker with all workers hashing
+ *  worstCaseMs: Predicted time to try all numHelpers lockers
+ *  maxHelpers:  Lockers that fit the budget at the chosen parameters
+ */
+typedef struct {
+    double lockerMs;
+    double worstCaseMs;
+    size_t maxHelpers;
+} FECalibration;
+
+/*
+ * Function: feCalibrate
+ * --------------------
+ *   Picks the most expensive locker parameters for which trying all
+ *   p->numHelpers lockers stays within the budget.
+ *
+ *   p:       properties with length, numHelpers and sampleBits set, e.g.
+ *            by initFEProperties() from hamErr and repErr or by
+ *            feOptimizeProperties(). Receives the locker parameters.
+ *   options: null for the defaults
+ *   result:  receives the measurements, may be null
+ *
+ *   returns: 0 on success, -5 if even the cheapest parameters exceed the
+ *            budget (p->locker is then set to them and result->maxHelpers
+ *            tells how many lockers would fit), other negative int on error
+ */
+int feCalibrate(FEProperties *const p, const FECalibrateOptions *const options,
+        FECalibration *const result);
+
+/*
+ * Function: feMeasureLocker
+ * --------------------
+ *   Measures the wall time per locker of lp while numThreads workers hash
+ *   inputs of inLen bytes into outLen bytes for about sampleMs.
+ *
+ *   returns: the time in nanoseconds, a negative value on error
+ */
+double feMeasureLocker(const LockerParams *const lp, size_t const inLen, size_t const outLen,
+        size_t numThreads, double const sampleMs);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __FE_CALIBRATE_H__
@@ -0,0 +1,242 @@
+//########################################################################
+// (C) Embedded Systems Lab
+// All rights reserved.
+// ------------------------------------------------------------
+// This document contains proprietary information belonging to
+// Research & Development FH OÖ Forschungs und Entwicklungs GmbH.
+// Using, passing on and copying of this document or parts of it
+// is generally not permitted without prior written authorization.
+// ------------------------------------------------------------
+// info(at)embedded-lab.at
+// https://www.embedded-lab.at/
+//########################################################################
+// *** File name: FEHintCache.c
+// *** Date of file creation: 2022-02-07
+// *** List of autors: Lucas Drack
+// ***
+// *** Per-device cache of the lockers that opened last.
+//########################################################################
+
+#include "FEHintCache.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#define NONE SIZE_MAX
+
+//  One cached device. Entries are linked into the LRU list (prev, next)
+//  and into the chain of their hash bucket.
+typedef struct {
+    uint64_t deviceId;
+    size_t prev;
+    size_t next;
+    size_t chain;
+    size_t numHints;
+} HintEntry;
+
+//  entries[0..used) are in use; hints holds hintsPerDevice slots per entry.
+//  head is the most, tail the least recently used entry. Guarded by lock.
+struct FEHintCache {
+    pthread_mutex_t lock;
+    size_t maxDevices;
+    size_t hintsPerDevice;
+    HintEntry* entries;
+    size_t* hints;
+    size_t used;
+    size_t head;
+    size_t tail;
+
+    size_t* buckets;
+    size_t bucketMask;
+};
+
+static size_t bucketOf(const FEHintCache *const c, uint64_t const deviceId) {
+    //  splitmix64 finalizer, so sequential IDs spread over the buckets.
+    uint64_t x = deviceId;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+    x ^= x >> 31;
+    return (size_t)x & c->bucketMask;
+}
+
+static size_t findEntry(const FEHintCache *const c, uint64_t const deviceId) {
+    size_t e = c->buckets[bucketOf(c, deviceId)];
+    while (e != NONE && c->entries[e].deviceId != deviceId) {
+        e = c->entries[e].chain;
+    }
+    return e;
+}
+
+static void unlinkLru(FEHintCache *const c, size_t const e) {
+    HintEntry *const entry = &c->entries[e];
+    if (entry->prev != NONE) c->entries[entry->prev].next = entry->next;
+    else c->head = entry->next;
+    if (entry->next != NONE) c->entries[entry->next].prev = entry->prev;
+    else c->tail = entry->prev;
+}
+
+static void pushFront(FEHintCache *const c, size_t const e) {
+    c->entries[e].prev = NONE;
+    c->entries[e].next = c->head;
+    if (c->head != NONE) c->entries[c->head].prev = e;
+    c->head = e;
+    if (c->tail == NONE) c->tail = e;
+}
+
+static void unlinkBucket(FEHintCache *const c, size_t const e) {
+    size_t* link = &c->buckets[bucketOf(c, c->entries[e].deviceId)];
+    while (*link != e) link = &c->entries[*link].chain;
+    *link = c->entries[e].chain;
+}
+
+//  Removes entry e and moves the last used entry into its slot, so that
+//  entries[0..used) stay dense.
+static void removeEntry(FEHintCache *const c, size_t const e) {
+    unlinkLru(c, e);
+    unlinkBucket(c, e);
+    size_t const last = --c->used;
+    if (e == last) return;
+
+    unlinkLru(c, last);
+    unlinkBucket(c, last);
+    c->entries[e] = c->entries[last];
+    memcpy(&c->hints[e * c->hintsPerDevice], &c->hints[last * c->hintsPerDevice],
+            c->hintsPerDevice * sizeof(size_t));
+
+    //  Relink the moved entry in place of its old slot.
+    HintEntry *const moved = &c->entries[e];
+    size_t const b = bucketOf(c, moved->deviceId);
+    moved->chain = c->buckets[b];
+    c->buckets[b] = e;
+    if (moved->prev != NONE) c->entries[moved->prev].next = e;
+    else c->head = e;
+    if (moved->next != NONE) c->entries[moved->next].prev = e;
+    else c->tail = e;
+}
+
+int feHintCacheCreate(FEHintCache** cache, size_t const maxDevices, size_t hintsPerDevice) {
+    if (!cache) {
+        printf("feHintCacheCreate error: nullptr argument.\n");
+        return -1;
+    }
+    *cache = 0;
+    if (maxDevices == 0) {
+        printf("feHintCacheCreate error: cache holds no devices.\n");
+        return -2;
+    }
+    if (hintsPerDevice == 0) hintsPerDevice = 4;
+
+    size_t numBuckets = 1;
+    while (numBuckets < maxDevices) numBuckets <<= 1;
+
+    FEHintCache* c = (FEHintCache*)calloc(1, sizeof(FEHintCache));
+    HintEntry* entries = (HintEntry*)malloc(maxDevices * sizeof(HintEntry));
+    size_t* hints = (size_t*)malloc(maxDevices * hintsPerDevice * sizeof(size_t));
+    size_t* buckets = (size_t*)malloc(numBuckets * sizeof(size_t));
+    if (!c || !entries || !hints || !buckets) {
+        printf("feHintCacheCreate error: malloc failed.\n");
+        free(c); free(entries); free(hints); free(buckets);
+        return -3;
+    }
+    for (size_t b = 0; b < numBuckets; b++) buckets[b] = NONE;
+
+    pthread_mutex_init(&c->lock, NULL);
+    c->maxDevices = maxDevices;
+    c->hintsPerDevice = hintsPerDevice;
+    c->entries = entries;
+    c->hints = hints;
+    c->used = 0;
+    c->head = NONE;
+    c->tail = NONE;
+    c->buckets = buckets;
+    c->bucketMask = numBuckets - 1;
+    *cache = c;
+    return 0;
+}
+
+void feHintCacheDestroy(FEHintCache* cache) {
+    if (!cache) return;
+    pthread_mutex_destroy(&cache->lock);
+    free(cache->entries);
+    free(cache->hints);
+    free(cache->buckets);
+    free(cache);
+}
+
+size_t feHintCacheGet(FEHintCache *const cache, uint64_t const deviceId, size_t hints[],
+        size_t const maxHints) {
+    if (!cache || !hints) return 0;
+    pthread_mutex_lock(&cache->lock);
+    size_t n = 0;
+    size_t e = findEntry(cache, deviceId);
+    if (e != NONE) {
+        unlinkLru(cache, e);
+        pushFront(cache, e);
+        n = cache->entries[e].numHints;
+        if (n > maxHints) n = maxHints;
+        memcpy(hints, &cache->hints[e * cache->hintsPerDevice], n * sizeof(size_t));
+    }
+    pthread_mutex_unlock(&cache->lock);
+    return n;
+}
+
+void feHintCachePut(FEHintCache *const cache, uint64_t const deviceId, size_t const openedIndex) {
+    if (!cache) return;
+    pthread_mutex_lock(&cache->lock);
+    size_t e = findEntry(cache, deviceId);
+    if (e == NONE) {
+        if (cache->used == cache->maxDevices) {
+            removeEntry(cache, cache->tail);
+        }
+        e = cache->used++;
+        cache->entries[e].deviceId = deviceId;
+        cache->entries[e].numHints = 0;
+        size_t const b = bucketOf(cache, deviceId);
+        cache->entries[e].chain = cache->buckets[b];
+        cache->buckets[b] = e;
+    }
+    else {
+        unlinkLru(cache, e);
+    }
+    pushFront(cache, e);
+
+    //  Move (or insert) openedIndex to the front of the device's hints.
+    HintEntry *const entry = &cache->entries[e];
+    size_t *const hints = &cache->hints[e * cache->hintsPerDevice];
+    size_t pos = 0;
+    while (pos < entry->numHints && hints[pos] != openedIndex) pos++;
+    if (pos == entry->numHints) {
+        if (entry->numHints < cache->hintsPerDevice) entry->numHints++;
+        pos = entry->numHints - 1;
+    }
+    memmove(hints + 1, hints, pos * sizeof(size_t));
+    hints[0] = openedIndex;
+    pthread_mutex_unlock(&cache->lock);
+}
+
+void feHintCacheForget(FEHintCache *const cache, uint64_t const deviceId) {
+    if (!cache) return;
+    pthread_mutex_lock(&cache->lock);
+    size_t e = findEntry(cache, deviceId);
+    if (e != NONE) removeEntry(cache, e);
+    pthread_mutex_unlock(&cache->lock);
+}
+
+int feReproduceCached(FEHintCache *const cache, uint64_t const deviceId, const unsigned char value[],
+        unsigned char key[], const size_t len, const HelperData *const h, FEStats *const stats) {
+    if (!cache) {
+        printf("feReproduceCached error: nullptr argument.\n");
+        return -1;
+    }
+    size_t hints[cache->hintsPerDevice];
+    size_t numHints = feHintCacheGet(cache, deviceId, hints, cache->hintsPerDevice);
+
+    FEStats local;
+    FEStats *const st = stats ? stats : &local;
+    int ret = feReproduceHinted(value, key, len, h, hints, numHints, st);
+    if (ret == 0) {
+        feHintCachePut(cache, deviceId, (size_t)st->openedIndex);
+    }
+    return ret;
+}
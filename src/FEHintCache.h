@@ -0,0 +1,94 @@
+//########################################################################
+// (C) Embedded Systems Lab
+// All rights reserved.
+// ------------------------------------------------------------
+// This document contains proprietary information belonging to
+// Research & Development FH OÖ Forschungs und Entwicklungs GmbH.
+// Using, passing on and copying of this document or parts of it
+// is generally not permitted without prior written authorization.
+// ------------------------------------------------------------
+// info(at)embedded-lab.at
+// https://www.embedded-lab.at/
+//########################################################################
+// *** File name: FEHintCache.h
+// *** Date of file creation: 2022-02-07
+// *** List of autors: Lucas Drack
+// ***
+// *** Per-device cache of the lockers that opened last.
+//########################################################################
+
+#ifndef __FE_HINT_CACHE_H__
+#define __FE_HINT_CACHE_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "CFuzzyExtractor.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//  Remembers for up to maxDevices devices the last hintsPerDevice distinct
+//  lockers that opened, most recent first. When the cache is full, the
+//  device used least recently is dropped. Hints are only a schedule: stale
+//  hints (e.g. after re-enrollment) cost one hash each, never a wrong key.
+//  All functions are thread-safe.
+
+typedef struct FEHintCache FEHintCache;
+
+/*
+ * Function: feHintCacheCreate
+ * --------------------
+ *   cache:          receives the cache. The caller MUST call
+ *                   feHintCacheDestroy().
+ *   maxDevices:     devices remembered at most
+ *   hintsPerDevice: lockers remembered per device (0 for the default of 4)
+ *
+ *   returns: 0 on success, negative int otherwise
+ */
+int feHintCacheCreate(FEHintCache** cache, size_t const maxDevices, size_t hintsPerDevice);
+
+void feHintCacheDestroy(FEHintCache* cache);
+
+/*
+ * Function: feHintCacheGet
+ * --------------------
+ *   Writes up to maxHints hints of deviceId to hints, most recent first,
+ *   and marks the device as used.
+ *
+ *   returns: the number of hints written, 0 for an unknown device
+ */
+size_t feHintCacheGet(FEHintCache *const cache, uint64_t const deviceId, size_t hints[],
+        size_t const maxHints);
+
+/*
+ * Function: feHintCachePut
+ * --------------------
+ *   Records that locker openedIndex of deviceId opened.
+ */
+void feHintCachePut(FEHintCache *const cache, uint64_t const deviceId, size_t const openedIndex);
+
+/*
+ * Function: feHintCacheForget
+ * --------------------
+ *   Drops the hints of deviceId, e.g. when it is re-enrolled.
+ */
+void feHintCacheForget(FEHintCache *const cache, uint64_t const deviceId);
+
+/*
+ * Function: feReproduceCached
+ * --------------------
+ *   feReproduceHinted() with the cached hints of deviceId, recording the
+ *   locker that opened.
+ *
+ *   returns: see feReproduceHinted()
+ */
+int feReproduceCached(FEHintCache *const cache, uint64_t const deviceId, const unsigned char value[],
+        unsigned char key[], const size_t len, const HelperData *const h, FEStats *const stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __FE_HINT_CACHE_H__
@@ -0,0 +1,283 @@
+//########################################################################
+// (C) Embedded Systems Lab
+// All rights reserved.
+// ------------------------------------------------------------
+// This document contains proprietary information belonging to
+// Research & Development FH OÖ Forschungs und Entwicklungs GmbH.
+// Using, passing on and copying of this document or parts of it
+// is generally not permitted without prior written authorization.
+// ------------------------------------------------------------
+// info(at)embedded-lab.at
+// https://www.embedded-lab.at/
+//########################################################################
+// *** File name: FEIdentify.c
+// *** Date of file creation: 2022-02-07
+// *** List of autors: Lucas Drack
+// ***
+// *** 1:N identification of a reading among enrolled devices.
+//########################################################################
+
+#include "FEIdentify.h"
+
+#include <math.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+// Internal data type for brevity.
+typedef unsigned char byte;
+
+//  Smallest weight relative to the largest one.
+#define IDENTIFY_MIN_WEIGHT (1.0 / 1024)
+
+//  State shared by all workers of one feIdentify() call. Work items are
+//  (round, candidate) pairs numbered round * numCandidates + candidate and
+//  handed out in batches from next.
+typedef struct {
+    const byte* value;
+    size_t len;
+    const HelperData *const * candidates;
+    size_t numCandidates;
+    const double* weights;      // normalized, null for one locker per round
+    size_t batch;
+    uint64_t numPairs;
+
+    atomic_uint_fast64_t next;
+    atomic_bool stop;
+    atomic_size_t tried;
+
+    pthread_mutex_t lock;
+    byte* key;
+    size_t match;
+    int error;
+} IdentifyJob;
+
+void initFEIdentifyOptions(FEIdentifyOptions *const options) {
+    if (!options) return;
+    options->numThreads = 0;
+    options->weights = 0;
+    options->batch = 16;
+    options->maxFalseMatches = 0.01;
+}
+
+static size_t candidateLockers(const IdentifyJob *const job, size_t const c) {
+    const HelperData* h = job->candidates[c];
+    return (h && h->block && h->length == job->len) ? h->numHelpers : 0;
+}
+
+//  Lockers [*lo, *hi) of candidate c fall into round.
+static void lockerRange(const IdentifyJob *const job, uint64_t const round, size_t const c,
+        size_t* lo, size_t* hi) {
+    size_t const n = candidateLockers(job, c);
+    if (job->weights) {
+        *lo = (size_t)floor((double)round * job->weights[c]);
+        *hi = (size_t)floor((double)(round + 1) * job->weights[c]);
+    }
+    else {
+        *lo = (size_t)round;
+        *hi = (size_t)round + 1;
+    }
+    if (*lo > n) *lo = n;
+    if (*hi > n) *hi = n;
+}
+
+//  Publishes the result of the first locker that opened (or failed).
+static void finish(IdentifyJob *const job, int const ret, size_t const c, const byte key[]) {
+    pthread_mutex_lock(&job->lock);
+    if (!atomic_load_explicit(&job->stop, memory_order_relaxed)) {
+        if (ret < 0) {
+            job->error = ret;
+        }
+        else {
+            job->match = c;
+            memcpy(job->key, key, job->len);
+        }
+        atomic_store_explicit(&job->stop, true, memory_order_release);
+    }
+    pthread_mutex_unlock(&job->lock);
+}
+
+static void* identifyWorker(void* arg) {
+    IdentifyJob *const job = (IdentifyJob*)arg;
+    byte key[job->len];
+
+    while (!atomic_load_explicit(&job->stop, memory_order_acquire)) {
+        uint64_t first = atomic_fetch_add_explicit(&job->next, job->batch, memory_order_relaxed);
+        if (first >= job->numPairs) break;
+        uint64_t last = first + job->batch;
+        if (last > job->numPairs) last = job->numPairs;
+
+        for (uint64_t p = first; p < last; p++) {
+            size_t const c = (size_t)(p % job->numCandidates);
+            size_t lo, hi;
+            lockerRange(job, p / job->numCandidates, c, &lo, &hi);
+            for (size_t i = lo; i < hi; i++) {
+                if (atomic_load_explicit(&job->stop, memory_order_acquire)) goto done;
+                int ret = feTryLocker(job->value, key, job->candidates[c], i);
+                atomic_fetch_add_explicit(&job->tried, 1, memory_order_relaxed);
+                if (ret != 0) {
+                    finish(job, ret, c, key);
+                    goto done;
+                }
+            }
+        }
+    }
+done:
+    sodium_memzero(key, job->len);
+    return NULL;
+}
+
+int feIdentify(const unsigned char value[], size_t const len, const HelperData *const candidates[],
+        size_t const numCandidates, const FEIdentifyOptions *const options, unsigned char key[],
+        size_t* match, size_t* lockersTried) {
+    if (!value || !candidates || !key || !match) {
+        printf("feIdentify error: nullptr argument.\n");
+        return -1;
+    }
+    if (lockersTried) *lockersTried = 0;
+    if (numCandidates == 0 || len == 0) return -4;
+
+    FEIdentifyOptions o;
+    if (options) o = *options;
+    else initFEIdentifyOptions(&o);
+    if (o.numThreads == 0) o.numThreads = feNumCPUs();
+    if (o.batch == 0) o.batch = 1;
+
+    //  Expected number of lockers a random value opens by chance.
+    double falseMatches = 0.0;
+    double lockers = 0.0;
+    for (size_t c = 0; c < numCandidates; c++) {
+        const HelperData* h = candidates[c];
+        if (!h || !h->block || h->length != len) continue;
+        size_t pad = (h->cipherLen > h->length) ? h->cipherLen - h->length : 0;
+        if (pad > FE_MAX_SEC_LEN) pad = FE_MAX_SEC_LEN;
+        falseMatches += ldexp((double)h->numHelpers, -8 * (int)pad);
+        lockers += (double)h->numHelpers;
+    }
+    if (falseMatches > o.maxFalseMatches) {
+        //  The security length all candidates would need to be generated with.
+        size_t secLen = 1;
+        while (secLen < FE_MAX_SEC_LEN && ldexp(lockers, -8 * (int)secLen) > o.maxFalseMatches) secLen++;
+        printf("feIdentify error: %zu candidates match a random value %g times on average, "
+                "generate them with feSetSecLen(p, %zu).\n", numCandidates, falseMatches, secLen);
+        return -2;
+    }
+
+    IdentifyJob job;
+    job.value = value;
+    job.len = len;
+    job.candidates = candidates;
+    job.numCandidates = numCandidates;
+    job.weights = 0;
+    job.batch = o.batch;
+
+    //  Weights relative to the largest one. Rounds continue until the
+    //  candidate with the most rounds ran out of lockers.
+    double* weights = 0;
+    if (o.weights) {
+        weights = (double*)malloc(numCandidates * sizeof(double));
+        if (!weights) {
+            printf("feIdentify error: malloc failed.\n");
+            return -3;
+        }
+        double max = 0.0;
+        for (size_t c = 0; c < numCandidates; c++) {
+            if (o.weights[c] > max) max = o.weights[c];
+        }
+        for (size_t c = 0; c < numCandidates; c++) {
+            double w = (max > 0.0 && o.weights[c] > 0.0) ? o.weights[c] / max : 0.0;
+            weights[c] = (w > IDENTIFY_MIN_WEIGHT) ? w : IDENTIFY_MIN_WEIGHT;
+        }
+        job.weights = weights;
+    }
+    uint64_t rounds = 0;
+    for (size_t c = 0; c < numCandidates; c++) {
+        double w = weights ? weights[c] : 1.0;
+        uint64_t r = (uint64_t)ceil((double)candidateLockers(&job, c) / w);
+        if (r > rounds) rounds = r;
+    }
+    job.numPairs = rounds * numCandidates;
+
+    byte found[len];
+    job.key = found;
+    job.match = numCandidates;
+    job.error = 0;
+    atomic_init(&job.next, 0);
+    atomic_init(&job.stop, false);
+    atomic_init(&job.tried, 0);
+    pthread_mutex_init(&job.lock, NULL);
+
+    //  The calling thread is one of the workers.
+    pthread_t threads[o.numThreads];
+    size_t started = 0;
+    for (; started + 1 < o.numThreads; started++) {
+        if (pthread_create(&threads[started], NULL, identifyWorker, &job) != 0) break;
+    }
+    identifyWorker(&job);
+    for (size_t t = 0; t < started; t++) {
+        pthread_join(threads[t], NULL);
+    }
+    pthread_mutex_destroy(&job.lock);
+    free(weights);
+
+    if (lockersTried) *lockersTried = atomic_load(&job.tried);
+    if (job.error) {
+        printf("feIdentify error: Ran out of memory during hashing.\n");
+        return job.error;
+    }
+    if (job.match == numCandidates) return -4;
+
+    memcpy(key, found, len);
+    sodium_memzero(found, len);
+    *match = job.match;
+    return 0;
+}
+
+int feIdentifyStore(const unsigned char value[], size_t const len, FEStore *const store,
+        const FEIdentifyOptions *const options, unsigned char key[], uint64_t* deviceId,
+        size_t* lockersTried) {
+    if (!value || !store || !key || !deviceId) {
+        printf("feIdentifyStore error: nullptr argument.\n");
+        return -1;
+    }
+    if (lockersTried) *lockersTried = 0;
+
+    //  Devices enrolled while listing may be missed; some slack for them.
+    size_t const capacity = feStoreCount(store) + 64;
+    uint64_t* ids = (uint64_t*)malloc(capacity * sizeof(uint64_t));
+    HelperData* views = (HelperData*)malloc(capacity * sizeof(HelperData));
+    const HelperData** candidates = (const HelperData**)malloc(capacity * sizeof(HelperData*));
+    if (!ids || !views || !candidates) {
+        printf("feIdentifyStore error: malloc failed.\n");
+        free(ids); free(views); free(candidates);
+        return -3;
+    }
+
+    size_t n = feStoreList(store, ids, capacity);
+    size_t numCandidates = 0;
+    for (size_t j = 0; j < n; j++) {
+        initHelperData(&views[numCandidates]);
+        //  Devices deleted since listing are skipped.
+        if (feStoreGet(store, ids[j], &views[numCandidates], false) != 0) continue;
+        ids[numCandidates] = ids[j];
+        candidates[numCandidates] = &views[numCandidates];
+        numCandidates++;
+    }
+
+    FEIdentifyOptions o;
+    if (options) o = *options;
+    else initFEIdentifyOptions(&o);
+    o.weights = 0;
+
+    size_t match;
+    int ret = feIdentify(value, len, candidates, numCandidates, &o, key, &match, lockersTried);
+    if (ret == 0) *deviceId = ids[match];
+
+    for (size_t j = 0; j < numCandidates; j++) freeHelperData(&views[j]);
+    free(ids);
+    free(views);
+    free(candidates);
+    return ret;
+}
@@ -0,0 +1,114 @@
+//########################################################################
+// (C) Embedded Systems Lab
+// All rights reserved.
+// ------------------------------------------------------------
+// This document contains proprietary information belonging to
+// Research & Development FH OÖ Forschungs und Entwicklungs GmbH.
+// Using, passing on and copying of this document or parts of it
+// is generally not permitted without prior written authorization.
+// ------------------------------------------------------------
+// info(at)embedded-lab.at
+// https://www.embedded-lab.at/
+//########################################################################
+// *** File name: FEIdentify.h
+// *** Date of file creation: 2022-02-07
+// *** List of autors: Lucas Drack
+// ***
+// *** 1:N identification of a reading among enrolled devices.
+//########################################################################
+
+#ifndef __FE_IDENTIFY_H__
+#define __FE_IDENTIFY_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "CFuzzyExtractor.h"
+#include "FEStore.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//  Reproducing against each candidate in turn tries every locker of every
+//  wrong device before reaching the right one: N * numHelpers hashes on
+//  average. The right device usually opens within its first few lockers,
+//  so identification schedules lockers breadth first instead: round r
+//  tries locker r of every candidate. Time to identify is then about
+//  N * (lockers the right device needs), and all workers stop as soon as
+//  any locker opens.
+//
+//  Every locker of a wrong device opens by chance with probability
+//  2^-(8 * (cipherLen - length)), i.e. 2^-16 with the default security
+//  length, so a reading of no enrolled device is expected to match
+//  sum(numHelpers * 2^-(8 * (cipherLen - length))) times. feIdentify()
+//  refuses candidates for which that exceeds options->maxFalseMatches. At
+//  the default security length this already happens for candidates with
+//  a few thousand lockers, e.g. hamErr 6 of 128 bits. Raise the
+//  security length with feSetSecLen() before generating the helper data;
+//  the error names the one the candidates need.
+
+/*
+ * Struct: FEIdentifyOptions
+ * --------------------
+ *  numThreads: Workers (default 0: one per online CPU)
+ *  weights:    Per candidate lockers tried per round, e.g. the prior
+ *              probability of each device. Null tries one locker of every
+ *              candidate per round (round robin). Weights are relative to
+ *              the largest one; a candidate gets at least one locker every
+ *              1024 rounds.
+ *  batch:      Candidates a worker claims at once (default: 16). Larger
+ *              batches mean less contention for cheap lockers.
+ *  maxFalseMatches: Largest expected number of lockers of all candidates
+ *              that a random value opens (default: 0.01).
+ */
+typedef struct {
+    size_t numThreads;
+    const double* weights;
+    size_t batch;
+    double maxFalseMatches;
+} FEIdentifyOptions;
+
+void initFEIdentifyOptions(FEIdentifyOptions *const options);
+
+/*
+ * Function: feIdentify
+ * --------------------
+ *   Finds the candidate whose helper data the value unlocks.
+ *
+ *   value:         the reading, len bytes
+ *   candidates:    numCandidates helper data. Candidates of a different
+ *                  length never match.
+ *   options:       null for the defaults
+ *   key:           receives the key of the matching candidate
+ *   match:         receives the index of the matching candidate
+ *   lockersTried:  receives the number of lockers tried, may be null
+ *
+ *   returns: 0 on success, -4 if no candidate opened, -2 if the candidates
+ *            would match a random value too often (see maxFalseMatches,
+ *            the message names the secLen to generate them with),
+ *            other negative int on error
+ */
+int feIdentify(const unsigned char value[], size_t const len, const HelperData *const candidates[],
+        size_t const numCandidates, const FEIdentifyOptions *const options, unsigned char key[],
+        size_t* match, size_t* lockersTried);
+
+/*
+ * Function: feIdentifyStore
+ * --------------------
+ *   feIdentify() over all devices enrolled in store. options->weights is
+ *   ignored, as the order of the devices is not known to the caller.
+ *
+ *   deviceId: receives the ID of the matching device
+ *
+ *   returns: see feIdentify()
+ */
+int feIdentifyStore(const unsigned char value[], size_t const len, FEStore *const store,
+        const FEIdentifyOptions *const options, unsigned char key[], uint64_t* deviceId,
+        size_t* lockersTried);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __FE_IDENTIFY_H__
@@ -0,0 +1,386 @@
+//########################################################################
+// (C) Embedded Systems Lab
+// All rights reserved.
+// ------------------------------------------------------------
+// This document contains proprietary information belonging to
+// Research & Development FH OÖ Forschungs und Entwicklungs GmbH.
+// Using, passing on and copying of this document or parts of it
+// is generally not permitted without prior written authorization.
+// ------------------------------------------------------------
+// info(at)embedded-lab.at
+// https://www.embedded-lab.at/
+//########################################################################
+// *** File name: FEOptimizer.c
+// *** Date of file creation: 2022-02-07
+// *** List of autors: Lucas Drack
+// ***
+// *** Derives FEProperties from measured bit error rates.
+//########################################################################
+
+#include "FEOptimizer.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Internal data type for brevity.
+typedef unsigned char byte;
+
+void initErrorProfile(FEErrorProfile *const profile) {
+    if (!profile) return;
+    memset(profile, 0, sizeof(FEErrorProfile));
+}
+
+void freeErrorProfile(FEErrorProfile *const profile) {
+    if (!profile) return;
+    free(profile->reference);
+    free(profile->bitErrorRates);
+    initErrorProfile(profile);
+}
+
+void printErrorProfile(const FEErrorProfile *const profile) {
+    if (!profile) return;
+
+    size_t unstable = 0;
+    for (size_t b = 0; b < profile->length * 8; b++) {
+        if (profile->bitErrorRates[b] > 0.0) unstable++;
+    }
+
+    printf("\n*** Error Profile ***\n");
+    printf("Length: %zu\n", profile->length);
+    printf("# of readings: %zu\n", profile->numReadings);
+    printf("Unstable bits: %zu of %zu\n", unstable, profile->length * 8);
+    printf("Mean bit error rate: %f\n", profile->meanErrorRate);
+    printf("Max bit error rate: %f\n", profile->maxErrorRate);
+    printf("Mean Hamming distance: %f\n", profile->meanHamming);
+    printf("Max Hamming distance: %zu\n", profile->maxHamming);
+}
+
+void initFEOptimizeOptions(FEOptimizeOptions *const options) {
+    if (!options) return;
+    options->targetFRR = 0.001;
+    options->targetFAR = 1e-6;
+    options->minBitErrorRate = 0.0;
+    options->sampled = false;
+    options->minSampleBits = 32;
+    options->maxHelpers = 10000000;
+}
+
+
+/**********************************************************/
+
+
+int feEstimateErrorProfile(const unsigned char reference[], const unsigned char readings[],
+        size_t const numReadings, size_t const len, FEErrorProfile *const profile) {
+    if (!readings || !profile) {
+        printf("feEstimateErrorProfile error: nullptr argument.\n");
+        return -1;
+    }
+    initErrorProfile(profile);
+    if (numReadings == 0 || len == 0) {
+        printf("feEstimateErrorProfile error: no readings.\n");
+        return -2;
+    }
+
+    size_t const bits = len * 8;
+    size_t* counts = (size_t*)calloc(bits, sizeof(size_t));
+    byte* ref = (byte*)malloc(len);
+    double* rates = (double*)malloc(bits * sizeof(double));
+    if (!counts || !ref || !rates) {
+        printf("feEstimateErrorProfile error: malloc failed.\n");
+        free(counts); free(ref); free(rates);
+        return -3;
+    }
+
+    if (reference) {
+        memcpy(ref, reference, len);
+    }
+    else {
+        for (size_t r = 0; r < numReadings; r++) {
+            for (size_t b = 0; b < bits; b++) {
+                counts[b] += (readings[r * len + b / 8] >> (b % 8)) & 1;
+            }
+        }
+        memset(ref, 0, len);
+        for (size_t b = 0; b < bits; b++) {
+            if (counts[b] * 2 > numReadings) ref[b / 8] |= (byte)(1 << (b % 8));
+        }
+        memset(counts, 0, bits * sizeof(size_t));
+    }
+
+    size_t totalHamming = 0;
+    for (size_t r = 0; r < numReadings; r++) {
+        size_t hamming = 0;
+        for (size_t b = 0; b < bits; b++) {
+            size_t diff = ((readings[r * len + b / 8] ^ ref[b / 8]) >> (b % 8)) & 1;
+            counts[b] += diff;
+            hamming += diff;
+        }
+        totalHamming += hamming;
+        if (hamming > profile->maxHamming) profile->maxHamming = hamming;
+    }
+
+    double sum = 0.0;
+    for (size_t b = 0; b < bits; b++) {
+        rates[b] = (double)counts[b] / numReadings;
+        sum += rates[b];
+        if (rates[b] > profile->maxErrorRate) profile->maxErrorRate = rates[b];
+    }
+
+    profile->length = len;
+    profile->numReadings = numReadings;
+    profile->reference = ref;
+    profile->bitErrorRates = rates;
+    profile->meanErrorRate = sum / bits;
+    profile->meanHamming = (double)totalHamming / numReadings;
+
+    free(counts);
+    return 0;
+}
+
+
+/**********************************************************/
+
+
+//  Distribution of the number of wrong bits of a reading. The Poisson
+//  binomial is built bit by bit, truncated at maxWeight with the mass of
+//  all larger weights collected in dist[maxWeight + 1], which keeps large
+//  values cheap: their distributions are far narrower than the bit count.
+typedef struct {
+    size_t bits;
+    size_t maxWeight;
+    double* dist;
+} WeightDistribution;
+
+static int weightDistribution(const FEErrorProfile *const profile, double const floor,
+        WeightDistribution *const wd) {
+    size_t const bits = profile->length * 8;
+    double mean = 0.0;
+    double var = 0.0;
+    for (size_t b = 0; b < bits; b++) {
+        double p = fmax(profile->bitErrorRates[b], floor);
+        mean += p;
+        var += p * (1.0 - p);
+    }
+    size_t maxWeight = (size_t)ceil(mean + 12.0 * sqrt(var)) + 32;
+    if (maxWeight > bits) maxWeight = bits;
+
+    double* dist = (double*)calloc(maxWeight + 2, sizeof(double));
+    if (!dist) return -3;
+    dist[0] = 1.0;
+
+    for (size_t b = 0; b < bits; b++) {
+        double p = fmin(fmax(profile->bitErrorRates[b], floor), 1.0);
+        if (p == 0.0) continue;
+        //  The overflow bucket keeps its mass and gains that of maxWeight.
+        dist[maxWeight + 1] += dist[maxWeight] * p;
+        for (size_t w = maxWeight; w > 0; w--) {
+            dist[w] = dist[w] * (1.0 - p) + dist[w - 1] * p;
+        }
+        dist[0] *= 1.0 - p;
+    }
+
+    wd->bits = bits;
+    wd->maxWeight = maxWeight;
+    wd->dist = dist;
+    return 0;
+}
+
+//  Probability that a locker opens for a reading with weight wrong bits:
+//  each bit is kept by a random mask with probability 1/2, and sampleBits
+//  distinct positions must all avoid the wrong ones otherwise.
+static double openProbability(size_t const bits, size_t const weight, size_t const sampleBits) {
+    if (sampleBits == 0) return ldexp(1.0, -(int)weight);
+    if (sampleBits > bits - weight) return 0.0;
+    return exp(lgamma((double)(bits - weight + 1)) - lgamma((double)(bits - weight - sampleBits + 1))
+            - lgamma((double)(bits + 1)) + lgamma((double)(bits - sampleBits + 1)));
+}
+
+//  Probability that a padding check passes by accident, 2^-(8 * secLen).
+static double falseOpenProbability(size_t const secLen) {
+    return secLen ? ldexp(1.0, -8 * (int)secLen) : 0.0;
+}
+
+//  Probability that numHelpers lockers tried in order do not deliver the
+//  key: none opens, or a locker the reading does not open passes the
+//  padding check by accident (falseOpen) before one that it does open.
+//  With c = (1 - open) * (1 - falseOpen) per locker:
+//
+//      c^L + (1 - open) * falseOpen * (1 + c + ... + c^(L - 1))
+static double rejectProbability(double const open, double const falseOpen, size_t const numHelpers) {
+    if (open >= 1.0) return 0.0;
+    if (open <= 0.0) return 1.0;
+    double const logc = log1p(-open) + log1p(-falseOpen);
+    double const none = exp((double)numHelpers * logc);
+    if (falseOpen == 0.0) return none;
+    double const tried = expm1((double)numHelpers * logc) / expm1(logc);
+    return none + (1.0 - open) * falseOpen * tried;
+}
+
+//  Weights above maxWeight count as rejected.
+static double rejectRate(const WeightDistribution *const wd, size_t const sampleBits,
+        size_t const numHelpers, double const falseOpen) {
+    double frr = wd->dist[wd->maxWeight + 1];
+    for (size_t w = 0; w <= wd->maxWeight; w++) {
+        if (wd->dist[w] == 0.0) continue;
+        frr += wd->dist[w] * rejectProbability(openProbability(wd->bits, w, sampleBits), falseOpen, numHelpers);
+    }
+    return (frr > 1.0) ? 1.0 : frr;
+}
+
+//  Weights above maxWeight are bounded by the open probability of maxWeight.
+static double acceptRate(const WeightDistribution *const wd, size_t const sampleBits,
+        size_t const numHelpers) {
+    double far = 0.0;
+    for (size_t w = 0; w <= wd->maxWeight + 1; w++) {
+        size_t weight = (w > wd->maxWeight) ? wd->maxWeight : w;
+        if (wd->dist[w] == 0.0) continue;
+        double open = openProbability(wd->bits, weight, sampleBits);
+        far += wd->dist[w] * ((open >= 1.0) ? 1.0 : -expm1((double)numHelpers * log1p(-open)));
+    }
+    return (far > 1.0) ? 1.0 : far;
+}
+
+//  Smallest number of lockers in [1, maxHelpers] with an FRR of at most
+//  target, 0 if there is none. The FRR falls with every locker added, as
+//  a later locker is only tried if no earlier one opened.
+static size_t minHelpers(const WeightDistribution *const wd, size_t const sampleBits,
+        double const falseOpen, double const target, size_t const maxHelpers) {
+    if (rejectRate(wd, sampleBits, maxHelpers, falseOpen) > target) return 0;
+    size_t lo = 1;
+    size_t hi = maxHelpers;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (rejectRate(wd, sampleBits, mid, falseOpen) <= target) hi = mid;
+        else lo = mid + 1;
+    }
+    return lo;
+}
+
+//  Fewest sampled bits (none for random masks) and lockers that meet both
+//  targets at the given false open probability.
+//
+//  returns: the number of lockers, 0 if there is none
+static size_t searchHelpers(const WeightDistribution *const gd, const WeightDistribution *const id,
+        const FEOptimizeOptions *const o, double const falseOpen, size_t* sampleBits, double* far) {
+    size_t const bits = gd->bits;
+    size_t k = o->sampled ? (o->minSampleBits ? o->minSampleBits : 1) : 0;
+    size_t const lastK = o->sampled ? bits : 0;
+    for (; k <= lastK; k++) {
+        size_t n = minHelpers(gd, k, falseOpen, o->targetFRR, o->maxHelpers);
+        //  More sampled bits only need more lockers.
+        if (n == 0) break;
+        double a = acceptRate(id, k, n);
+        if (a <= o->targetFAR) {
+            *sampleBits = k;
+            *far = a;
+            return n;
+        }
+    }
+    return 0;
+}
+
+double fePredictFRR(const FEErrorProfile *const genuine, size_t const sampleBits,
+        size_t const numHelpers, size_t const secLen, double const minBitErrorRate) {
+    if (!genuine || !genuine->bitErrorRates) return -1.0;
+    WeightDistribution wd;
+    if (weightDistribution(genuine, minBitErrorRate, &wd) != 0) return -3.0;
+    double frr = rejectRate(&wd, sampleBits, numHelpers, falseOpenProbability(secLen));
+    free(wd.dist);
+    return frr;
+}
+
+int feOptimizeProperties(const FEErrorProfile *const genuine, const FEErrorProfile *const impostor,
+        const FEOptimizeOptions *const options, FEProperties *const p, double* frr, double* far) {
+    if (!genuine || !genuine->bitErrorRates || !p) {
+        printf("feOptimizeProperties error: nullptr argument.\n");
+        return -1;
+    }
+    FEOptimizeOptions o;
+    if (options) o = *options;
+    else initFEOptimizeOptions(&o);
+
+    size_t const bits = genuine->length * 8;
+    if (impostor && (!impostor->bitErrorRates || impostor->length != genuine->length)) {
+        printf("feOptimizeProperties error: impostor profile of different length.\n");
+        return -2;
+    }
+    if (!(o.targetFRR > 0.0 && o.targetFRR < 1.0) || !(o.targetFAR > 0.0) || o.maxHelpers == 0) {
+        printf("feOptimizeProperties error: invalid targets.\n");
+        return -2;
+    }
+
+    //  Without impostor readings, other devices' bits are taken as
+    //  independent of the reference.
+    FEErrorProfile random;
+    initErrorProfile(&random);
+    if (!impostor) {
+        random.length = genuine->length;
+        random.bitErrorRates = (double*)malloc(bits * sizeof(double));
+        if (!random.bitErrorRates) {
+            printf("feOptimizeProperties error: malloc failed.\n");
+            return -3;
+        }
+        for (size_t b = 0; b < bits; b++) random.bitErrorRates[b] = 0.5;
+    }
+
+    WeightDistribution gd = { 0 };
+    WeightDistribution id = { 0 };
+    if (weightDistribution(genuine, o.minBitErrorRate, &gd) != 0 ||
+            weightDistribution(impostor ? impostor : &random, 0.0, &id) != 0) {
+        printf("feOptimizeProperties error: malloc failed.\n");
+        free(gd.dist);
+        freeErrorProfile(&random);
+        return -3;
+    }
+
+    //  Random masks keep half of the bits, the minimum of sampling is tried
+    //  first and raised until other devices are rejected often enough. The
+    //  security length is the smallest one whose accidental opens keep the
+    //  FRR on target; if even the largest one does not, none does.
+    size_t sampleBits = 0;
+    size_t secLen = FE_MAX_SEC_LEN;
+    double predictedFAR = 1.0;
+    size_t numHelpers = searchHelpers(&gd, &id, &o, falseOpenProbability(secLen), &sampleBits, &predictedFAR);
+    for (size_t s = 1; numHelpers != 0 && s < FE_MAX_SEC_LEN; s++) {
+        size_t k;
+        double a;
+        size_t n = searchHelpers(&gd, &id, &o, falseOpenProbability(s), &k, &a);
+        if (n != 0) {
+            secLen = s;
+            sampleBits = k;
+            numHelpers = n;
+            predictedFAR = a;
+            break;
+        }
+    }
+
+    int ret = 0;
+    if (numHelpers == 0) {
+        printf("feOptimizeProperties error: no locker count up to %zu meets the targets.\n", o.maxHelpers);
+        ret = -5;
+    }
+    else {
+        //  The Hamming error a reading exceeds with probability < targetFRR.
+        size_t hamErr = 0;
+        double tail = 1.0 - gd.dist[0];
+        while (hamErr < gd.maxWeight && tail >= o.targetFRR) {
+            hamErr++;
+            tail -= gd.dist[hamErr];
+        }
+
+        if (sampleBits) initFESampledProperties(p, genuine->length, hamErr, o.targetFRR, sampleBits);
+        else initFEProperties(p, genuine->length, hamErr, o.targetFRR);
+        feSetSecLen(p, secLen);
+        p->numHelpers = numHelpers;
+
+        if (frr) *frr = rejectRate(&gd, sampleBits, numHelpers, falseOpenProbability(secLen));
+        if (far) *far = predictedFAR;
+    }
+
+    free(gd.dist);
+    free(id.dist);
+    freeErrorProfile(&random);
+    return ret;
+}
@@ -0,0 +1,162 @@
+//########################################################################
+// (C) Embedded Systems Lab
+// All rights reserved.
+// ------------------------------------------------------------
+// This document contains proprietary information belonging to
+// Research & Development FH OÖ Forschungs und Entwicklungs GmbH.
+// Using, passing on and copying of this document or parts of it
+// is generally not permitted without prior written authorization.
+// ------------------------------------------------------------
+// info(at)embedded-lab.at
+// https://www.embedded-lab.at/
+//########################################################################
+// *** File name: FEOptimizer.h
+// *** Date of file creation: 2022-02-07
+// *** List of autors: Lucas Drack
+// ***
+// *** Derives FEProperties from measured bit error rates.
+//########################################################################
+
+#ifndef __FE_OPTIMIZER_H__
+#define __FE_OPTIMIZER_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "CFuzzyExtractor.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//  initFEProperties() provisions lockers for the worst case of hamErr
+//  flipped bits. Real sources have a few unstable bits and many stable
+//  ones. Given measured readings, the number of wrong bits of a reading is
+//  modelled as a sum of independent per-bit errors (Poisson binomial), and
+//  a locker that keeps each bit with probability 1/2 opens with 2^-w for w
+//  wrong bits. A locker the reading does not open still passes the
+//  padding check with f = 2^-(8 * secLen) and then yields a wrong key, so
+//  with q = P(open | w) and c = (1 - q) * (1 - f) per locker tried, this
+//  yields the FRR of L lockers exactly under the model:
+//
+//      FRR(L) = sum_w P(w) * (c^L + (1 - q) * f * (1 + c + ... + c^(L-1)))
+//
+//  and the FAR for readings of other devices likewise. The optimizer picks
+//  the smallest L with FRR(L) <= target, at the smallest secLen for which
+//  one exists.
+
+
+/*
+ * Struct: FEErrorProfile
+ * --------------------
+ *  length:         Length in bytes of the readings
+ *  numReadings:    Number of readings the profile was estimated from
+ *  reference:      The value the readings were compared against, length bytes
+ *  bitErrorRates:  Per-bit rate of readings that differ from the reference,
+ *                  length * 8 values, bit b is bit (b % 8) of byte b / 8
+ *  meanErrorRate:  Mean of bitErrorRates
+ *  maxErrorRate:   Maximum of bitErrorRates
+ *  meanHamming:    Mean Hamming distance of a reading to the reference
+ *  maxHamming:     Largest Hamming distance observed
+ */
+typedef struct {
+    size_t length;
+    size_t numReadings;
+    unsigned char* reference;
+    double* bitErrorRates;
+    double meanErrorRate;
+    double maxErrorRate;
+    double meanHamming;
+    size_t maxHamming;
+} FEErrorProfile;
+
+void initErrorProfile(FEErrorProfile *const profile);
+
+void freeErrorProfile(FEErrorProfile *const profile);
+
+void printErrorProfile(const FEErrorProfile *const profile);
+
+/*
+ * Function: feEstimateErrorProfile
+ * --------------------
+ *   Estimates per-bit error rates of readings against reference.
+ *
+ *   reference:   the enrolled value, len bytes. Null uses the per-bit
+ *                majority of the readings.
+ *   readings:    numReadings readings of len bytes each, back to back
+ *   profile:     receives the profile. The caller MUST call
+ *                freeErrorProfile() on it.
+ *
+ *   returns: 0 on success, negative int otherwise
+ */
+int feEstimateErrorProfile(const unsigned char reference[], const unsigned char readings[],
+        size_t const numReadings, size_t const len, FEErrorProfile *const profile);
+
+
+/*
+ * Struct: FEOptimizeOptions
+ * --------------------
+ *  targetFRR:       Largest acceptable false rejection rate (default: 0.001)
+ *  targetFAR:       Largest acceptable rate of another device's reading
+ *                   opening a locker (default: 1e-6)
+ *  minBitErrorRate: Floor applied to every per-bit rate. Bits that never
+ *                   flipped in a few readings are not necessarily stable
+ *                   (default: 0).
+ *  sampled:         Search index-subset sampling (initFESampledProperties())
+ *                   instead of random masks
+ *  minSampleBits:   Fewest bits sampled per locker in sampled mode
+ *                   (default: 32)
+ *  maxHelpers:      Upper bound of the search (default: 10^7)
+ */
+typedef struct {
+    double targetFRR;
+    double targetFAR;
+    double minBitErrorRate;
+    bool sampled;
+    size_t minSampleBits;
+    size_t maxHelpers;
+} FEOptimizeOptions;
+
+void initFEOptimizeOptions(FEOptimizeOptions *const options);
+
+/*
+ * Function: feOptimizeProperties
+ * --------------------
+ *   Finds the fewest lockers that meet options->targetFRR for readings
+ *   distributed like genuine, and checks options->targetFAR against
+ *   impostor. In sampled mode, the smallest number of sampled bits that
+ *   meets both targets is chosen, as it needs the fewest lockers.
+ *
+ *   genuine:  error profile of readings of the enrolled device
+ *   impostor: error profile of other devices' readings against the same
+ *             reference, null to assume uniformly random bits
+ *   options:  null for the defaults
+ *   p:        receives ready-to-use properties. hamErr is set to the
+ *             number of wrong bits a reading exceeds with probability
+ *             below targetFRR; repErr to targetFRR. secLen is set to the
+ *             smallest security length that meets the targets.
+ *   frr, far: receive the predicted rates, may be null
+ *
+ *   returns: 0 on success, -5 if no locker count up to maxHelpers meets
+ *            the targets, other negative int otherwise
+ */
+int feOptimizeProperties(const FEErrorProfile *const genuine, const FEErrorProfile *const impostor,
+        const FEOptimizeOptions *const options, FEProperties *const p, double* frr, double* far);
+
+/*
+ * Function: fePredictFRR
+ * --------------------
+ *   returns: the false rejection rate of numHelpers lockers under the
+ *            genuine profile, for random masks (sampleBits 0) or
+ *            sampleBits sampled bits per locker, counting keys of lockers opened
+ *            by accident with secLen bytes of padding (0 to ignore them).
+ *            Negative on error.
+ */
+double fePredictFRR(const FEErrorProfile *const genuine, size_t const sampleBits,
+        size_t const numHelpers, size_t const secLen, double const minBitErrorRate);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __FE_OPTIMIZER_H__
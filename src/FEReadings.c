@@ -0,0 +1,467 @@
+//########################################################################
+// (C) Embedded Systems Lab
+// All rights reserved.
+// ------------------------------------------------------------
+// This document contains proprietary information belonging to
+// Research & Development FH OÖ Forschungs und Entwicklungs GmbH.
+// Using, passing on and copying of this document or parts of it
+// is generally not permitted without prior written authorization.
+// ------------------------------------------------------------
+// info(at)embedded-lab.at
+// https://www.embedded-lab.at/
+//########################################################################
+// *** File name: FEReadings.c
+// *** Date of file creation: 2022-02-07
+// *** List of autors: Lucas Drack
+// ***
+// *** Chunked loading of fingerprint readings from CSV and binary files.
+//########################################################################
+
+#include "FEReadings.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Internal data type for brevity.
+typedef unsigned char byte;
+
+//  Longest first CSV line accepted while the length is not known yet.
+#define READINGS_MAX_LENGTH (1u << 20)
+
+struct FEReadingsReader {
+    FEReadingsOptions options;
+    size_t length;
+
+    //  Window of input bytes: the whole mapping, or the stream buffer.
+    const byte* data;
+    size_t size;
+    size_t pos;
+
+    void* mapping;
+    size_t mappingSize;
+    size_t released;        // mapped bytes handed back to the OS
+    FILE* stream;
+    bool ownsStream;
+    byte* buffer;
+
+    byte* chunk;            // chunkReadings readings, unused for mapped binary files
+    byte* row;              // first CSV line while the length is not known
+    size_t rowCap;
+    size_t line;
+    bool failed;
+};
+
+//  Parser state of the CSV line in progress.
+typedef struct {
+    size_t field;
+    unsigned value;
+    bool digits;
+    bool closed;            // whitespace followed the digits
+} CSVState;
+
+void initFEReadingsOptions(FEReadingsOptions *const options) {
+    if (!options) return;
+    options->format = FE_READINGS_CSV;
+    options->length = 0;
+    options->chunkReadings = 4096;
+    options->stream = false;
+    options->bufferSize = 1 << 20;
+}
+
+
+/**********************************************************/
+
+
+//  Maps path read-only. An empty file maps to nothing.
+//  returns: 0 on success, negative int if it cannot be mapped
+static int mapFile(FEReadingsReader *const r, const char* path) {
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+            FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (file == INVALID_HANDLE_VALUE) return -2;
+    LARGE_INTEGER fileSize;
+    GetFileSizeEx(file, &fileSize);
+    size_t size = (size_t)fileSize.QuadPart;
+    void* mapping = NULL;
+    if (size > 0) {
+        HANDLE section = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+        mapping = section ? MapViewOfFile(section, FILE_MAP_READ, 0, 0, 0) : NULL;
+        if (section) CloseHandle(section);
+    }
+    CloseHandle(file);
+    if (size > 0 && !mapping) return -2;
+#else
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return -2;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+        close(fd);
+        return -2;
+    }
+    size_t size = (size_t)st.st_size;
+    void* mapping = NULL;
+    if (size > 0) {
+        mapping = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapping == MAP_FAILED) mapping = NULL;
+#ifdef MADV_SEQUENTIAL
+        if (mapping) madvise(mapping, size, MADV_SEQUENTIAL);
+#endif
+    }
+    close(fd);
+    if (size > 0 && !mapping) return -2;
+#endif
+
+    r->mapping = mapping;
+    r->mappingSize = size;
+    r->data = (const byte*)mapping;
+    r->size = size;
+    return 0;
+}
+
+static void unmapFile(FEReadingsReader *const r) {
+    if (!r->mapping) return;
+#ifdef _WIN32
+    UnmapViewOfFile(r->mapping);
+#else
+    munmap(r->mapping, r->mappingSize);
+#endif
+    r->mapping = NULL;
+}
+
+//  Hands the pages of a mapping before upTo back to the OS, so a pass over
+//  a file far larger than RAM does not evict everything else.
+static void releaseConsumed(FEReadingsReader *const r, size_t const upTo) {
+#if !defined(_WIN32) && defined(MADV_DONTNEED)
+    if (!r->mapping) return;
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    size_t end = upTo - upTo % page;
+    if (end > r->released) {
+        madvise((byte*)r->mapping + r->released, end - r->released, MADV_DONTNEED);
+        r->released = end;
+    }
+#else
+    (void)r; (void)upTo;
+#endif
+}
+
+//  Reads the next buffer of a stream into the window.
+//  returns: 1 if bytes were read, 0 at the end of the input, -3 on error
+static int refill(FEReadingsReader *const r) {
+    if (!r->stream) return 0;
+    size_t n = fread(r->buffer, 1, r->options.bufferSize, r->stream);
+    if (n == 0) {
+        if (ferror(r->stream)) {
+            printf("feReadingsNext error: read failed.\n");
+            return -3;
+        }
+        return 0;
+    }
+    r->data = r->buffer;
+    r->size = n;
+    r->pos = 0;
+    return 1;
+}
+
+
+/**********************************************************/
+
+
+static byte* rowDest(FEReadingsReader *const r, size_t const n) {
+    return r->length ? r->chunk + n * r->length : r->row;
+}
+
+static int csvEndField(FEReadingsReader *const r, CSVState *const s, size_t const n) {
+    if (!s->digits) return 0;
+    if (r->length) {
+        if (s->field >= r->length) {
+            printf("feReadingsNext error: line %zu has more than %zu bytes.\n", r->line + 1, r->length);
+            return -2;
+        }
+    }
+    else if (s->field == r->rowCap) {
+        size_t cap = r->rowCap ? r->rowCap * 2 : 64;
+        byte* grown = (cap <= READINGS_MAX_LENGTH) ? (byte*)realloc(r->row, cap) : NULL;
+        if (!grown) {
+            printf("feReadingsNext error: first line too long.\n");
+            return -3;
+        }
+        r->row = grown;
+        r->rowCap = cap;
+    }
+    rowDest(r, n)[s->field++] = (byte)s->value;
+    s->value = 0;
+    s->digits = false;
+    s->closed = false;
+    return 0;
+}
+
+//  Completes the line in progress. Blank lines are skipped.
+static int csvEndRow(FEReadingsReader *const r, CSVState *const s, size_t* n) {
+    int ret = csvEndField(r, s, *n);
+    if (ret != 0) return ret;
+    if (s->field == 0) return 0;
+
+    if (!r->length) {
+        r->chunk = (byte*)malloc(r->options.chunkReadings * s->field);
+        if (!r->chunk) {
+            printf("feReadingsNext error: malloc failed.\n");
+            return -3;
+        }
+        r->length = s->field;
+        memcpy(r->chunk, r->row, r->length);
+    }
+    else if (s->field != r->length) {
+        printf("feReadingsNext error: line %zu has %zu bytes instead of %zu.\n",
+                r->line + 1, s->field, r->length);
+        return -2;
+    }
+    (*n)++;
+    s->field = 0;
+    return 0;
+}
+
+static int nextCSV(FEReadingsReader *const r, const byte** readings, size_t* count) {
+    CSVState s = { 0, 0, false, false };
+    size_t n = 0;
+    int ret = 0;
+
+    while (n < r->options.chunkReadings) {
+        if (r->pos == r->size) {
+            ret = refill(r);
+            if (ret < 0) return ret;
+            if (ret == 0) {
+                //  The last line may lack its '\n'.
+                ret = csvEndRow(r, &s, &n);
+                if (ret != 0) return ret;
+                break;
+            }
+            ret = 0;
+        }
+
+        const byte* p = r->data + r->pos;
+        const byte* const end = r->data + r->size;
+        while (p < end) {
+            byte c = *p++;
+            unsigned d = (unsigned)c - '0';
+            if (d < 10) {
+                if (s.closed) {
+                    printf("feReadingsNext error: line %zu lacks a separator.\n", r->line + 1);
+                    return -2;
+                }
+                s.value = s.value * 10 + d;
+                s.digits = true;
+                if (s.value > 255) {
+                    printf("feReadingsNext error: line %zu has a value above 255.\n", r->line + 1);
+                    return -2;
+                }
+            }
+            else if (c == ';' || c == ',') {
+                ret = csvEndField(r, &s, n);
+            }
+            else if (c == '\n') {
+                ret = csvEndRow(r, &s, &n);
+                r->line++;
+                if (ret == 0 && n == r->options.chunkReadings) break;
+            }
+            else if (c == ' ' || c == '\t' || c == '\r') {
+                s.closed = s.digits;
+            }
+            else {
+                printf("feReadingsNext error: line %zu has an invalid character.\n", r->line + 1);
+                ret = -2;
+            }
+            if (ret != 0) return ret;
+        }
+        r->pos = (size_t)(p - r->data);
+    }
+
+    *readings = r->chunk;
+    *count = n;
+    return (n > 0) ? 1 : 0;
+}
+
+static int nextBinary(FEReadingsReader *const r, const byte** readings, size_t* count) {
+    size_t const length = r->length;
+
+    if (!r->stream) {
+        size_t n = (r->size - r->pos) / length;
+        if (n > r->options.chunkReadings) n = r->options.chunkReadings;
+        *readings = r->data + r->pos;
+        *count = n;
+        r->pos += n * length;
+        return (n > 0) ? 1 : 0;
+    }
+
+    size_t const want = r->options.chunkReadings * length;
+    size_t total = 0;
+    while (total < want) {
+        size_t got = fread(r->chunk + total, 1, want - total, r->stream);
+        if (got == 0) break;
+        total += got;
+    }
+    if (ferror(r->stream)) {
+        printf("feReadingsNext error: read failed.\n");
+        return -3;
+    }
+    if (total % length != 0) {
+        printf("feReadingsNext error: truncated reading at the end of the file.\n");
+        return -2;
+    }
+    *readings = r->chunk;
+    *count = total / length;
+    return (total > 0) ? 1 : 0;
+}
+
+
+/**********************************************************/
+
+
+int feReadingsOpen(FEReadingsReader** reader, const char* path, const FEReadingsOptions *const options) {
+    if (!reader || !path) {
+        printf("feReadingsOpen error: nullptr argument.\n");
+        return -1;
+    }
+    *reader = NULL;
+
+    FEReadingsReader* r = (FEReadingsReader*)calloc(1, sizeof(FEReadingsReader));
+    if (!r) {
+        printf("feReadingsOpen error: malloc failed.\n");
+        return -3;
+    }
+    if (options) r->options = *options;
+    else initFEReadingsOptions(&r->options);
+    if (r->options.chunkReadings == 0) r->options.chunkReadings = 4096;
+    if (r->options.bufferSize == 0) r->options.bufferSize = 1 << 20;
+    r->length = r->options.length;
+
+    if (r->options.format == FE_READINGS_BINARY && r->length == 0) {
+        printf("feReadingsOpen error: binary readings need a length.\n");
+        free(r);
+        return -2;
+    }
+
+    bool const useStdin = strcmp(path, "-") == 0;
+    if (useStdin || r->options.stream || mapFile(r, path) != 0) {
+        r->stream = useStdin ? stdin : fopen(path, "rb");
+        r->ownsStream = !useStdin;
+        r->buffer = (byte*)malloc(r->options.bufferSize);
+        if (!r->stream || !r->buffer) {
+            printf("feReadingsOpen error: cannot open %s.\n", path);
+            feReadingsClose(r);
+            return -2;
+        }
+    }
+    else if (r->options.format == FE_READINGS_BINARY && r->size % r->length != 0) {
+        printf("feReadingsOpen error: size of %s is not a multiple of %zu.\n", path, r->length);
+        feReadingsClose(r);
+        return -2;
+    }
+
+    bool const zeroCopy = r->options.format == FE_READINGS_BINARY && r->mapping;
+    if (r->length && !zeroCopy) {
+        r->chunk = (byte*)malloc(r->options.chunkReadings * r->length);
+        if (!r->chunk) {
+            printf("feReadingsOpen error: malloc failed.\n");
+            feReadingsClose(r);
+            return -3;
+        }
+    }
+
+    *reader = r;
+    return 0;
+}
+
+int feReadingsNext(FEReadingsReader *const reader, const unsigned char** readings, size_t* count) {
+    if (!reader || !readings || !count) {
+        printf("feReadingsNext error: nullptr argument.\n");
+        return -1;
+    }
+    *readings = NULL;
+    *count = 0;
+    if (reader->failed) return -2;
+
+    //  The previous chunk is no longer needed.
+    releaseConsumed(reader, reader->pos);
+
+    int ret = (reader->options.format == FE_READINGS_BINARY)
+            ? nextBinary(reader, readings, count)
+            : nextCSV(reader, readings, count);
+    if (ret < 0) {
+        reader->failed = true;
+        *readings = NULL;
+        *count = 0;
+    }
+    return ret;
+}
+
+size_t feReadingsLength(const FEReadingsReader *const reader) {
+    return reader ? reader->length : 0;
+}
+
+void feReadingsClose(FEReadingsReader* reader) {
+    if (!reader) return;
+    unmapFile(reader);
+    if (reader->stream && reader->ownsStream) fclose(reader->stream);
+    free(reader->buffer);
+    free(reader->chunk);
+    free(reader->row);
+    free(reader);
+}
+
+int feReadingsLoad(const char* path, FEReadingsFormat const format, size_t* length,
+        unsigned char** readings, size_t* count) {
+    if (!path || !length || !readings || !count) {
+        printf("feReadingsLoad error: nullptr argument.\n");
+        return -1;
+    }
+    *readings = NULL;
+    *count = 0;
+
+    FEReadingsOptions options;
+    initFEReadingsOptions(&options);
+    options.format = format;
+    options.length = *length;
+    FEReadingsReader* reader;
+    int ret = feReadingsOpen(&reader, path, &options);
+    if (ret != 0) return ret;
+
+    byte* all = NULL;
+    size_t total = 0;
+    size_t capacity = 0;
+    const byte* chunk;
+    size_t n;
+    while ((ret = feReadingsNext(reader, &chunk, &n)) == 1) {
+        size_t const len = feReadingsLength(reader);
+        if (total + n > capacity) {
+            capacity = (total + n > capacity * 2) ? total + n : capacity * 2;
+            byte* grown = (byte*)realloc(all, capacity * len);
+            if (!grown) {
+                printf("feReadingsLoad error: malloc failed.\n");
+                ret = -3;
+                break;
+            }
+            all = grown;
+        }
+        memcpy(all + total * len, chunk, n * len);
+        total += n;
+    }
+    *length = feReadingsLength(reader);
+    feReadingsClose(reader);
+
+    if (ret != 0) {
+        free(all);
+        return ret;
+    }
+    *readings = all;
+    *count = total;
+    return 0;
+}
@@ -0,0 +1,128 @@
+//########################################################################
+// (C) Embedded Systems Lab
+// All rights reserved.
+// ------------------------------------------------------------
+// This document contains proprietary information belonging to
+// Research & Development FH OÖ Forschungs und Entwicklungs GmbH.
+// Using, passing on and copying of this document or parts of it
+// is generally not permitted without prior written authorization.
+// ------------------------------------------------------------
+// info(at)embedded-lab.at
+// https://www.embedded-lab.at/
+//########################################################################
+// *** File name: FEReadings.h
+// *** Date of file creation: 2022-02-07
+// *** List of autors: Lucas Drack
+// ***
+// *** Chunked loading of fingerprint readings from CSV and binary files.
+//########################################################################
+
+#ifndef __FE_READINGS_H__
+#define __FE_READINGS_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//  Lab datasets hold millions of readings. A reader maps the file (or
+//  streams it through a fixed buffer) and hands out readings in chunks of
+//  up to chunkReadings, back to back as feReproduceBatch() and
+//  feEstimateErrorProfile() take them, so memory stays bounded by the chunk
+//  size whatever the file size.
+//
+//  CSV files hold one reading per line, its bytes as decimal numbers
+//  separated by ';' (or ','). Blank lines, empty fields, spaces and '\r'
+//  are ignored. Binary files are raw readings of length bytes each.
+
+typedef enum {
+    FE_READINGS_CSV,
+    FE_READINGS_BINARY
+} FEReadingsFormat;
+
+typedef struct FEReadingsReader FEReadingsReader;
+
+/*
+ * Struct: FEReadingsOptions
+ * --------------------
+ *  format:        File format (default: FE_READINGS_CSV)
+ *  length:        Bytes per reading. 0 takes it from the first CSV line;
+ *                 required for binary files.
+ *  chunkReadings: Most readings handed out per chunk (default: 4096)
+ *  stream:        Read through a buffer instead of mapping the file. Used
+ *                 anyway for path "-" (stdin) or if mapping fails.
+ *  bufferSize:    Bytes read at once when streaming (default: 1 MiB)
+ */
+typedef struct {
+    FEReadingsFormat format;
+    size_t length;
+    size_t chunkReadings;
+    bool stream;
+    size_t bufferSize;
+} FEReadingsOptions;
+
+void initFEReadingsOptions(FEReadingsOptions *const options);
+
+/*
+ * Function: feReadingsOpen
+ * --------------------
+ *   Opens path for chunked reading.
+ *
+ *   reader:  receives the reader. The caller MUST call feReadingsClose().
+ *   path:    the file, "-" for stdin
+ *   options: null for the defaults
+ *
+ *   returns: 0 on success, negative int otherwise
+ */
+int feReadingsOpen(FEReadingsReader** reader, const char* path, const FEReadingsOptions *const options);
+
+/*
+ * Function: feReadingsNext
+ * --------------------
+ *   Hands out the next chunk of readings. The chunk stays valid until the
+ *   next call or feReadingsClose().
+ *
+ *   readings: receives count * feReadingsLength() bytes
+ *   count:    receives the number of readings in the chunk
+ *
+ *   returns: 1 if a chunk was handed out, 0 at the end of the file,
+ *            negative int on malformed input or read errors
+ */
+int feReadingsNext(FEReadingsReader *const reader, const unsigned char** readings, size_t* count);
+
+/*
+ * Function: feReadingsLength
+ * --------------------
+ *   returns: bytes per reading, 0 for a CSV file before its first reading
+ */
+size_t feReadingsLength(const FEReadingsReader *const reader);
+
+/*
+ * Function: feReadingsClose
+ * --------------------
+ *   Releases the reader and its mapping or buffers.
+ */
+void feReadingsClose(FEReadingsReader* reader);
+
+/*
+ * Function: feReadingsLoad
+ * --------------------
+ *   Loads all readings of path into a single allocation.
+ *
+ *   length:   bytes per reading, 0 to take it from the first CSV line.
+ *             Receives the length.
+ *   readings: receives the readings. The caller MUST free() them.
+ *   count:    receives the number of readings
+ *
+ *   returns: 0 on success, negative int otherwise
+ */
+int feReadingsLoad(const char* path, FEReadingsFormat const format, size_t* length,
+        unsigned char** readings, size_t* count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __FE_READINGS_H__
@@ -0,0 +1,187 @@
+//########################################################################
+// (C) Embedded Systems Lab
+// All rights reserved.
+// ------------------------------------------------------------
+// This document contains proprietary information belonging to
+// Research & Development FH OÖ Forschungs und Entwicklungs GmbH.
+// Using, passing on and copying of this document or parts of it
+// is generally not permitted without prior written authorization.
+// ------------------------------------------------------------
+// info(at)embedded-lab.at
+// https://www.embedded-lab.at/
+//########################################################################
+// *** File name: FESession.c
+// *** Date of file creation: 2022-02-07
+// *** List of autors: Lucas Drack
+// ***
+// *** Labeled subkeys derived from one reproduced key.
+//########################################################################
+
+#include "FESession.h"
+#include "FEStats.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+// Internal data type for brevity.
+typedef unsigned char byte;
+
+//  Personalization of the BLAKE2b hash that turns a key into a master key.
+static const byte personal[crypto_generichash_blake2b_PERSONALBYTES] = "CFE master key";
+
+//  master is sodium_malloc()ed and only readable inside derive(); expiresNs
+//  is 0 for sessions without time limit. Guarded by lock.
+struct FESession {
+    pthread_mutex_t lock;
+    byte* master;
+    uint64_t expiresNs;
+};
+
+//  Reduces a key of any length to the 32 byte BLAKE2b key of the subkeys.
+static void masterKey(const byte key[], size_t const keyLen, byte master[crypto_kdf_KEYBYTES]) {
+    crypto_generichash_blake2b_salt_personal(master, crypto_kdf_KEYBYTES, key, keyLen,
+            NULL, 0, NULL, personal);
+}
+
+static void deriveFromMaster(const byte master[crypto_kdf_KEYBYTES], const char* label, uint64_t const id,
+        byte subkey[], size_t const subkeyLen) {
+    byte encoded[8];
+    size_t const labelLen = strlen(label);
+    crypto_generichash_state state;
+    crypto_generichash_init(&state, master, crypto_kdf_KEYBYTES, subkeyLen);
+
+    //  The label length keeps ("ab", id) and ("a", ...) apart.
+    for (size_t b = 0; b < 8; b++) encoded[b] = (byte)((uint64_t)labelLen >> (8 * b));
+    crypto_generichash_update(&state, encoded, sizeof(encoded));
+    crypto_generichash_update(&state, (const byte*)label, labelLen);
+    for (size_t b = 0; b < 8; b++) encoded[b] = (byte)(id >> (8 * b));
+    crypto_generichash_update(&state, encoded, sizeof(encoded));
+    crypto_generichash_final(&state, subkey, subkeyLen);
+    sodium_memzero(&state, sizeof(state));
+}
+
+static int checkSubkeyArgs(const char* caller, const char* label, const byte subkey[],
+        size_t const subkeyLen) {
+    if (!label || !subkey) {
+        printf("%s error: nullptr argument.\n", caller);
+        return -1;
+    }
+    if (subkeyLen < FE_SUBKEY_MIN || subkeyLen > FE_SUBKEY_MAX) {
+        printf("%s error: subkey length must be %d to %d bytes.\n", caller,
+                (int)FE_SUBKEY_MIN, (int)FE_SUBKEY_MAX);
+        return -2;
+    }
+    return 0;
+}
+
+int feDeriveSubkey(const unsigned char key[], size_t const keyLen, const char* label, uint64_t const id,
+        unsigned char subkey[], size_t const subkeyLen) {
+    int ret = checkSubkeyArgs("feDeriveSubkey", label, subkey, subkeyLen);
+    if (ret != 0) return ret;
+    if (!key || keyLen == 0) {
+        printf("feDeriveSubkey error: nullptr argument.\n");
+        return -1;
+    }
+
+    byte master[crypto_kdf_KEYBYTES];
+    masterKey(key, keyLen, master);
+    deriveFromMaster(master, label, id, subkey, subkeyLen);
+    sodium_memzero(master, sizeof(master));
+    return 0;
+}
+
+
+/**********************************************************/
+
+
+int feSessionFromKey(FESession** session, const unsigned char key[], size_t const len,
+        double const ttlSeconds) {
+    if (!session || !key || len == 0) {
+        printf("feSessionFromKey error: nullptr argument.\n");
+        return -1;
+    }
+    *session = 0;
+
+    FESession* s = (FESession*)calloc(1, sizeof(FESession));
+    byte* master = (byte*)sodium_malloc(crypto_kdf_KEYBYTES);
+    if (!s || !master) {
+        printf("feSessionFromKey error: malloc failed.\n");
+        free(s);
+        if (master) sodium_free(master);
+        return -3;
+    }
+    masterKey(key, len, master);
+    sodium_mprotect_noaccess(master);
+
+    pthread_mutex_init(&s->lock, NULL);
+    s->master = master;
+    s->expiresNs = 0;
+    if (ttlSeconds > 0.0) {
+        s->expiresNs = feStatsNow() + (uint64_t)(ttlSeconds * 1e9);
+    }
+    *session = s;
+    return 0;
+}
+
+int feSessionOpen(FESession** session, const unsigned char value[], size_t const len,
+        const HelperData *const h, double const ttlSeconds) {
+    if (!session || !value || !h) {
+        printf("feSessionOpen error: nullptr argument.\n");
+        return -1;
+    }
+    *session = 0;
+
+    byte key[len ? len : 1];
+    FEStats stats;
+    int ret = feReproduceStats(value, key, len, h, &stats);
+    if (ret == 0) ret = feSessionFromKey(session, key, len, ttlSeconds);
+    sodium_memzero(key, sizeof(key));
+    return ret;
+}
+
+//  Wipes and releases the master key. Called with the lock held.
+static void wipeMaster(FESession *const s) {
+    if (s->master) {
+        sodium_free(s->master);     // wipes before freeing
+        s->master = 0;
+    }
+}
+
+int feSessionDerive(FESession *const session, const char* label, uint64_t const id,
+        unsigned char subkey[], size_t const subkeyLen) {
+    if (!session) {
+        printf("feSessionDerive error: nullptr argument.\n");
+        return -1;
+    }
+    int ret = checkSubkeyArgs("feSessionDerive", label, subkey, subkeyLen);
+    if (ret != 0) return ret;
+
+    pthread_mutex_lock(&session->lock);
+    if (session->master && session->expiresNs && feStatsNow() >= session->expiresNs) {
+        wipeMaster(session);
+    }
+    if (!session->master) {
+        pthread_mutex_unlock(&session->lock);
+        return FE_SESSION_EXPIRED;
+    }
+    sodium_mprotect_readonly(session->master);
+    deriveFromMaster(session->master, label, id, subkey, subkeyLen);
+    sodium_mprotect_noaccess(session->master);
+    pthread_mutex_unlock(&session->lock);
+    return 0;
+}
+
+void feSessionExpire(FESession *const session) {
+    if (!session) return;
+    pthread_mutex_lock(&session->lock);
+    wipeMaster(session);
+    pthread_mutex_unlock(&session->lock);
+}
+
+void feSessionClose(FESession* session) {
+    if (!session) return;
+    feSessionExpire(session);
+    pthread_mutex_destroy(&session->lock);
+    free(session);
+}
@@ -0,0 +1,131 @@
+//########################################################################
+// (C) Embedded Systems Lab
+// All rights reserved.
+// ------------------------------------------------------------
+// This document contains proprietary information belonging to
+// Research & Development FH OÖ Forschungs und Entwicklungs GmbH.
+// Using, passing on and copying of this document or parts of it
+// is generally not permitted without prior written authorization.
+// ------------------------------------------------------------
+// info(at)embedded-lab.at
+// https://www.embedded-lab.at/
+//########################################################################
+// *** File name: FESession.h
+// *** Date of file creation: 2022-02-07
+// *** List of autors: Lucas Drack
+// ***
+// *** Labeled subkeys derived from one reproduced key.
+//########################################################################
+
+#ifndef __FE_SESSION_H__
+#define __FE_SESSION_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "CFuzzyExtractor.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//  A reproduced key is used as master key: separate keys for encryption,
+//  MAC, attestation etc. are derived from it with BLAKE2b instead of
+//  reproducing once per key. A subkey is
+//
+//      BLAKE2b(key = BLAKE2b-256(master), LE64(len(label)) || label || LE64(id))
+//
+//  with subkeyLen bytes of output, so different labels, ids or lengths give
+//  independent keys, and a subkey reveals nothing about the master key or
+//  other subkeys.
+//
+//  A session keeps the master key of one unlock for further derivations.
+//  It lives in guarded memory (sodium_malloc(): guard pages, locked against
+//  swapping, wiped on release) that is inaccessible except while deriving.
+//  No timer runs in the background: after the lifetime has passed, the key
+//  stays in that memory until the first feSessionDerive() afterwards, an
+//  feSessionExpire() or feSessionClose() wipes it. Call feSessionExpire()
+//  when the key must not outlive its use, e.g. on logout.
+
+#define FE_SUBKEY_MIN   crypto_generichash_BYTES_MIN
+#define FE_SUBKEY_MAX   crypto_generichash_BYTES_MAX
+
+//  Result code in addition to the usual negative errors.
+#define FE_SESSION_EXPIRED  -6
+
+typedef struct FESession FESession;
+
+/*
+ * Function: feDeriveSubkey
+ * --------------------
+ *   Derives the subkey named label and id from a master key.
+ *
+ *   key:       the master key, e.g. from feReproduce(), keyLen bytes
+ *   label:     purpose of the subkey, e.g. "encryption" (null-terminated)
+ *   id:        number of the subkey within label, e.g. a key version
+ *   subkey:    receives subkeyLen bytes, FE_SUBKEY_MIN to FE_SUBKEY_MAX
+ *
+ *   returns: 0 on success, negative int otherwise
+ */
+int feDeriveSubkey(const unsigned char key[], size_t const keyLen, const char* label, uint64_t const id,
+        unsigned char subkey[], size_t const subkeyLen);
+
+/*
+ * Function: feSessionOpen
+ * --------------------
+ *   Reproduces the key of h from value once and keeps it as the master key
+ *   of a session.
+ *
+ *   session:    receives the session. The caller MUST call feSessionClose().
+ *   value, len, h: see feReproduce()
+ *   ttlSeconds: lifetime of the session, 0 for no limit. Derivations
+ *               after it fail; the key is wiped by the first of them.
+ *
+ *   returns: 0 on success, -4 if no locker opened, other negative int otherwise
+ */
+int feSessionOpen(FESession** session, const unsigned char value[], size_t const len,
+        const HelperData *const h, double const ttlSeconds);
+
+/*
+ * Function: feSessionFromKey
+ * --------------------
+ *   Starts a session from a key the caller already holds, e.g. the one
+ *   feGenerate() returned at enrollment. key is copied. ttlSeconds: see
+ *   feSessionOpen().
+ *
+ *   returns: 0 on success, negative int otherwise
+ */
+int feSessionFromKey(FESession** session, const unsigned char key[], size_t const len,
+        double const ttlSeconds);
+
+/*
+ * Function: feSessionDerive
+ * --------------------
+ *   feDeriveSubkey() with the master key of session. Thread-safe.
+ *
+ *   returns: 0 on success, FE_SESSION_EXPIRED if the session expired (the
+ *            master key is wiped then), other negative int otherwise
+ */
+int feSessionDerive(FESession *const session, const char* label, uint64_t const id,
+        unsigned char subkey[], size_t const subkeyLen);
+
+/*
+ * Function: feSessionExpire
+ * --------------------
+ *   Wipes the master key now, e.g. on logout. Later derivations return
+ *   FE_SESSION_EXPIRED.
+ */
+void feSessionExpire(FESession *const session);
+
+/*
+ * Function: feSessionClose
+ * --------------------
+ *   Wipes the master key and frees the session.
+ */
+void feSessionClose(FESession* session);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __FE_SESSION_H__
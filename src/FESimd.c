@@ -0,0 +1,248 @@
+//########################################################################
+// (C) Embedded Systems Lab
+// All rights reserved.
+// ------------------------------------------------------------
+// This document contains proprietary information belonging to
+// Research & Development FH OÖ Forschungs und Entwicklungs GmbH.
+// Using, passing on and copying of this document or parts of it
+// is generally not permitted without prior written authorization.
+// ------------------------------------------------------------
+// info(at)embedded-lab.at
+// https://www.embedded-lab.at/
+//########################################################################
+// *** File name: FESimd.c
+// *** Date of file creation: 2022-02-07
+// *** List of autors: Lucas Drack
+// ***
+// *** Vectorized byte kernels for masking and unlocking lockers.
+//########################################################################
+
+#include "FESimd.h"
+
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define FE_SIMD_X86 1
+#include <immintrin.h>
+#endif
+#if defined(__aarch64__) && defined(__ARM_NEON)
+#define FE_SIMD_NEON 1
+#include <arm_neon.h>
+#endif
+
+// Internal data type for brevity.
+typedef unsigned char byte;
+
+typedef void (*BinaryKernel)(byte dst[], const byte a[], const byte b[], size_t const n);
+typedef bool (*CompareKernel)(const byte a[], const byte b[], size_t const n);
+
+typedef struct {
+    const char* name;
+    BinaryKernel maskAnd;
+    BinaryKernel xor;
+    CompareKernel xorIsZero;
+} SimdKernels;
+
+
+//  Scalar fallback, 8 bytes at a time. memcpy keeps the loads unaligned-safe.
+
+static void maskAndScalar(byte dst[], const byte a[], const byte b[], size_t const n) {
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        uint64_t x, y;
+        memcpy(&x, a + i, 8);
+        memcpy(&y, b + i, 8);
+        x &= y;
+        memcpy(dst + i, &x, 8);
+    }
+    for (; i < n; i++) dst[i] = a[i] & b[i];
+}
+
+static void xorScalar(byte dst[], const byte a[], const byte b[], size_t const n) {
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        uint64_t x, y;
+        memcpy(&x, a + i, 8);
+        memcpy(&y, b + i, 8);
+        x ^= y;
+        memcpy(dst + i, &x, 8);
+    }
+    for (; i < n; i++) dst[i] = a[i] ^ b[i];
+}
+
+static bool xorIsZeroScalar(const byte a[], const byte b[], size_t const n) {
+    uint64_t acc = 0;
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        uint64_t x, y;
+        memcpy(&x, a + i, 8);
+        memcpy(&y, b + i, 8);
+        acc |= x ^ y;
+    }
+    for (; i < n; i++) acc |= (uint64_t)(a[i] ^ b[i]);
+    return acc == 0;
+}
+
+
+#ifdef FE_SIMD_X86
+
+__attribute__((target("avx2")))
+static void maskAndAvx2(byte dst[], const byte a[], const byte b[], size_t const n) {
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m256i x = _mm256_loadu_si256((const __m256i*)(a + i));
+        __m256i y = _mm256_loadu_si256((const __m256i*)(b + i));
+        _mm256_storeu_si256((__m256i*)(dst + i), _mm256_and_si256(x, y));
+    }
+    maskAndScalar(dst + i, a + i, b + i, n - i);
+}
+
+__attribute__((target("avx2")))
+static void xorAvx2(byte dst[], const byte a[], const byte b[], size_t const n) {
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m256i x = _mm256_loadu_si256((const __m256i*)(a + i));
+        __m256i y = _mm256_loadu_si256((const __m256i*)(b + i));
+        _mm256_storeu_si256((__m256i*)(dst + i), _mm256_xor_si256(x, y));
+    }
+    xorScalar(dst + i, a + i, b + i, n - i);
+}
+
+__attribute__((target("avx2")))
+static bool xorIsZeroAvx2(const byte a[], const byte b[], size_t const n) {
+    __m256i acc = _mm256_setzero_si256();
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m256i x = _mm256_loadu_si256((const __m256i*)(a + i));
+        __m256i y = _mm256_loadu_si256((const __m256i*)(b + i));
+        acc = _mm256_or_si256(acc, _mm256_xor_si256(x, y));
+    }
+    return _mm256_testz_si256(acc, acc) && xorIsZeroScalar(a + i, b + i, n - i);
+}
+
+__attribute__((target("avx512f,avx512bw")))
+static void maskAndAvx512(byte dst[], const byte a[], const byte b[], size_t const n) {
+    size_t i = 0;
+    for (; i + 64 <= n; i += 64) {
+        __m512i x = _mm512_loadu_si512((const void*)(a + i));
+        __m512i y = _mm512_loadu_si512((const void*)(b + i));
+        _mm512_storeu_si512((void*)(dst + i), _mm512_and_si512(x, y));
+    }
+    if (i < n) {
+        // Masked load/store for the tail instead of a scalar loop.
+        __mmask64 m = (n - i == 64) ? ~(__mmask64)0 : (((__mmask64)1 << (n - i)) - 1);
+        __m512i x = _mm512_maskz_loadu_epi8(m, a + i);
+        __m512i y = _mm512_maskz_loadu_epi8(m, b + i);
+        _mm512_mask_storeu_epi8(dst + i, m, _mm512_and_si512(x, y));
+    }
+}
+
+__attribute__((target("avx512f,avx512bw")))
+static void xorAvx512(byte dst[], const byte a[], const byte b[], size_t const n) {
+    size_t i = 0;
+    for (; i + 64 <= n; i += 64) {
+        __m512i x = _mm512_loadu_si512((const void*)(a + i));
+        __m512i y = _mm512_loadu_si512((const void*)(b + i));
+        _mm512_storeu_si512((void*)(dst + i), _mm512_xor_si512(x, y));
+    }
+    if (i < n) {
+        __mmask64 m = (n - i == 64) ? ~(__mmask64)0 : (((__mmask64)1 << (n - i)) - 1);
+        __m512i x = _mm512_maskz_loadu_epi8(m, a + i);
+        __m512i y = _mm512_maskz_loadu_epi8(m, b + i);
+        _mm512_mask_storeu_epi8(dst + i, m, _mm512_xor_si512(x, y));
+    }
+}
+
+__attribute__((target("avx512f,avx512bw")))
+static bool xorIsZeroAvx512(const byte a[], const byte b[], size_t const n) {
+    __m512i acc = _mm512_setzero_si512();
+    size_t i = 0;
+    for (; i + 64 <= n; i += 64) {
+        __m512i x = _mm512_loadu_si512((const void*)(a + i));
+        __m512i y = _mm512_loadu_si512((const void*)(b + i));
+        acc = _mm512_or_si512(acc, _mm512_xor_si512(x, y));
+    }
+    if (i < n) {
+        __mmask64 m = (n - i == 64) ? ~(__mmask64)0 : (((__mmask64)1 << (n - i)) - 1);
+        __m512i x = _mm512_maskz_loadu_epi8(m, a + i);
+        __m512i y = _mm512_maskz_loadu_epi8(m, b + i);
+        acc = _mm512_or_si512(acc, _mm512_xor_si512(x, y));
+    }
+    return _mm512_test_epi64_mask(acc, acc) == 0;
+}
+
+#endif // FE_SIMD_X86
+
+
+#ifdef FE_SIMD_NEON
+
+static void maskAndNeon(byte dst[], const byte a[], const byte b[], size_t const n) {
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        vst1q_u8(dst + i, vandq_u8(vld1q_u8(a + i), vld1q_u8(b + i)));
+    }
+    maskAndScalar(dst + i, a + i, b + i, n - i);
+}
+
+static void xorNeon(byte dst[], const byte a[], const byte b[], size_t const n) {
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        vst1q_u8(dst + i, veorq_u8(vld1q_u8(a + i), vld1q_u8(b + i)));
+    }
+    xorScalar(dst + i, a + i, b + i, n - i);
+}
+
+static bool xorIsZeroNeon(const byte a[], const byte b[], size_t const n) {
+    uint8x16_t acc = vdupq_n_u8(0);
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        acc = vorrq_u8(acc, veorq_u8(vld1q_u8(a + i), vld1q_u8(b + i)));
+    }
+    return vmaxvq_u8(acc) == 0 && xorIsZeroScalar(a + i, b + i, n - i);
+}
+
+#endif // FE_SIMD_NEON
+
+
+static SimdKernels kernels = { "scalar", maskAndScalar, xorScalar, xorIsZeroScalar };
+static pthread_once_t kernelsOnce = PTHREAD_ONCE_INIT;
+
+static void selectKernels(void) {
+#ifdef FE_SIMD_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw")) {
+        kernels = (SimdKernels){ "avx512", maskAndAvx512, xorAvx512, xorIsZeroAvx512 };
+        return;
+    }
+    if (__builtin_cpu_supports("avx2")) {
+        kernels = (SimdKernels){ "avx2", maskAndAvx2, xorAvx2, xorIsZeroAvx2 };
+        return;
+    }
+#endif
+#ifdef FE_SIMD_NEON
+    kernels = (SimdKernels){ "neon", maskAndNeon, xorNeon, xorIsZeroNeon };
+#endif
+}
+
+static const SimdKernels* getKernels(void) {
+    pthread_once(&kernelsOnce, selectKernels);
+    return &kernels;
+}
+
+void feMaskAnd(unsigned char dst[], const unsigned char a[], const unsigned char b[], size_t const n) {
+    getKernels()->maskAnd(dst, a, b, n);
+}
+
+void feXor(unsigned char dst[], const unsigned char a[], const unsigned char b[], size_t const n) {
+    getKernels()->xor(dst, a, b, n);
+}
+
+bool feXorIsZero(const unsigned char a[], const unsigned char b[], size_t const n) {
+    return getKernels()->xorIsZero(a, b, n);
+}
+
+const char* feSimdName(void) {
+    return getKernels()->name;
+}
@@ -0,0 +1,70 @@
+//########################################################################
+// (C) Embedded Systems Lab
+// All rights reserved.
+// ------------------------------------------------------------
+// This document contains proprietary information belonging to
+// Research & Development FH OÖ Forschungs und Entwicklungs GmbH.
+// Using, passing on and copying of this document or parts of it
+// is generally not permitted without prior written authorization.
+// ------------------------------------------------------------
+// info(at)embedded-lab.at
+// https://www.embedded-lab.at/
+//########################################################################
+// *** File name: FESimd.h
+// *** Date of file creation: 2022-02-07
+// *** List of autors: Lucas Drack
+// ***
+// *** Vectorized byte kernels for masking and unlocking lockers.
+//########################################################################
+
+#ifndef __FE_SIMD_H__
+#define __FE_SIMD_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//  With 16 byte fingerprints the byte loops around the locker hash cost
+//  nothing, but with kilobyte-sized SRAM fingerprints they run
+//  numHelpers * length times. These kernels are selected once at runtime:
+//  AVX-512 or AVX2 on x86 (if the CPU supports it), NEON on ARM64, and a
+//  portable word-at-a-time fallback otherwise.
+
+/*
+ * Function: feMaskAnd
+ * --------------------
+ *   dst[i] = a[i] & b[i] for i < n. dst may alias a or b.
+ */
+void feMaskAnd(unsigned char dst[], const unsigned char a[], const unsigned char b[], size_t const n);
+
+/*
+ * Function: feXor
+ * --------------------
+ *   dst[i] = a[i] ^ b[i] for i < n. dst may alias a or b.
+ */
+void feXor(unsigned char dst[], const unsigned char a[], const unsigned char b[], size_t const n);
+
+/*
+ * Function: feXorIsZero
+ * --------------------
+ *   returns: true if a[i] == b[i] for all i < n, i.e. the XOR of both is
+ *            all zero. Used to check the zero padding of an unlocked locker
+ *            without storing it.
+ */
+bool feXorIsZero(const unsigned char a[], const unsigned char b[], size_t const n);
+
+/*
+ * Function: feSimdName
+ * --------------------
+ *   returns: name of the selected kernel set ("avx512", "avx2", "neon" or "scalar")
+ */
+const char* feSimdName(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __FE_SIMD_H__
@@ -0,0 +1,507 @@
+//########################################################################
+// (C) Embedded Systems Lab
+// All rights reserved.
+// ------------------------------------------------------------
+// This document contains proprietary information belonging to
+// Research & Development FH OÖ Forschungs und Entwicklungs GmbH.
+// Using, passing on and copying of this document or parts of it
+// is generally not permitted without prior written authorization.
+// ------------------------------------------------------------
+// info(at)embedded-lab.at
+// https://www.embedded-lab.at/
+//########################################################################
+// *** File name: FESimulate.c
+// *** Date of file creation: 2022-02-07
+// *** List of autors: Lucas Drack
+// ***
+// *** Monte Carlo simulation of false rejection and acceptance rates.
+//########################################################################
+
+#include "FESimulate.h"
+#include "FEStats.h"
+
+#include <math.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+// Internal data type for brevity.
+typedef unsigned char byte;
+
+//  Trials a worker claims at once.
+#define SIM_BATCH 16
+
+static uint64_t splitmix64(uint64_t* x) {
+    uint64_t z = (*x += 0x9e3779b97f4a7c15ull);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+}
+
+static uint64_t rotl(uint64_t const x, int const k) {
+    return (x << k) | (x >> (64 - k));
+}
+
+void feSimSeed(FESimRandom *const rng, uint64_t const seed) {
+    if (!rng) return;
+    uint64_t x = seed;
+    for (size_t j = 0; j < 4; j++) rng->s[j] = splitmix64(&x);
+}
+
+uint64_t feSimNext(FESimRandom *const rng) {
+    uint64_t *const s = rng->s;
+    uint64_t const result = rotl(s[1] * 5, 7) * 9;
+    uint64_t const t = s[1] << 17;
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = rotl(s[3], 45);
+    return result;
+}
+
+double feSimUniform(FESimRandom *const rng) {
+    return (double)(feSimNext(rng) >> 11) * 0x1.0p-53;
+}
+
+static void randomBytes(FESimRandom *const rng, byte out[], size_t const n) {
+    for (size_t j = 0; j < n; j += 8) {
+        uint64_t r = feSimNext(rng);
+        for (size_t b = 0; b < 8 && j + b < n; b++) out[j + b] = (byte)(r >> (8 * b));
+    }
+}
+
+
+/**********************************************************/
+
+
+void initFENoiseModel(FENoiseModel *const noise, FENoiseKind const kind) {
+    if (!noise) return;
+    noise->kind = kind;
+    noise->hamming = 0;
+    noise->flipRate = 0.0;
+    noise->profile = 0;
+    noise->driftPerKelvin = 0.0;
+    noise->deltaKelvin = 0.0;
+    noise->custom = 0;
+    noise->userData = 0;
+}
+
+void initFESimulateOptions(FESimulateOptions *const options) {
+    if (!options) return;
+    options->trials = 1000;
+    options->readingsPerTrial = 10;
+    options->impostorsPerTrial = 10;
+    options->numThreads = 0;
+    options->hash = FE_SIM_LOCKER;
+    options->confidence = 0.95;
+    options->seed = 0;
+}
+
+void initFESimulation(FESimulation *const result) {
+    if (!result) return;
+    memset(result, 0, sizeof(FESimulation));
+}
+
+void freeFESimulation(FESimulation *const result) {
+    if (!result) return;
+    free(result->lockersTried);
+    initFESimulation(result);
+}
+
+void printFESimulation(const FESimulation *const result) {
+    if (!result) return;
+    printf("\n*** Simulation ***\n");
+    printf("FRR: %g [%g, %g] (%llu of %llu)\n", result->frr, result->frrLow, result->frrHigh,
+            (unsigned long long)result->falseRejects, (unsigned long long)result->genuine);
+    printf("FAR: %g [%g, %g] (%llu of %llu)\n", result->far, result->farLow, result->farHigh,
+            (unsigned long long)result->falseAccepts, (unsigned long long)result->impostor);
+    printf("Accidental openings: %llu\n", (unsigned long long)result->falseOpens);
+    printf("Lockers tried: mean %.2f, p50 %zu, p90 %zu, p99 %zu of %zu\n", result->meanLockersTried,
+            result->p50LockersTried, result->p90LockersTried, result->p99LockersTried, result->numHelpers);
+    printf("Time: %.3f s\n", result->seconds);
+}
+
+
+/**********************************************************/
+
+
+static void flipBit(byte value[], size_t const b) {
+    value[b / 8] ^= (byte)(1 << (b % 8));
+}
+
+//  Flips every bit of reading with its rate: rates[b], or rate for all.
+static void flipBits(FESimRandom *const rng, byte reading[], size_t const len,
+        const double* rates, double const rate) {
+    for (size_t b = 0; b < len * 8; b++) {
+        if (feSimUniform(rng) < (rates ? rates[b] : rate)) flipBit(reading, b);
+    }
+}
+
+//  Bits that drift with temperature for one device, see FE_NOISE_DRIFT.
+static void driftMask(const FENoiseModel *const noise, FESimRandom *const rng, byte drift[], size_t const len) {
+    memset(drift, 0, len);
+    if (noise->kind != FE_NOISE_DRIFT) return;
+    double rate = noise->driftPerKelvin * fabs(noise->deltaKelvin);
+    flipBits(rng, drift, len, 0, rate < 1.0 ? rate : 1.0);
+}
+
+static void noisyReading(const FENoiseModel *const noise, FESimRandom *const rng, const byte enrolled[],
+        const byte drift[], byte reading[], size_t const len) {
+    memcpy(reading, enrolled, len);
+    switch (noise->kind) {
+        case FE_NOISE_HAMMING: {
+            //  Floyd's algorithm: a position that already flipped is
+            //  replaced by the top one, which cannot have been picked yet.
+            size_t const bits = len * 8;
+            size_t const count = noise->hamming < bits ? noise->hamming : bits;
+            for (size_t top = bits - count; top < bits; top++) {
+                size_t b = (size_t)(feSimNext(rng) % (top + 1));
+                if ((reading[b / 8] ^ enrolled[b / 8]) & (1 << (b % 8))) b = top;
+                flipBit(reading, b);
+            }
+            break;
+        }
+        case FE_NOISE_IID:
+            flipBits(rng, reading, len, 0, noise->flipRate);
+            break;
+        case FE_NOISE_PROFILE:
+            flipBits(rng, reading, len, noise->profile->bitErrorRates, 0.0);
+            break;
+        case FE_NOISE_DRIFT:
+            for (size_t j = 0; j < len; j++) reading[j] ^= drift[j];
+            flipBits(rng, reading, len, noise->profile ? noise->profile->bitErrorRates : 0, noise->flipRate);
+            break;
+        case FE_NOISE_CUSTOM:
+            noise->custom(enrolled, reading, len, rng, noise->userData);
+            break;
+    }
+}
+
+
+/**********************************************************/
+
+
+//  State shared by all workers of one feSimulate() call. Trials are handed
+//  out in batches from next; every worker merges its counts under lock.
+typedef struct {
+    FEProperties p;
+    const FENoiseModel* noise;
+    FESimulateOptions o;
+    size_t selectorLen;
+
+    atomic_uint_fast64_t next;
+    pthread_mutex_t lock;
+    FESimulation* result;
+    int error;
+} SimJob;
+
+//  Counts of one worker.
+typedef struct {
+    uint64_t genuine;
+    uint64_t falseRejects;
+    uint64_t impostor;
+    uint64_t falseAccepts;
+    uint64_t falseOpens;
+    uint64_t* lockersTried;
+} SimCounts;
+
+//  Random masks (or sampled bit positions) of the lockers of one trial for
+//  FE_SIM_COMPARE, as allocateSampledHelperData() would pick them.
+static void randomSelectors(const SimJob *const job, FESimRandom *const rng, byte selectors[]) {
+    size_t const n = job->p.numHelpers;
+    if (!job->p.sampleBits) {
+        randomBytes(rng, selectors, n * job->p.length);
+        return;
+    }
+    size_t const k = job->p.sampleBits;
+    size_t const bits = job->p.length * 8;
+    for (size_t i = 0; i < n; i++) {
+        uint32_t* indices = (uint32_t*)(selectors + i * job->selectorLen);
+        for (size_t j = 0; j < k; j++) {
+            size_t top = bits - k + j;
+            uint32_t t = (uint32_t)(feSimNext(rng) % (top + 1));
+            bool taken = false;
+            for (size_t m = 0; m < j && !taken; m++) taken = (indices[m] == t);
+            indices[j] = taken ? (uint32_t)top : t;
+        }
+    }
+}
+
+//  FE_SIM_COMPARE: index + 1 of the first locker whose selected bits of
+//  reading equal those of the enrolled value, 0 if none.
+static size_t firstOpening(const SimJob *const job, const byte selectors[], const byte enrolled[],
+        const byte reading[]) {
+    size_t const len = job->p.length;
+    byte diff[len];
+    for (size_t j = 0; j < len; j++) diff[j] = enrolled[j] ^ reading[j];
+
+    for (size_t i = 0; i < job->p.numHelpers; i++) {
+        const byte* sel = selectors + i * job->selectorLen;
+        bool open = true;
+        if (job->p.sampleBits) {
+            const uint32_t* indices = (const uint32_t*)sel;
+            for (size_t j = 0; j < job->p.sampleBits && open; j++) {
+                open = !(diff[indices[j] / 8] & (1 << (indices[j] % 8)));
+            }
+        }
+        else {
+            for (size_t j = 0; j < len && open; j++) open = !(diff[j] & sel[j]);
+        }
+        if (open) return i + 1;
+    }
+    return 0;
+}
+
+//  One reproduction of a trial. *tried receives the lockers tried if the
+//  enrolled key came out, 0 otherwise.
+//
+//  returns: 0 on success, negative int on error
+static int reproduceTrial(SimJob *const job, SimCounts *const counts, const HelperData *const h,
+        const byte selectors[], const byte enrolled[], const byte key[], const byte reading[], size_t* tried) {
+    *tried = 0;
+    if (job->o.hash == FE_SIM_COMPARE) {
+        *tried = firstOpening(job, selectors, enrolled, reading);
+        return 0;
+    }
+
+    byte reproduced[job->p.length];
+    FEStats stats;
+    int ret = feReproduceStats(reading, reproduced, job->p.length, h, &stats);
+    if (ret == 0) {
+        if (sodium_memcmp(reproduced, key, job->p.length) == 0) *tried = (size_t)stats.lockersTried;
+        else counts->falseOpens++;
+    }
+    else if (ret != -4) {
+        return ret;
+    }
+    return 0;
+}
+
+static int runTrial(SimJob *const job, SimCounts *const counts, uint64_t const t, HelperData *const h,
+        byte selectors[]) {
+    size_t const len = job->p.length;
+    byte enrolled[len];
+    byte key[len];
+    byte drift[len];
+    byte reading[len];
+    FESimRandom rng;
+    feSimSeed(&rng, job->o.seed ^ (t * 0xd1b54a32d192ed03ull));
+
+    randomBytes(&rng, enrolled, len);
+    driftMask(job->noise, &rng, drift, len);
+    if (job->o.hash == FE_SIM_COMPARE) {
+        randomSelectors(job, &rng, selectors);
+    }
+    else if (feGenerate(enrolled, key, len, h, &job->p) != 0) {
+        return -3;
+    }
+
+    size_t tried;
+    for (size_t r = 0; r < job->o.readingsPerTrial; r++) {
+        noisyReading(job->noise, &rng, enrolled, drift, reading, len);
+        int ret = reproduceTrial(job, counts, h, selectors, enrolled, key, reading, &tried);
+        if (ret != 0) return ret;
+        counts->genuine++;
+        if (tried) counts->lockersTried[tried]++;
+        else counts->falseRejects++;
+    }
+    for (size_t r = 0; r < job->o.impostorsPerTrial; r++) {
+        randomBytes(&rng, reading, len);
+        int ret = reproduceTrial(job, counts, h, selectors, enrolled, key, reading, &tried);
+        if (ret != 0) return ret;
+        counts->impostor++;
+        if (tried) counts->falseAccepts++;
+    }
+    return 0;
+}
+
+static void* simulateWorker(void* arg) {
+    SimJob *const job = (SimJob*)arg;
+    size_t const n = job->p.numHelpers;
+    SimCounts counts;
+    memset(&counts, 0, sizeof(counts));
+    counts.lockersTried = (uint64_t*)calloc(n + 1, sizeof(uint64_t));
+    byte* selectors = 0;
+    if (job->o.hash == FE_SIM_COMPARE) selectors = (byte*)malloc(n * job->selectorLen + 1);
+    HelperData h;
+    initHelperData(&h);
+
+    int ret = (!counts.lockersTried || (job->o.hash == FE_SIM_COMPARE && !selectors)) ? -3 : 0;
+    while (ret == 0) {
+        pthread_mutex_lock(&job->lock);
+        bool failed = job->error != 0;
+        pthread_mutex_unlock(&job->lock);
+        if (failed) break;
+
+        uint64_t first = atomic_fetch_add_explicit(&job->next, SIM_BATCH, memory_order_relaxed);
+        if (first >= job->o.trials) break;
+        uint64_t last = first + SIM_BATCH;
+        if (last > job->o.trials) last = job->o.trials;
+        for (uint64_t t = first; t < last && ret == 0; t++) {
+            ret = runTrial(job, &counts, t, &h, selectors);
+        }
+    }
+
+    pthread_mutex_lock(&job->lock);
+    if (ret != 0) {
+        job->error = ret;
+    }
+    else {
+        FESimulation *const r = job->result;
+        r->genuine += counts.genuine;
+        r->falseRejects += counts.falseRejects;
+        r->impostor += counts.impostor;
+        r->falseAccepts += counts.falseAccepts;
+        r->falseOpens += counts.falseOpens;
+        for (size_t i = 0; i <= n; i++) r->lockersTried[i] += counts.lockersTried[i];
+    }
+    pthread_mutex_unlock(&job->lock);
+
+    freeHelperData(&h);
+    free(selectors);
+    free(counts.lockersTried);
+    return NULL;
+}
+
+
+/**********************************************************/
+
+
+//  Inverse of the standard normal CDF (Acklam's rational approximation,
+//  relative error below 1.2e-9).
+static double normalQuantile(double const q) {
+    static const double a[] = { -3.969683028665376e+01, 2.209460984245205e+02, -2.759285104469687e+02,
+                                 1.383577518672690e+02, -3.066479806614716e+01, 2.506628277459239e+00 };
+    static const double b[] = { -5.447609879822406e+01, 1.615858368580409e+02, -1.556989798598866e+02,
+                                 6.680131188771972e+01, -1.328068155288572e+01 };
+    static const double c[] = { -7.784894002430293e-03, -3.223964580411365e-01, -2.400758277161838e+00,
+                                -2.549732539343734e+00, 4.374664141464968e+00, 2.938163982698783e+00 };
+    static const double d[] = { 7.784695709041462e-03, 3.224671290700398e-01, 2.445134137142996e+00,
+                                3.754408661907416e+00 };
+    if (q <= 0.0) return -INFINITY;
+    if (q >= 1.0) return INFINITY;
+    if (q < 0.02425 || q > 1.0 - 0.02425) {
+        double r = sqrt(-2.0 * log(q < 0.5 ? q : 1.0 - q));
+        double x = (((((c[0] * r + c[1]) * r + c[2]) * r + c[3]) * r + c[4]) * r + c[5]) /
+                   ((((d[0] * r + d[1]) * r + d[2]) * r + d[3]) * r + 1.0);
+        return (q < 0.5) ? x : -x;
+    }
+    double u = q - 0.5;
+    double r = u * u;
+    return (((((a[0] * r + a[1]) * r + a[2]) * r + a[3]) * r + a[4]) * r + a[5]) * u /
+           (((((b[0] * r + b[1]) * r + b[2]) * r + b[3]) * r + b[4]) * r + 1.0);
+}
+
+//  Rate k / n with its Wilson score interval for quantile z.
+static void wilson(uint64_t const k, uint64_t const n, double const z, double* rate, double* low, double* high) {
+    if (n == 0) {
+        *rate = 0.0;
+        *low = 0.0;
+        *high = 1.0;
+        return;
+    }
+    double const p = (double)k / (double)n;
+    double const z2n = z * z / (double)n;
+    double const center = (p + z2n / 2.0) / (1.0 + z2n);
+    double const half = z * sqrt(p * (1.0 - p) / (double)n + z2n / (4.0 * (double)n)) / (1.0 + z2n);
+    *rate = p;
+    *low = (k > 0 && center - half > 0.0) ? center - half : 0.0;
+    *high = (k < n && center + half < 1.0) ? center + half : 1.0;
+}
+
+static size_t percentile(const uint64_t hist[], size_t const buckets, uint64_t const total, double const q) {
+    uint64_t const rank = (uint64_t)ceil(q * (double)total);
+    uint64_t seen = 0;
+    for (size_t i = 0; i < buckets; i++) {
+        seen += hist[i];
+        if (seen >= rank && seen > 0) return i;
+    }
+    return 0;
+}
+
+int feSimulate(const FEProperties *const p, const FENoiseModel *const noise,
+        const FESimulateOptions *const options, FESimulation *const result) {
+    if (!p || !noise || !result) {
+        printf("feSimulate error: nullptr argument.\n");
+        return -1;
+    }
+    initFESimulation(result);
+    FESimulateOptions o;
+    if (options) o = *options;
+    else initFESimulateOptions(&o);
+    if (o.numThreads == 0) o.numThreads = feNumCPUs();
+    if (o.seed == 0) randombytes_buf(&o.seed, sizeof(o.seed));
+    if (!(o.confidence > 0.0 && o.confidence < 1.0)) o.confidence = 0.95;
+
+    if ((noise->kind == FE_NOISE_PROFILE && !noise->profile) ||
+        (noise->kind == FE_NOISE_CUSTOM && !noise->custom) ||
+        (noise->profile && (!noise->profile->bitErrorRates || noise->profile->length != p->length))) {
+        printf("feSimulate error: noise model does not fit the properties.\n");
+        return -2;
+    }
+    if (p->sampleBits > p->length * 8) {
+        printf("feSimulate error: more sample bits than the value has.\n");
+        return -2;
+    }
+
+    SimJob job;
+    job.p = *p;
+    if (o.hash == FE_SIM_BLAKE2B) initLockerParams(&job.p.locker, LOCKER_BLAKE2B);
+    job.noise = noise;
+    job.o = o;
+    job.selectorLen = p->sampleBits ? p->sampleBits * sizeof(uint32_t) : p->length;
+    job.result = result;
+    job.error = 0;
+    atomic_init(&job.next, 0);
+    pthread_mutex_init(&job.lock, NULL);
+
+    result->numHelpers = p->numHelpers;
+    result->lockersTried = (uint64_t*)calloc(p->numHelpers + 1, sizeof(uint64_t));
+    if (!result->lockersTried) {
+        printf("feSimulate error: malloc failed.\n");
+        pthread_mutex_destroy(&job.lock);
+        return -3;
+    }
+
+    //  The calling thread is one of the workers.
+    uint64_t const startNs = feStatsNow();
+    pthread_t threads[o.numThreads];
+    size_t started = 0;
+    for (; started + 1 < o.numThreads; started++) {
+        if (pthread_create(&threads[started], NULL, simulateWorker, &job) != 0) break;
+    }
+    simulateWorker(&job);
+    for (size_t t = 0; t < started; t++) {
+        pthread_join(threads[t], NULL);
+    }
+    pthread_mutex_destroy(&job.lock);
+    result->seconds = (double)(feStatsNow() - startNs) / 1e9;
+
+    if (job.error) {
+        printf("feSimulate error: a trial failed.\n");
+        freeFESimulation(result);
+        return job.error;
+    }
+
+    double const z = normalQuantile(0.5 + o.confidence / 2.0);
+    wilson(result->falseRejects, result->genuine, z, &result->frr, &result->frrLow, &result->frrHigh);
+    wilson(result->falseAccepts, result->impostor, z, &result->far, &result->farLow, &result->farHigh);
+
+    uint64_t accepted = 0;
+    double sum = 0.0;
+    for (size_t i = 0; i <= p->numHelpers; i++) {
+        accepted += result->lockersTried[i];
+        sum += (double)i * (double)result->lockersTried[i];
+    }
+    if (accepted) {
+        result->meanLockersTried = sum / (double)accepted;
+        result->p50LockersTried = percentile(result->lockersTried, p->numHelpers + 1, accepted, 0.50);
+        result->p90LockersTried = percentile(result->lockersTried, p->numHelpers + 1, accepted, 0.90);
+        result->p99LockersTried = percentile(result->lockersTried, p->numHelpers + 1, accepted, 0.99);
+    }
+    return 0;
+}
@@ -0,0 +1,216 @@
+//########################################################################
+// (C) Embedded Systems Lab
+// All rights reserved.
+// ------------------------------------------------------------
+// This document contains proprietary information belonging to
+// Research & Development FH OÖ Forschungs und Entwicklungs GmbH.
+// Using, passing on and copying of this document or parts of it
+// is generally not permitted without prior written authorization.
+// ------------------------------------------------------------
+// info(at)embedded-lab.at
+// https://www.embedded-lab.at/
+//########################################################################
+// *** File name: FESimulate.h
+// *** Date of file creation: 2022-02-07
+// *** List of autors: Lucas Drack
+// ***
+// *** Monte Carlo simulation of false rejection and acceptance rates.
+//########################################################################
+
+#ifndef __FE_SIMULATE_H__
+#define __FE_SIMULATE_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "CFuzzyExtractor.h"
+#include "FEOptimizer.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//  A trial enrolls a random value, then reproduces from readingsPerTrial
+//  noisy readings of it (genuine) and from impostorsPerTrial random values
+//  (other devices). Trials are spread over all cores. The noise of trial t
+//  is drawn from a generator seeded with (seed, t), so results do not
+//  depend on the number of threads.
+//
+//  For statistics-only runs, the lockers need not be hashed at all: with
+//  FE_SIM_COMPARE a locker opens iff the reading equals the enrolled value
+//  under its mask (or sampled bits), which is exactly when the real locker
+//  opens, barring the 2^-(8 * secLen) chance of a locker opening by
+//  accident. FE_SIM_BLAKE2B keeps the whole generate/reproduce path but
+//  replaces the locker hash with BLAKE2b.
+
+
+/*
+ * Struct: FESimRandom
+ * --------------------
+ *  xoshiro256** generator of the simulation, also handed to custom noise
+ *  models. Not for cryptographic use.
+ */
+typedef struct {
+    uint64_t s[4];
+} FESimRandom;
+
+void feSimSeed(FESimRandom *const rng, uint64_t const seed);
+
+uint64_t feSimNext(FESimRandom *const rng);
+
+//  returns: a uniform double in [0, 1)
+double feSimUniform(FESimRandom *const rng);
+
+
+/*
+ * Enum: FENoiseKind
+ * --------------------
+ *  FE_NOISE_HAMMING: exactly hamming distinct bits flip, chosen uniformly
+ *  FE_NOISE_IID:     every bit flips independently with flipRate
+ *  FE_NOISE_PROFILE: bit b flips with profile->bitErrorRates[b], e.g. a
+ *                    profile estimated from CSV readings (FEOptimizer.h)
+ *  FE_NOISE_DRIFT:   temperature drift: per device, every bit is
+ *                    temperature sensitive with probability
+ *                    driftPerKelvin * |deltaKelvin| and then flipped in
+ *                    all its readings; on top, IID or (if profile is set)
+ *                    PROFILE noise
+ *  FE_NOISE_CUSTOM:  custom(enrolled, reading, len, rng, userData) writes
+ *                    the reading
+ */
+typedef enum {
+    FE_NOISE_HAMMING = 0,
+    FE_NOISE_IID,
+    FE_NOISE_PROFILE,
+    FE_NOISE_DRIFT,
+    FE_NOISE_CUSTOM
+} FENoiseKind;
+
+typedef void (*FENoiseFn)(const unsigned char enrolled[], unsigned char reading[], size_t const len,
+        FESimRandom *const rng, void* userData);
+
+/*
+ * Struct: FENoiseModel
+ * --------------------
+ *  Parameters of the noise kinds above; fields another kind does not use
+ *  are ignored. custom must be thread-safe.
+ */
+typedef struct {
+    FENoiseKind kind;
+    size_t hamming;
+    double flipRate;
+    const FEErrorProfile* profile;
+    double driftPerKelvin;
+    double deltaKelvin;
+    FENoiseFn custom;
+    void* userData;
+} FENoiseModel;
+
+void initFENoiseModel(FENoiseModel *const noise, FENoiseKind const kind);
+
+
+/*
+ * Enum: FESimulateHash
+ * --------------------
+ *  FE_SIM_LOCKER:  feGenerate()/feReproduce() with p->locker
+ *  FE_SIM_BLAKE2B: feGenerate()/feReproduce() with BLAKE2b lockers
+ *  FE_SIM_COMPARE: no hashing, lockers compared directly (see above)
+ */
+typedef enum {
+    FE_SIM_LOCKER = 0,
+    FE_SIM_BLAKE2B,
+    FE_SIM_COMPARE
+} FESimulateHash;
+
+/*
+ * Struct: FESimulateOptions
+ * --------------------
+ *  trials:            Enrollments (default: 1000)
+ *  readingsPerTrial:  Genuine readings per enrollment (default: 10)
+ *  impostorsPerTrial: Other devices' readings per enrollment (default: 10)
+ *  numThreads:        Workers (default 0: one per online CPU)
+ *  hash:              How lockers are evaluated (default: FE_SIM_LOCKER)
+ *  confidence:        Level of the confidence intervals (default: 0.95)
+ *  seed:              Seed of the noise, 0 for a random one
+ */
+typedef struct {
+    uint64_t trials;
+    size_t readingsPerTrial;
+    size_t impostorsPerTrial;
+    size_t numThreads;
+    FESimulateHash hash;
+    double confidence;
+    uint64_t seed;
+} FESimulateOptions;
+
+void initFESimulateOptions(FESimulateOptions *const options);
+
+/*
+ * Struct: FESimulation
+ * --------------------
+ *  genuine, falseRejects: genuine reproductions, and those that did not
+ *                  yield the enrolled key
+ *  frr, frrLow, frrHigh: false rejection rate and its Wilson score
+ *                  confidence interval
+ *  impostor, falseAccepts: impostor reproductions, and those that yielded
+ *                  the enrolled key
+ *  far, farLow, farHigh: false acceptance rate and its interval
+ *  falseOpens:     reproductions in which a locker opened by accident and
+ *                  yielded a wrong key (never with FE_SIM_COMPARE)
+ *  numHelpers:     lockers per enrollment
+ *  lockersTried:   histogram of the lockers tried by accepted genuine
+ *                  reproductions, numHelpers + 1 buckets
+ *  meanLockersTried, p50/p90/p99LockersTried: its mean and percentiles
+ *  seconds:        wall time of the simulation
+ */
+typedef struct {
+    uint64_t genuine;
+    uint64_t falseRejects;
+    double frr;
+    double frrLow;
+    double frrHigh;
+
+    uint64_t impostor;
+    uint64_t falseAccepts;
+    double far;
+    double farLow;
+    double farHigh;
+
+    uint64_t falseOpens;
+
+    size_t numHelpers;
+    uint64_t* lockersTried;
+    double meanLockersTried;
+    size_t p50LockersTried;
+    size_t p90LockersTried;
+    size_t p99LockersTried;
+
+    double seconds;
+} FESimulation;
+
+void initFESimulation(FESimulation *const result);
+
+void freeFESimulation(FESimulation *const result);
+
+void printFESimulation(const FESimulation *const result);
+
+/*
+ * Function: feSimulate
+ * --------------------
+ *   Runs options->trials trials of the fuzzy extractor p under noise.
+ *
+ *   p:       the properties to simulate
+ *   noise:   the noise of genuine readings
+ *   options: null for the defaults
+ *   result:  receives the rates. The caller MUST call freeFESimulation().
+ *
+ *   returns: 0 on success, negative int otherwise
+ */
+int feSimulate(const FEProperties *const p, const FENoiseModel *const noise,
+        const FESimulateOptions *const options, FESimulation *const result);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __FE_SIMULATE_H__
@@ -0,0 +1,233 @@
+//########################################################################
+// (C) Embedded Systems Lab
+// All rights reserved.
+// ------------------------------------------------------------
+// This document contains proprietary information belonging to
+// Research & Development FH OÖ Forschungs und Entwicklungs GmbH.
+// Using, passing on and copying of this document or parts of it
+// is generally not permitted without prior written authorization.
+// ------------------------------------------------------------
+// info(at)embedded-lab.at
+// https://www.embedded-lab.at/
+//########################################################################
+// *** File name: FEStats.c
+// *** Date of file creation: 2022-02-07
+// *** List of autors: Lucas Drack
+// ***
+// *** Reproduce statistics and process-wide latency histograms.
+//########################################################################
+
+#include "FEStats.h"
+
+#include <stdio.h>
+#include <string.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+#ifdef FE_ENABLE_STATS
+#include <stdatomic.h>
+#endif
+
+void initFEStats(FEStats *const stats) {
+    if(!stats) return;
+    stats->lockersTried = 0;
+    stats->openedIndex = -1;
+    stats->hashNs = 0;
+    stats->maskNs = 0;
+}
+
+void printFEStats(const FEStats *const stats) {
+    if(!stats) return;
+
+    printf("\n*** Reproduce statistics ***\n");
+    printf("Lockers tried: %llu\n", (unsigned long long)stats->lockersTried);
+    printf("Opened locker: %lld\n", (long long)stats->openedIndex);
+    printf("Hash time: %llu ns\n", (unsigned long long)stats->hashNs);
+    printf("Mask time: %llu ns\n", (unsigned long long)stats->maskNs);
+}
+
+uint64_t feStatsNow(void) {
+#ifdef _WIN32
+    LARGE_INTEGER freq, count;
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&count);
+    return (uint64_t)((double)count.QuadPart * 1e9 / (double)freq.QuadPart);
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+const char* feHistogramName(FEHistogram const hist) {
+    switch (hist) {
+        case FE_HIST_GENERATE:  return "generate";
+        case FE_HIST_REPRODUCE: return "reproduce";
+        case FE_HIST_LOCKER:    return "locker";
+        default:                return "unknown";
+    }
+}
+
+bool feStatsEnabled(void) {
+#ifdef FE_ENABLE_STATS
+    return true;
+#else
+    return false;
+#endif
+}
+
+
+/**********************************************************/
+
+
+#ifdef FE_ENABLE_STATS
+
+//  Log-linear buckets as in HdrHistogram: values below 16 have a bucket
+//  each, above that every power of two is split into 16 sub-buckets. This
+//  keeps the relative error below 1/16 over the full 64 bit range with
+//  976 counters per histogram.
+#define FE_HIST_SUB_BITS 4
+#define FE_HIST_SUB      (1u << FE_HIST_SUB_BITS)
+#define FE_HIST_BUCKETS  ((64 - FE_HIST_SUB_BITS + 1) * FE_HIST_SUB)
+
+typedef struct {
+    atomic_uint_fast64_t buckets[FE_HIST_BUCKETS];
+    atomic_uint_fast64_t count;
+    atomic_uint_fast64_t sum;
+    atomic_uint_fast64_t min;
+    atomic_uint_fast64_t max;
+} LatencyHistogram;
+
+static LatencyHistogram histograms[FE_HIST_COUNT];
+
+static unsigned highestBit(uint64_t v) {
+#if defined(__GNUC__)
+    return 63u - (unsigned)__builtin_clzll(v);
+#else
+    unsigned e = 0;
+    while (v >>= 1) e++;
+    return e;
+#endif
+}
+
+static size_t bucketOf(uint64_t const v) {
+    if (v < FE_HIST_SUB) return (size_t)v;
+    unsigned e = highestBit(v);
+    return (size_t)(e - FE_HIST_SUB_BITS + 1) * FE_HIST_SUB +
+           (size_t)((v >> (e - FE_HIST_SUB_BITS)) & (FE_HIST_SUB - 1));
+}
+
+//  Highest value that falls into bucket b.
+static uint64_t bucketMax(size_t const b) {
+    if (b < FE_HIST_SUB) return (uint64_t)b;
+    unsigned shift = (unsigned)(b / FE_HIST_SUB) - 1;
+    uint64_t lower = (uint64_t)(FE_HIST_SUB + b % FE_HIST_SUB) << shift;
+    return lower + (((uint64_t)1 << shift) - 1);
+}
+
+void feStatsRecord(FEHistogram const hist, uint64_t const ns) {
+    if ((unsigned)hist >= FE_HIST_COUNT) return;
+    LatencyHistogram *const hg = &histograms[hist];
+
+    atomic_fetch_add_explicit(&hg->buckets[bucketOf(ns)], 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&hg->sum, ns, memory_order_relaxed);
+
+    //  min is stored as ~min, so the zeroed initial state needs no setup.
+    uint_fast64_t inv = atomic_load_explicit(&hg->min, memory_order_relaxed);
+    while (~inv > ns && !atomic_compare_exchange_weak_explicit(&hg->min, &inv, ~(uint_fast64_t)ns,
+            memory_order_relaxed, memory_order_relaxed)) {}
+    uint_fast64_t max = atomic_load_explicit(&hg->max, memory_order_relaxed);
+    while (max < ns && !atomic_compare_exchange_weak_explicit(&hg->max, &max, ns,
+            memory_order_relaxed, memory_order_relaxed)) {}
+
+    atomic_fetch_add_explicit(&hg->count, 1, memory_order_release);
+}
+
+uint64_t feStatsPercentile(FEHistogram const hist, double const pct) {
+    if ((unsigned)hist >= FE_HIST_COUNT) return 0;
+    LatencyHistogram *const hg = &histograms[hist];
+
+    uint64_t count = atomic_load_explicit(&hg->count, memory_order_acquire);
+    if (count == 0) return 0;
+    uint64_t rank = (uint64_t)((pct / 100.0) * (double)count + 0.5);
+    if (rank < 1) rank = 1;
+    if (rank > count) rank = count;
+
+    uint64_t max = atomic_load_explicit(&hg->max, memory_order_relaxed);
+    uint64_t seen = 0;
+    for (size_t b = 0; b < FE_HIST_BUCKETS; b++) {
+        seen += atomic_load_explicit(&hg->buckets[b], memory_order_relaxed);
+        if (seen >= rank) {
+            uint64_t v = bucketMax(b);
+            return (v < max) ? v : max;
+        }
+    }
+    return max;
+}
+
+void feStatsSummary(FEHistogram const hist, FEHistogramSummary *const summary) {
+    if (!summary) return;
+    memset(summary, 0, sizeof(*summary));
+    if ((unsigned)hist >= FE_HIST_COUNT) return;
+    LatencyHistogram *const hg = &histograms[hist];
+
+    summary->count = atomic_load_explicit(&hg->count, memory_order_acquire);
+    if (summary->count == 0) return;
+    summary->minNs  = ~(uint64_t)atomic_load_explicit(&hg->min, memory_order_relaxed);
+    summary->maxNs  = atomic_load_explicit(&hg->max, memory_order_relaxed);
+    summary->meanNs = (double)atomic_load_explicit(&hg->sum, memory_order_relaxed) / (double)summary->count;
+    summary->p50Ns  = feStatsPercentile(hist, 50.0);
+    summary->p90Ns  = feStatsPercentile(hist, 90.0);
+    summary->p99Ns  = feStatsPercentile(hist, 99.0);
+    summary->p999Ns = feStatsPercentile(hist, 99.9);
+}
+
+void feStatsReset(void) {
+    for (size_t h = 0; h < FE_HIST_COUNT; h++) {
+        LatencyHistogram *const hg = &histograms[h];
+        atomic_store_explicit(&hg->count, 0, memory_order_relaxed);
+        for (size_t b = 0; b < FE_HIST_BUCKETS; b++) {
+            atomic_store_explicit(&hg->buckets[b], 0, memory_order_relaxed);
+        }
+        atomic_store_explicit(&hg->sum, 0, memory_order_relaxed);
+        atomic_store_explicit(&hg->min, 0, memory_order_relaxed);
+        atomic_store_explicit(&hg->max, 0, memory_order_relaxed);
+    }
+}
+
+#else
+
+void feStatsRecord(FEHistogram const hist, uint64_t const ns) {
+    (void)hist;
+    (void)ns;
+}
+
+uint64_t feStatsPercentile(FEHistogram const hist, double const pct) {
+    (void)hist;
+    (void)pct;
+    return 0;
+}
+
+void feStatsSummary(FEHistogram const hist, FEHistogramSummary *const summary) {
+    (void)hist;
+    if (summary) memset(summary, 0, sizeof(*summary));
+}
+
+void feStatsReset(void) {
+}
+
+#endif // FE_ENABLE_STATS
+
+void printFEHistograms(void) {
+    printf("\n*** Latency histograms%s ***\n", feStatsEnabled() ? "" : " (disabled)");
+    for (size_t h = 0; h < FE_HIST_COUNT; h++) {
+        FEHistogramSummary s;
+        feStatsSummary((FEHistogram)h, &s);
+        printf("%-10s count %llu  min %llu  p50 %llu  p99 %llu  max %llu ns\n",
+                feHistogramName((FEHistogram)h), (unsigned long long)s.count,
+                (unsigned long long)s.minNs, (unsigned long long)s.p50Ns,
+                (unsigned long long)s.p99Ns, (unsigned long long)s.maxNs);
+    }
+}
@@ -0,0 +1,154 @@
+//########################################################################
+// (C) Embedded Systems Lab
+// All rights reserved.
+// ------------------------------------------------------------
+// This document contains proprietary information belonging to
+// Research & Development FH OÖ Forschungs und Entwicklungs GmbH.
+// Using, passing on and copying of this document or parts of it
+// is generally not permitted without prior written authorization.
+// ------------------------------------------------------------
+// info(at)embedded-lab.at
+// https://www.embedded-lab.at/
+//########################################################################
+// *** File name: FEStats.h
+// *** Date of file creation: 2022-02-07
+// *** List of autors: Lucas Drack
+// ***
+// *** Reproduce statistics and process-wide latency histograms.
+//########################################################################
+
+#ifndef __FE_STATS_H__
+#define __FE_STATS_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//  Timing and histograms are only compiled in if FE_ENABLE_STATS is defined
+//  (CMake option FE_ENABLE_STATS). Otherwise the instrumentation macros
+//  below expand to nothing, the hot path is unchanged, and the query
+//  functions report empty histograms.
+
+
+/*
+ * Struct: FEStats
+ * --------------------
+ *  Work done by a single reproduction, see feReproduceStats().
+ *
+ *  lockersTried: Number of lockers hashed
+ *  openedIndex:  Index of the locker that opened, -1 if none did
+ *  hashNs:       Time spent hashing lockers (FE_ENABLE_STATS only)
+ *  maskNs:       Time spent masking or sampling the value (FE_ENABLE_STATS only)
+ */
+typedef struct {
+    uint64_t lockersTried;
+    int64_t openedIndex;
+    uint64_t hashNs;
+    uint64_t maskNs;
+} FEStats;
+
+void initFEStats(FEStats *const stats);
+
+void printFEStats(const FEStats *const stats);
+
+
+/*
+ * Enum: FEHistogram
+ * --------------------
+ *  Process-wide latency histograms.
+ *
+ *  FE_HIST_GENERATE:  whole enrollments (feGenerate*)
+ *  FE_HIST_REPRODUCE: whole reproductions (feReproduce*, except batches)
+ *  FE_HIST_LOCKER:    single locker hashes
+ */
+typedef enum {
+    FE_HIST_GENERATE = 0,
+    FE_HIST_REPRODUCE,
+    FE_HIST_LOCKER,
+    FE_HIST_COUNT
+} FEHistogram;
+
+/*
+ * Struct: FEHistogramSummary
+ * --------------------
+ *  count:  Number of recorded values
+ *  minNs, maxNs, meanNs: exact minimum, maximum and mean in nanoseconds
+ *  p50Ns .. p999Ns: percentiles, accurate to 1/16 of the value (HDR-style
+ *          log-linear buckets)
+ */
+typedef struct {
+    uint64_t count;
+    uint64_t minNs;
+    uint64_t maxNs;
+    double meanNs;
+    uint64_t p50Ns;
+    uint64_t p90Ns;
+    uint64_t p99Ns;
+    uint64_t p999Ns;
+} FEHistogramSummary;
+
+/*
+ * Function: feStatsEnabled
+ * --------------------
+ *   returns: true if the library was built with FE_ENABLE_STATS
+ */
+bool feStatsEnabled(void);
+
+/*
+ * Function: feStatsRecord
+ * --------------------
+ *   Adds one latency to histogram hist. Safe to call from several threads.
+ */
+void feStatsRecord(FEHistogram const hist, uint64_t const ns);
+
+/*
+ * Function: feStatsPercentile
+ * --------------------
+ *   returns: the latency in nanoseconds that pct percent of the values of
+ *            hist do not exceed, 0 if hist is empty
+ */
+uint64_t feStatsPercentile(FEHistogram const hist, double const pct);
+
+void feStatsSummary(FEHistogram const hist, FEHistogramSummary *const summary);
+
+/*
+ * Function: feStatsReset
+ * --------------------
+ *   Clears all histograms. Values recorded concurrently may be lost.
+ */
+void feStatsReset(void);
+
+const char* feHistogramName(FEHistogram const hist);
+
+void printFEHistograms(void);
+
+/*
+ * Function: feStatsNow
+ * --------------------
+ *   returns: a monotonic timestamp in nanoseconds
+ */
+uint64_t feStatsNow(void);
+
+
+//  Instrumentation used inside the library. FE_STATS_TIMER declares a
+//  timestamp, FE_STATS_SINCE may only appear within the other macros.
+#ifdef FE_ENABLE_STATS
+#define FE_STATS_TIMER(t)               uint64_t t = feStatsNow()
+#define FE_STATS_SINCE(t)               (feStatsNow() - (t))
+#define FE_STATS_ADD(stats, field, n)   do { if (stats) (stats)->field += (n); } while (0)
+#define FE_STATS_RECORD(hist, ns)       feStatsRecord((hist), (ns))
+#else
+#define FE_STATS_TIMER(t)               ((void)0)
+#define FE_STATS_SINCE(t)               0
+#define FE_STATS_ADD(stats, field, n)   ((void)0)
+#define FE_STATS_RECORD(hist, ns)       ((void)0)
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __FE_STATS_H__
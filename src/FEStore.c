@@ -0,0 +1,839 @@
+//########################################################################
+// (C) Embedded Systems Lab
+// All rights reserved.
+// ------------------------------------------------------------
+// This document contains proprietary information belonging to
+// Research & Development FH OÖ Forschungs und Entwicklungs GmbH.
+// Using, passing on and copying of this document or parts of it
+// is generally not permitted without prior written authorization.
+// ------------------------------------------------------------
+// info(at)embedded-lab.at
+// https://www.embedded-lab.at/
+//########################################################################
+// *** File name: FEStore.c
+// *** Date of file creation: 2022-02-07
+// *** List of autors: Lucas Drack
+// ***
+// *** Enrollment store: helper data of many devices keyed by device ID.
+//########################################################################
+
+#include "FEStore.h"
+#include "HelperDataFile.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef _WIN32
+
+#include <stdatomic.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Internal data type for brevity.
+typedef unsigned char byte;
+
+#define STORE_MIN_CAPACITY 1024
+
+typedef struct {
+    char     magic[4];
+    uint16_t version;
+    uint16_t headerSize;
+    uint32_t byteOrder;
+    uint32_t reserved0;
+    uint64_t storeId;           // random, shared with the index of the same generation
+    uint8_t  reserved[40];
+} StoreFileHeader;
+
+//  Counters are only written by the writer; readers load them relaxed.
+typedef struct {
+    char     magic[4];
+    uint16_t version;
+    uint16_t headerSize;
+    uint32_t byteOrder;
+    uint32_t reserved0;
+    uint64_t storeId;
+    uint64_t capacity;          // slots, a power of two
+    _Atomic(uint64_t) used;     // slots with a key
+    _Atomic(uint64_t) live;     // slots with a record
+    _Atomic(uint64_t) liveBytes;
+    _Atomic(uint64_t) dataSize; // data file bytes reflected in the index
+} StoreIndexHeader;
+
+//  key is deviceId + 1, 0 for an empty slot. offset is 0 once deleted.
+typedef struct {
+    _Atomic(uint64_t) key;
+    _Atomic(uint64_t) offset;
+} StoreSlot;
+
+typedef struct {
+    char     magic[4];
+    uint32_t flags;
+    uint64_t deviceId;
+    uint64_t size;              // bytes of serialized helper data that follow
+    uint8_t  reserved[40];
+} StoreRecordHeader;
+
+_Static_assert(sizeof(StoreFileHeader) == FE_STORE_HEADER_SIZE, "StoreFileHeader must be 64 bytes");
+_Static_assert(sizeof(StoreIndexHeader) == FE_STORE_HEADER_SIZE, "StoreIndexHeader must be 64 bytes");
+_Static_assert(sizeof(StoreRecordHeader) == FE_STORE_HEADER_SIZE, "StoreRecordHeader must be 64 bytes");
+_Static_assert(sizeof(StoreSlot) == 16, "StoreSlot must be 16 bytes");
+
+typedef struct StoreMap {
+    byte* addr;
+    size_t size;
+    struct StoreMap* next;
+} StoreMap;
+
+//  Data and index mappings that belong together. Readers load the current
+//  view once per call; superseded views and mappings live until
+//  feStoreRelease() or close.
+typedef struct StoreView {
+    StoreMap* data;
+    StoreMap* index;
+    struct StoreView* next;
+} StoreView;
+
+struct FEStore {
+    char* path;
+    char* indexPath;
+    bool writable;
+    int dataFd;
+    int indexFd;
+    _Atomic(StoreView*) view;
+
+    //  Writer state, guarded by writeLock.
+    pthread_mutex_t writeLock;
+    StoreMap* maps;
+    StoreView* views;
+    uint64_t dataEnd;
+};
+
+static size_t recordSize(uint64_t const payload) {
+    return FE_STORE_HEADER_SIZE + (size_t)((payload + 63) & ~(uint64_t)63);
+}
+
+static uint64_t mixId(uint64_t x) {
+    x ^= x >> 30; x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27; x *= 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+static StoreIndexHeader* indexHeader(const StoreMap *const m) {
+    return (StoreIndexHeader*)m->addr;
+}
+
+static StoreSlot* indexSlots(const StoreMap *const m) {
+    return (StoreSlot*)(m->addr + FE_STORE_HEADER_SIZE);
+}
+
+static size_t indexFileSize(uint64_t const capacity) {
+    return FE_STORE_HEADER_SIZE + (size_t)capacity * sizeof(StoreSlot);
+}
+
+//  Mapping size of the data file. Records are appended behind the end of
+//  the file, so the data file is mapped with plenty of room; the address
+//  space is only reserved, and pages beyond the end of the file are never
+//  touched.
+static size_t dataReserve(size_t const needed) {
+    size_t reserve = (SIZE_MAX > 0xffffffffu) ? ((size_t)1 << 36) : ((size_t)1 << 28);
+    while (reserve < needed) reserve *= 2;
+    return reserve;
+}
+
+
+/**********************************************************/
+
+
+static StoreMap* mapFile(FEStore *const s, int const fd, size_t const size, bool const writable) {
+    void* addr = mmap(NULL, size, PROT_READ | (writable ? PROT_WRITE : 0), MAP_SHARED, fd, 0);
+    if (addr == MAP_FAILED) return NULL;
+    StoreMap* m = (StoreMap*)malloc(sizeof(StoreMap));
+    if (!m) {
+        munmap(addr, size);
+        return NULL;
+    }
+    m->addr = (byte*)addr;
+    m->size = size;
+    m->next = s->maps;
+    s->maps = m;
+    return m;
+}
+
+static int publishView(FEStore *const s, StoreMap *const data, StoreMap *const index) {
+    StoreView* v = (StoreView*)malloc(sizeof(StoreView));
+    if (!v) return -3;
+    v->data = data;
+    v->index = index;
+    v->next = s->views;
+    s->views = v;
+    atomic_store_explicit(&s->view, v, memory_order_release);
+    return 0;
+}
+
+static int writeAll(int const fd, const void* buf, size_t const size, uint64_t offset) {
+    const byte* p = (const byte*)buf;
+    size_t done = 0;
+    while (done < size) {
+        ssize_t n = pwrite(fd, p + done, size - done, (off_t)(offset + done));
+        if (n <= 0) return -3;
+        done += (size_t)n;
+    }
+    return 0;
+}
+
+static char* concat(const char* a, const char* b) {
+    size_t la = strlen(a);
+    size_t lb = strlen(b);
+    char* s = (char*)malloc(la + lb + 1);
+    if (!s) return NULL;
+    memcpy(s, a, la);
+    memcpy(s + la, b, lb + 1);
+    return s;
+}
+
+static void initFileHeader(StoreFileHeader *const header, char const* magic, uint64_t const storeId) {
+    memset(header, 0, sizeof(StoreFileHeader));
+    memcpy(header->magic, magic, 4);
+    header->version    = FE_STORE_VERSION;
+    header->headerSize = FE_STORE_HEADER_SIZE;
+    header->byteOrder  = HD_FILE_BYTE_ORDER;
+    header->storeId    = storeId;
+}
+
+static bool fileHeaderValid(const StoreFileHeader *const header, char const* magic) {
+    return memcmp(header->magic, magic, 4) == 0 && header->version == FE_STORE_VERSION &&
+            header->headerSize == FE_STORE_HEADER_SIZE && header->byteOrder == HD_FILE_BYTE_ORDER;
+}
+
+
+/**********************************************************/
+
+
+//  returns: the slot of deviceId, NULL if it never was in the index
+static StoreSlot* findSlot(const StoreMap *const index, uint64_t const deviceId) {
+    uint64_t const capacity = indexHeader(index)->capacity;
+    uint64_t const key = deviceId + 1;
+    StoreSlot* slots = indexSlots(index);
+    for (uint64_t i = mixId(deviceId) & (capacity - 1), n = 0; n < capacity; i = (i + 1) & (capacity - 1), n++) {
+        uint64_t k = atomic_load_explicit(&slots[i].key, memory_order_acquire);
+        if (k == key) return &slots[i];
+        if (k == 0) return NULL;
+    }
+    return NULL;
+}
+
+//  Points deviceId at offset (0 to delete it). The offset is stored before
+//  the key is published, so a reader that finds the key finds its record.
+//  returns: the previous offset, 0 if there was none
+static uint64_t setSlot(StoreMap *const index, uint64_t const deviceId, uint64_t const offset) {
+    uint64_t const capacity = indexHeader(index)->capacity;
+    uint64_t const key = deviceId + 1;
+    StoreSlot* slots = indexSlots(index);
+    for (uint64_t i = mixId(deviceId) & (capacity - 1); ; i = (i + 1) & (capacity - 1)) {
+        uint64_t k = atomic_load_explicit(&slots[i].key, memory_order_relaxed);
+        if (k == key) {
+            return atomic_exchange_explicit(&slots[i].offset, offset, memory_order_acq_rel);
+        }
+        if (k == 0) {
+            if (offset == 0) return 0;
+            atomic_store_explicit(&slots[i].offset, offset, memory_order_relaxed);
+            atomic_store_explicit(&slots[i].key, key, memory_order_release);
+            atomic_fetch_add_explicit(&indexHeader(index)->used, 1, memory_order_relaxed);
+            return 0;
+        }
+    }
+}
+
+//  Applies a record at offset of the current view to the index.
+static void applyRecord(const StoreView *const v, const StoreRecordHeader *const rec, uint64_t const offset) {
+    StoreIndexHeader* header = indexHeader(v->index);
+    bool const deleted = (rec->flags & FE_STORE_RECORD_DELETED) != 0;
+    uint64_t old = setSlot(v->index, rec->deviceId, deleted ? 0 : offset);
+    if (old != 0) {
+        const StoreRecordHeader* prev = (const StoreRecordHeader*)(v->data->addr + old);
+        atomic_fetch_sub_explicit(&header->live, 1, memory_order_relaxed);
+        atomic_fetch_sub_explicit(&header->liveBytes, recordSize(prev->size), memory_order_relaxed);
+    }
+    if (!deleted) {
+        atomic_fetch_add_explicit(&header->live, 1, memory_order_relaxed);
+        atomic_fetch_add_explicit(&header->liveBytes, recordSize(rec->size), memory_order_relaxed);
+    }
+}
+
+//  Creates an empty index file at path and maps it.
+static StoreMap* createIndex(FEStore *const s, const char* path, uint64_t const storeId,
+        uint64_t const capacity, int* fd) {
+    *fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (*fd < 0) return NULL;
+    StoreMap* m = NULL;
+    if (ftruncate(*fd, (off_t)indexFileSize(capacity)) == 0) {
+        m = mapFile(s, *fd, indexFileSize(capacity), true);
+    }
+    if (!m) {
+        close(*fd);
+        *fd = -1;
+        unlink(path);
+        return NULL;
+    }
+    StoreIndexHeader* header = indexHeader(m);
+    initFileHeader((StoreFileHeader*)header, FE_STORE_INDEX_MAGIC, storeId);
+    header->capacity = capacity;
+    atomic_store_explicit(&header->dataSize, FE_STORE_HEADER_SIZE, memory_order_relaxed);
+    return m;
+}
+
+//  Copies the live slots of from into a new index of capacity slots at
+//  path. to receives the mapping, fd its descriptor.
+static int copyIndex(FEStore *const s, const StoreMap *const from, const char* path, uint64_t const storeId,
+        uint64_t const capacity, StoreMap** to, int* fd) {
+    *to = createIndex(s, path, storeId, capacity, fd);
+    if (!*to) return -3;
+    StoreIndexHeader* src = indexHeader(from);
+    StoreIndexHeader* dst = indexHeader(*to);
+    StoreSlot* slots = indexSlots(from);
+    for (uint64_t i = 0; i < src->capacity; i++) {
+        uint64_t key = atomic_load_explicit(&slots[i].key, memory_order_relaxed);
+        uint64_t offset = atomic_load_explicit(&slots[i].offset, memory_order_relaxed);
+        if (key != 0 && offset != 0) setSlot(*to, key - 1, offset);
+    }
+    atomic_store_explicit(&dst->live, atomic_load(&src->live), memory_order_relaxed);
+    atomic_store_explicit(&dst->liveBytes, atomic_load(&src->liveBytes), memory_order_relaxed);
+    atomic_store_explicit(&dst->dataSize, atomic_load(&src->dataSize), memory_order_relaxed);
+    return 0;
+}
+
+//  Keeps the load factor of the index at most 1/2, doubling it if needed.
+static int reserveSlot(FEStore *const s) {
+    StoreView* v = atomic_load_explicit(&s->view, memory_order_relaxed);
+    StoreIndexHeader* header = indexHeader(v->index);
+    if ((atomic_load(&header->used) + 1) * 2 <= header->capacity) return 0;
+
+    char* tmp = concat(s->indexPath, ".tmp");
+    if (!tmp) return -3;
+    StoreMap* grown;
+    int fd;
+    int ret = copyIndex(s, v->index, tmp, header->storeId, header->capacity * 2, &grown, &fd);
+    if (ret == 0 && rename(tmp, s->indexPath) != 0) {
+        close(fd);
+        unlink(tmp);
+        ret = -3;
+    }
+    free(tmp);
+    if (ret != 0) return ret;
+
+    close(s->indexFd);
+    s->indexFd = fd;
+    return publishView(s, v->data, grown);
+}
+
+//  Makes the data mapping of the current view cover size bytes.
+static int reserveData(FEStore *const s, size_t const size) {
+    StoreView* v = atomic_load_explicit(&s->view, memory_order_relaxed);
+    if (v->data->size >= size) return 0;
+    StoreMap* m = mapFile(s, s->dataFd, dataReserve(size), false);
+    if (!m) return -3;
+    return publishView(s, m, v->index);
+}
+
+//  Replays the records of the data file from the index's dataSize on. A
+//  torn record at the end (from a crash during an append) is cut off.
+static int replay(FEStore *const s, uint64_t const fileSize) {
+    StoreView* v = atomic_load_explicit(&s->view, memory_order_relaxed);
+    uint64_t offset = atomic_load(&indexHeader(v->index)->dataSize);
+
+    while (offset + FE_STORE_HEADER_SIZE <= fileSize) {
+        StoreRecordHeader rec;
+        memcpy(&rec, v->data->addr + offset, sizeof(rec));
+        bool const deleted = (rec.flags & FE_STORE_RECORD_DELETED) != 0;
+        if (memcmp(rec.magic, FE_STORE_RECORD_MAGIC, 4) != 0 || rec.deviceId == UINT64_MAX ||
+                (deleted ? rec.size != 0 : rec.size < HD_FILE_HEADER_SIZE) ||
+                rec.size > fileSize || offset + recordSize(rec.size) > fileSize) {
+            break;
+        }
+        int ret = reserveSlot(s);
+        if (ret != 0) return ret;
+        v = atomic_load_explicit(&s->view, memory_order_relaxed);
+        applyRecord(v, &rec, offset);
+        offset += recordSize(rec.size);
+    }
+
+    if (offset < fileSize && ftruncate(s->dataFd, (off_t)offset) != 0) return -3;
+    s->dataEnd = offset;
+    atomic_store_explicit(&indexHeader(v->index)->dataSize, offset, memory_order_release);
+    return 0;
+}
+
+//  Opens and validates the index of the data file identified by storeId.
+//  returns: the mapping, NULL if the index is missing or does not match
+static StoreMap* openIndex(FEStore *const s, uint64_t const storeId, uint64_t const fileSize, int* fd) {
+    *fd = open(s->indexPath, s->writable ? O_RDWR : O_RDONLY);
+    if (*fd < 0) return NULL;
+
+    StoreIndexHeader header;
+    struct stat st;
+    bool valid = fstat(*fd, &st) == 0 &&
+            pread(*fd, &header, sizeof(header), 0) == (ssize_t)sizeof(header) &&
+            fileHeaderValid((const StoreFileHeader*)&header, FE_STORE_INDEX_MAGIC) &&
+            header.storeId == storeId &&
+            header.capacity >= STORE_MIN_CAPACITY && (header.capacity & (header.capacity - 1)) == 0 &&
+            (uint64_t)st.st_size == indexFileSize(header.capacity) &&
+            header.dataSize >= FE_STORE_HEADER_SIZE && header.dataSize <= fileSize;
+    StoreMap* m = valid ? mapFile(s, *fd, indexFileSize(header.capacity), s->writable) : NULL;
+    if (!m) {
+        close(*fd);
+        *fd = -1;
+    }
+    return m;
+}
+
+//  Opens the data file and its index and publishes them as the current view.
+static int openFiles(FEStore *const s) {
+    int const flags = s->writable ? (O_RDWR | O_CREAT) : O_RDONLY;
+    int dataFd = open(s->path, flags, 0644);
+    if (dataFd < 0) {
+        printf("feStoreOpen error: cannot open %s.\n", s->path);
+        return -2;
+    }
+    if (s->writable && flock(dataFd, LOCK_EX | LOCK_NB) != 0) {
+        printf("feStoreOpen error: %s is open for writing elsewhere.\n", s->path);
+        close(dataFd);
+        return -5;
+    }
+
+    struct stat st;
+    StoreFileHeader header;
+    int ret = 0;
+    if (fstat(dataFd, &st) != 0) {
+        ret = -2;
+    }
+    else if (st.st_size == 0 && s->writable) {
+        uint64_t storeId;
+        randombytes_buf(&storeId, sizeof(storeId));
+        initFileHeader(&header, FE_STORE_MAGIC, storeId);
+        ret = writeAll(dataFd, &header, sizeof(header), 0);
+        st.st_size = sizeof(header);
+    }
+    else if (pread(dataFd, &header, sizeof(header), 0) != (ssize_t)sizeof(header) ||
+            !fileHeaderValid(&header, FE_STORE_MAGIC)) {
+        ret = -2;
+    }
+    if (ret != 0) {
+        printf("feStoreOpen error: %s is not an enrollment store.\n", s->path);
+        close(dataFd);
+        return ret;
+    }
+    uint64_t const fileSize = (uint64_t)st.st_size;
+
+    StoreMap* data = mapFile(s, dataFd, dataReserve((size_t)fileSize), false);
+    int indexFd;
+    StoreMap* index = data ? openIndex(s, header.storeId, fileSize, &indexFd) : NULL;
+    if (data && !index && s->writable) {
+        //  Rebuild from scratch by replaying every record.
+        char* tmp = concat(s->indexPath, ".tmp");
+        index = tmp ? createIndex(s, tmp, header.storeId, STORE_MIN_CAPACITY, &indexFd) : NULL;
+        if (index && rename(tmp, s->indexPath) != 0) {
+            close(indexFd);
+            unlink(tmp);
+            index = NULL;
+        }
+        free(tmp);
+    }
+    if (!data || !index) {
+        printf("feStoreOpen error: cannot map %s or its index.%s\n", s->path,
+                s->writable ? "" : " Open it writable once to rebuild the index.");
+        close(dataFd);
+        return -3;
+    }
+
+    if (s->dataFd >= 0) close(s->dataFd);
+    if (s->indexFd >= 0) close(s->indexFd);
+    s->dataFd = dataFd;
+    s->indexFd = indexFd;
+    ret = publishView(s, data, index);
+    if (ret == 0 && s->writable) ret = replay(s, fileSize);
+    return ret;
+}
+
+
+/**********************************************************/
+
+
+int feStoreOpen(FEStore** store, const char* path, bool const writable) {
+    if (!store || !path) {
+        printf("feStoreOpen error: nullptr argument.\n");
+        return -1;
+    }
+    *store = NULL;
+
+    FEStore* s = (FEStore*)calloc(1, sizeof(FEStore));
+    if (!s) {
+        printf("feStoreOpen error: malloc failed.\n");
+        return -3;
+    }
+    s->path = concat(path, "");
+    s->indexPath = concat(path, ".idx");
+    s->writable = writable;
+    s->dataFd = -1;
+    s->indexFd = -1;
+    pthread_mutex_init(&s->writeLock, NULL);
+    if (!s->path || !s->indexPath) {
+        printf("feStoreOpen error: malloc failed.\n");
+        feStoreClose(s);
+        return -3;
+    }
+
+    int ret = openFiles(s);
+    if (ret != 0) {
+        feStoreClose(s);
+        return ret;
+    }
+    *store = s;
+    return 0;
+}
+
+void feStoreClose(FEStore* store) {
+    if (!store) return;
+    if (store->dataFd >= 0) close(store->dataFd);
+    if (store->indexFd >= 0) close(store->indexFd);
+    while (store->views) {
+        StoreView* v = store->views;
+        store->views = v->next;
+        free(v);
+    }
+    while (store->maps) {
+        StoreMap* m = store->maps;
+        store->maps = m->next;
+        munmap(m->addr, m->size);
+        free(m);
+    }
+    pthread_mutex_destroy(&store->writeLock);
+    free(store->path);
+    free(store->indexPath);
+    free(store);
+}
+
+//  Appends a record and indexes it. Called with writeLock held.
+static int appendRecord(FEStore *const s, uint64_t const deviceId, const HelperData *const h) {
+    size_t const payload = h ? helperDataFileSize(h) : 0;
+    size_t const size = recordSize(payload);
+    byte* buf = (byte*)calloc(1, size);
+    if (!buf) return -3;
+
+    StoreRecordHeader* rec = (StoreRecordHeader*)buf;
+    memcpy(rec->magic, FE_STORE_RECORD_MAGIC, 4);
+    rec->flags = h ? 0 : FE_STORE_RECORD_DELETED;
+    rec->deviceId = deviceId;
+    rec->size = payload;
+    int ret = h ? serializeHelperData(h, buf + FE_STORE_HEADER_SIZE, payload) : 0;
+
+    //  The record is in the file and mapped before the index points to it.
+    if (ret == 0) ret = writeAll(s->dataFd, buf, size, s->dataEnd);
+    if (ret == 0) ret = reserveData(s, (size_t)(s->dataEnd + size));
+    if (ret == 0) ret = reserveSlot(s);
+    if (ret == 0) {
+        StoreView* v = atomic_load_explicit(&s->view, memory_order_relaxed);
+        applyRecord(v, rec, s->dataEnd);
+        s->dataEnd += size;
+        atomic_store_explicit(&indexHeader(v->index)->dataSize, s->dataEnd, memory_order_release);
+    }
+    free(buf);
+    return ret;
+}
+
+int feStorePut(FEStore *const store, uint64_t const deviceId, const HelperData *const h) {
+    if (!store || !h || !h->block) {
+        printf("feStorePut error: nullptr argument.\n");
+        return -1;
+    }
+    if (!store->writable || deviceId == UINT64_MAX) {
+        printf("feStorePut error: store is read-only or device ID invalid.\n");
+        return -2;
+    }
+
+    pthread_mutex_lock(&store->writeLock);
+    int ret = appendRecord(store, deviceId, h);
+    pthread_mutex_unlock(&store->writeLock);
+    if (ret != 0) printf("feStorePut error: cannot append to %s.\n", store->path);
+    return ret;
+}
+
+int feStoreDelete(FEStore *const store, uint64_t const deviceId) {
+    if (!store) {
+        printf("feStoreDelete error: nullptr argument.\n");
+        return -1;
+    }
+    if (!store->writable) {
+        printf("feStoreDelete error: store is read-only.\n");
+        return -2;
+    }
+
+    pthread_mutex_lock(&store->writeLock);
+    StoreView* v = atomic_load_explicit(&store->view, memory_order_relaxed);
+    StoreSlot* slot = (deviceId != UINT64_MAX) ? findSlot(v->index, deviceId) : NULL;
+    int ret = FE_STORE_NOT_FOUND;
+    if (slot && atomic_load_explicit(&slot->offset, memory_order_relaxed) != 0) {
+        ret = appendRecord(store, deviceId, NULL);
+        if (ret != 0) printf("feStoreDelete error: cannot append to %s.\n", store->path);
+    }
+    pthread_mutex_unlock(&store->writeLock);
+    return ret;
+}
+
+int feStoreGet(FEStore *const store, uint64_t const deviceId, HelperData *const h, bool const verify) {
+    if (!store || !h) {
+        printf("feStoreGet error: nullptr argument.\n");
+        return -1;
+    }
+    if (deviceId == UINT64_MAX) return FE_STORE_NOT_FOUND;
+
+    StoreView* v = atomic_load_explicit(&store->view, memory_order_acquire);
+    StoreSlot* slot = findSlot(v->index, deviceId);
+    uint64_t offset = slot ? atomic_load_explicit(&slot->offset, memory_order_acquire) : 0;
+    if (offset == 0) return FE_STORE_NOT_FOUND;
+
+    //  A record appended right after this view was loaded may need the
+    //  larger data mapping the writer published before indexing it.
+    if (offset + FE_STORE_HEADER_SIZE > v->data->size) {
+        v = atomic_load_explicit(&store->view, memory_order_acquire);
+    }
+    const byte* base = v->data->addr;
+    StoreRecordHeader rec;
+    if (offset + FE_STORE_HEADER_SIZE > v->data->size) return FE_STORE_STALE;
+    memcpy(&rec, base + offset, sizeof(rec));
+    if (memcmp(rec.magic, FE_STORE_RECORD_MAGIC, 4) != 0 || rec.deviceId != deviceId ||
+            offset + recordSize(rec.size) > v->data->size) {
+        printf("feStoreGet error: damaged record for device %llu.\n", (unsigned long long)deviceId);
+        return -5;
+    }
+    return viewHelperData(h, base + offset + FE_STORE_HEADER_SIZE, (size_t)rec.size, verify);
+}
+
+size_t feStoreCount(FEStore *const store) {
+    if (!store) return 0;
+    StoreView* v = atomic_load_explicit(&store->view, memory_order_acquire);
+    return (size_t)atomic_load_explicit(&indexHeader(v->index)->live, memory_order_relaxed);
+}
+
+size_t feStoreList(FEStore *const store, uint64_t ids[], size_t const maxIds) {
+    if (!store || !ids) return 0;
+    StoreView* v = atomic_load_explicit(&store->view, memory_order_acquire);
+    uint64_t const capacity = indexHeader(v->index)->capacity;
+    StoreSlot* slots = indexSlots(v->index);
+    size_t n = 0;
+    for (uint64_t i = 0; i < capacity && n < maxIds; i++) {
+        uint64_t key = atomic_load_explicit(&slots[i].key, memory_order_acquire);
+        if (key != 0 && atomic_load_explicit(&slots[i].offset, memory_order_relaxed) != 0) {
+            ids[n++] = key - 1;
+        }
+    }
+    return n;
+}
+
+size_t feStoreGarbage(FEStore *const store) {
+    if (!store) return 0;
+    StoreView* v = atomic_load_explicit(&store->view, memory_order_acquire);
+    StoreIndexHeader* header = indexHeader(v->index);
+    uint64_t dataSize = atomic_load_explicit(&header->dataSize, memory_order_relaxed);
+    uint64_t liveBytes = atomic_load_explicit(&header->liveBytes, memory_order_relaxed);
+    return (size_t)(dataSize - FE_STORE_HEADER_SIZE - liveBytes);
+}
+
+int feStoreCompact(FEStore *const store) {
+    if (!store) {
+        printf("feStoreCompact error: nullptr argument.\n");
+        return -1;
+    }
+    if (!store->writable) {
+        printf("feStoreCompact error: store is read-only.\n");
+        return -2;
+    }
+
+    pthread_mutex_lock(&store->writeLock);
+    StoreView* v = atomic_load_explicit(&store->view, memory_order_relaxed);
+    StoreIndexHeader* old = indexHeader(v->index);
+    char* tmpData = concat(store->path, ".tmp");
+    char* tmpIndex = concat(store->indexPath, ".tmp");
+    int fd = -1;
+    int indexFd = -1;
+    StoreMap* index = NULL;
+    int ret = (tmpData && tmpIndex) ? 0 : -3;
+
+    //  A new store ID makes a crash between the two renames detectable:
+    //  the index then no longer matches the data file and is rebuilt.
+    uint64_t storeId;
+    randombytes_buf(&storeId, sizeof(storeId));
+    uint64_t capacity = STORE_MIN_CAPACITY;
+    while ((atomic_load(&old->live) + 1) * 2 > capacity) capacity *= 2;
+
+    if (ret == 0) {
+        fd = open(tmpData, O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0 || flock(fd, LOCK_EX | LOCK_NB) != 0) ret = -3;
+    }
+    if (ret == 0) {
+        index = createIndex(store, tmpIndex, storeId, capacity, &indexFd);
+        if (!index) ret = -3;
+    }
+    uint64_t end = FE_STORE_HEADER_SIZE;
+    if (ret == 0) {
+        StoreFileHeader header;
+        initFileHeader(&header, FE_STORE_MAGIC, storeId);
+        ret = writeAll(fd, &header, sizeof(header), 0);
+    }
+
+    StoreSlot* slots = indexSlots(v->index);
+    for (uint64_t i = 0; ret == 0 && i < old->capacity; i++) {
+        uint64_t key = atomic_load_explicit(&slots[i].key, memory_order_relaxed);
+        uint64_t offset = atomic_load_explicit(&slots[i].offset, memory_order_relaxed);
+        if (key == 0 || offset == 0) continue;
+        const StoreRecordHeader* rec = (const StoreRecordHeader*)(v->data->addr + offset);
+        size_t size = recordSize(rec->size);
+        ret = writeAll(fd, rec, size, end);
+        if (ret == 0) {
+            setSlot(index, key - 1, end);
+            atomic_fetch_add_explicit(&indexHeader(index)->live, 1, memory_order_relaxed);
+            atomic_fetch_add_explicit(&indexHeader(index)->liveBytes, size, memory_order_relaxed);
+            end += size;
+        }
+    }
+
+    StoreMap* data = NULL;
+    if (ret == 0) {
+        atomic_store_explicit(&indexHeader(index)->dataSize, end, memory_order_relaxed);
+        if (fsync(fd) != 0 || msync(index->addr, index->size, MS_SYNC) != 0) ret = -3;
+    }
+    if (ret == 0) {
+        data = mapFile(store, fd, dataReserve((size_t)end), false);
+        if (!data) ret = -3;
+    }
+    if (ret == 0 && (rename(tmpData, store->path) != 0 || rename(tmpIndex, store->indexPath) != 0)) {
+        ret = -3;
+    }
+
+    if (ret == 0) {
+        close(store->dataFd);
+        close(store->indexFd);
+        store->dataFd = fd;
+        store->indexFd = indexFd;
+        store->dataEnd = end;
+        ret = publishView(store, data, index);
+    }
+    else {
+        printf("feStoreCompact error: cannot rewrite %s.\n", store->path);
+        if (fd >= 0) close(fd);
+        if (indexFd >= 0) close(indexFd);
+        if (tmpData) unlink(tmpData);
+        if (tmpIndex) unlink(tmpIndex);
+    }
+    pthread_mutex_unlock(&store->writeLock);
+    free(tmpData);
+    free(tmpIndex);
+    return ret;
+}
+
+int feStoreSync(FEStore *const store) {
+    if (!store) {
+        printf("feStoreSync error: nullptr argument.\n");
+        return -1;
+    }
+    if (!store->writable) return 0;
+
+    pthread_mutex_lock(&store->writeLock);
+    StoreView* v = atomic_load_explicit(&store->view, memory_order_relaxed);
+    int ret = (fsync(store->dataFd) == 0 && msync(v->index->addr, v->index->size, MS_SYNC) == 0) ? 0 : -3;
+    pthread_mutex_unlock(&store->writeLock);
+    if (ret != 0) printf("feStoreSync error: cannot flush %s.\n", store->path);
+    return ret;
+}
+
+int feStoreRefresh(FEStore *const store) {
+    if (!store) {
+        printf("feStoreRefresh error: nullptr argument.\n");
+        return -1;
+    }
+    if (store->writable) return 0;
+    return openFiles(store);
+}
+
+size_t feStoreRelease(FEStore *const store) {
+    if (!store) return 0;
+    pthread_mutex_lock(&store->writeLock);
+    StoreView* current = atomic_load_explicit(&store->view, memory_order_relaxed);
+    while (store->views) {
+        StoreView* v = store->views;
+        store->views = v->next;
+        if (v != current) free(v);
+    }
+    if (current) {
+        current->next = NULL;
+        store->views = current;
+    }
+
+    size_t released = 0;
+    StoreMap** link = &store->maps;
+    while (*link) {
+        StoreMap* m = *link;
+        if (current && (m == current->data || m == current->index)) {
+            link = &m->next;
+            continue;
+        }
+        *link = m->next;
+        munmap(m->addr, m->size);
+        released += m->size;
+        free(m);
+    }
+    pthread_mutex_unlock(&store->writeLock);
+    return released;
+}
+
+#else // _WIN32
+
+//  The store relies on shared file mappings updated in place and on
+//  advisory file locks; it is not available on Windows yet.
+
+int feStoreOpen(FEStore** store, const char* path, bool const writable) {
+    (void)path; (void)writable;
+    if (store) *store = NULL;
+    printf("feStoreOpen error: not supported on this platform.\n");
+    return -2;
+}
+
+void feStoreClose(FEStore* store) { (void)store; }
+
+int feStorePut(FEStore *const store, uint64_t const deviceId, const HelperData *const h) {
+    (void)store; (void)deviceId; (void)h;
+    return -2;
+}
+
+int feStoreDelete(FEStore *const store, uint64_t const deviceId) {
+    (void)store; (void)deviceId;
+    return -2;
+}
+
+int feStoreGet(FEStore *const store, uint64_t const deviceId, HelperData *const h, bool const verify) {
+    (void)store; (void)deviceId; (void)h; (void)verify;
+    return -2;
+}
+
+size_t feStoreCount(FEStore *const store) { (void)store; return 0; }
+
+size_t feStoreList(FEStore *const store, uint64_t ids[], size_t const maxIds) {
+    (void)store; (void)ids; (void)maxIds;
+    return 0;
+}
+
+size_t feStoreGarbage(FEStore *const store) { (void)store; return 0; }
+
+int feStoreCompact(FEStore *const store) { (void)store; return -2; }
+
+int feStoreSync(FEStore *const store) { (void)store; return -2; }
+
+int feStoreRefresh(FEStore *const store) { (void)store; return -2; }
+
+size_t feStoreRelease(FEStore *const store) { (void)store; return 0; }
+
+#endif // _WIN32
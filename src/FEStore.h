@@ -0,0 +1,216 @@
+//########################################################################
+// (C) Embedded Systems Lab
+// All rights reserved.
+// ------------------------------------------------------------
+// This document contains proprietary information belonging to
+// Research & Development FH OÖ Forschungs und Entwicklungs GmbH.
+// Using, passing on and copying of this document or parts of it
+// is generally not permitted without prior written authorization.
+// ------------------------------------------------------------
+// info(at)embedded-lab.at
+// https://www.embedded-lab.at/
+//########################################################################
+// *** File name: FEStore.h
+// *** Date of file creation: 2022-02-07
+// *** List of autors: Lucas Drack
+// ***
+// *** Enrollment store: helper data of many devices keyed by device ID.
+//########################################################################
+
+#ifndef __FE_STORE_H__
+#define __FE_STORE_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "CFuzzyExtractor.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * File format
+ * --------------------
+ *  A store is two files. The data file at path is a 64 byte header followed
+ *  by records that are only ever appended: a 64 byte record header (device
+ *  ID, payload size, flags) and, unless the record deletes the device, the
+ *  helper data serialized as by serializeHelperData(). Records start at
+ *  multiples of 64, so a mapped record is viewed in place with
+ *  viewHelperData().
+ *
+ *  The index at path + ".idx" is an open addressing hash table from device
+ *  ID to the offset of its latest record. It also records how much of the
+ *  data file it covers, so records appended after a crash are replayed on
+ *  the next open. A missing, stale or damaged index is rebuilt from the
+ *  data file by the writer.
+ *
+ *  Re-enrolling a device appends a new record and leaves the old one as
+ *  garbage until feStoreCompact() rewrites the store with live records
+ *  only. All fields are in host byte order, like helper data files.
+ *
+ * Concurrency
+ * --------------------
+ *  Any number of threads may call feStoreGet() and feStoreList() without
+ *  locks while one writer puts, deletes or compacts. Writer calls are
+ *  serialized internally. Only one process can open a store for writing.
+ *
+ *  Helper data returned by feStoreGet() points into a mapping that stays
+ *  valid across puts, deletes and compaction. Mappings superseded by a
+ *  grown index, a grown data file or compaction are kept until
+ *  feStoreRelease() or feStoreClose(), and so is the disk space of the
+ *  data file replaced by compaction: it is unlinked but still mapped.
+ *  Call feStoreRelease() after compacting, once no reader is inside a
+ *  store call and no helper data got from the store before is in use.
+ *
+ *  Handles opened read-only in another process see devices added before
+ *  the index last grew or the store was compacted; feStoreRefresh() maps
+ *  the current files.
+ */
+#define FE_STORE_MAGIC          "CFES"
+#define FE_STORE_INDEX_MAGIC    "CFEI"
+#define FE_STORE_RECORD_MAGIC   "CFER"
+#define FE_STORE_VERSION        1
+#define FE_STORE_HEADER_SIZE    64
+
+#define FE_STORE_RECORD_DELETED 0x1u
+
+//  Result codes in addition to the usual negative errors.
+#define FE_STORE_NOT_FOUND  -4
+#define FE_STORE_STALE      -6
+
+typedef struct FEStore FEStore;
+
+/*
+ * Function: feStoreOpen
+ * --------------------
+ *   Opens the store at path, creating it if writable and it does not exist.
+ *
+ *   store:    receives the handle. The caller MUST call feStoreClose().
+ *   path:     the data file; the index is path + ".idx"
+ *   writable: open as the single writer. Fails if another process holds
+ *             the store for writing.
+ *
+ *   returns: 0 on success, negative int otherwise
+ */
+int feStoreOpen(FEStore** store, const char* path, bool const writable);
+
+/*
+ * Function: feStoreClose
+ * --------------------
+ *   Closes the store and releases all its mappings. Helper data obtained
+ *   from feStoreGet() must not be used afterwards.
+ */
+void feStoreClose(FEStore* store);
+
+/*
+ * Function: feStorePut
+ * --------------------
+ *   Enrolls deviceId with helper data h, replacing a previous enrollment.
+ *
+ *   deviceId: any value but UINT64_MAX
+ *
+ *   returns: 0 on success, negative int otherwise
+ */
+int feStorePut(FEStore *const store, uint64_t const deviceId, const HelperData *const h);
+
+/*
+ * Function: feStoreDelete
+ * --------------------
+ *   returns: 0 on success, FE_STORE_NOT_FOUND if deviceId is not enrolled,
+ *            other negative int otherwise
+ */
+int feStoreDelete(FEStore *const store, uint64_t const deviceId);
+
+/*
+ * Function: feStoreGet
+ * --------------------
+ *   Looks deviceId up in the index and points a read-only h into the
+ *   mapped record. Nothing is deserialized or copied. Lock-free.
+ *
+ *   h:      receives the view. Any previous content is freed.
+ *   verify: if true, the checksum of the record is verified
+ *
+ *   returns: 0 on success, FE_STORE_NOT_FOUND if deviceId is not enrolled,
+ *            FE_STORE_STALE if the record is newer than this handle's
+ *            mapping (see feStoreRefresh()), other negative int otherwise
+ */
+int feStoreGet(FEStore *const store, uint64_t const deviceId, HelperData *const h, bool const verify);
+
+/*
+ * Function: feStoreCount
+ * --------------------
+ *   returns: the number of enrolled devices
+ */
+size_t feStoreCount(FEStore *const store);
+
+/*
+ * Function: feStoreList
+ * --------------------
+ *   Writes up to maxIds enrolled device IDs to ids, in index order.
+ *   Lock-free; devices enrolled concurrently may or may not be listed.
+ *
+ *   returns: the number of IDs written
+ */
+size_t feStoreList(FEStore *const store, uint64_t ids[], size_t const maxIds);
+
+/*
+ * Function: feStoreGarbage
+ * --------------------
+ *   returns: bytes of the data file held by replaced or deleted records,
+ *            which feStoreCompact() would reclaim
+ */
+size_t feStoreGarbage(FEStore *const store);
+
+/*
+ * Function: feStoreCompact
+ * --------------------
+ *   Rewrites data file and index with the live records only and replaces
+ *   both atomically. Readers keep working during compaction. The old files
+ *   stay mapped, and the old data file keeps its disk space, until
+ *   feStoreRelease() or feStoreClose().
+ *
+ *   returns: 0 on success, negative int otherwise
+ */
+int feStoreCompact(FEStore *const store);
+
+/*
+ * Function: feStoreSync
+ * --------------------
+ *   Flushes data file and index to disk. Puts and deletes are not durable
+ *   before this returns.
+ *
+ *   returns: 0 on success, negative int otherwise
+ */
+int feStoreSync(FEStore *const store);
+
+/*
+ * Function: feStoreRefresh
+ * --------------------
+ *   Maps the current files of a store opened read-only, after another
+ *   process grew the index or compacted the store. Must not run
+ *   concurrently with other calls on the same handle. No-op for writers.
+ *
+ *   returns: 0 on success, negative int otherwise
+ */
+int feStoreRefresh(FEStore *const store);
+
+/*
+ * Function: feStoreRelease
+ * --------------------
+ *   Unmaps the mappings superseded by index growth, data file growth,
+ *   compaction or feStoreRefresh(), releasing their address space and the
+ *   disk space of replaced files. The caller guarantees that no other call
+ *   on the handle runs concurrently and that no helper data got from
+ *   feStoreGet() before is used afterwards; it must be fetched again.
+ *
+ *   returns: bytes of address space released
+ */
+size_t feStoreRelease(FEStore *const store);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __FE_STORE_H__
@@ -0,0 +1,275 @@
+//########################################################################
+// (C) Embedded Systems Lab
+// All rights reserved.
+// ------------------------------------------------------------
+// This document contains proprietary information belonging to
+// Research & Development FH OÖ Forschungs und Entwicklungs GmbH.
+// Using, passing on and copying of this document or parts of it
+// is generally not permitted without prior written authorization.
+// ------------------------------------------------------------
+// info(at)embedded-lab.at
+// https://www.embedded-lab.at/
+//########################################################################
+// *** File name: FuzzyExtractor.hpp
+// *** Date of file creation: 2022-02-07
+// *** List of autors: Lucas Drack
+// ***
+// *** Header-only C++17 front-end of the Canetti construction for a
+// *** value length and Hamming error fixed at compile time.
+//########################################################################
+
+#ifndef __FUZZYEXTRACTOR_HPP__
+#define __FUZZYEXTRACTOR_HPP__
+
+#include <array>
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <ratio>
+
+#include "CFuzzyExtractor.h"
+
+//  Most products use one fingerprint size. With Length, HamErr and RepErr
+//  as template parameters, numHelpers and cipherLen are constants, all
+//  buffers are std::arrays of known size (so the masking and padding loops
+//  are unrolled and vectorized), and the extractor allocates no memory of
+//  its own on reproduction.
+//
+//  The lockers are the same as those of feGenerate()/feReproduce(): helper
+//  data can be exported to a C HelperData (and from there saved with
+//  saveHelperData()) and imported back.
+
+namespace fe {
+
+namespace detail {
+
+//  e^n for integer n, the same value as pow(bits, n / log(bits)) in
+//  initFEProperties().
+constexpr double expInt(std::size_t n) {
+    double result = 1.0;
+    for (std::size_t j = 0; j < n; j++) result *= 2.718281828459045235360287;
+    return result;
+}
+
+//  log2(x) for x >= 1: the exponent by halving, the rest by the atanh series
+//  ln(m) = 2 * sum z^(2k+1) / (2k+1) with z = (m - 1) / (m + 1) <= 1/3.
+constexpr double log2(double x) {
+    double exponent = 0.0;
+    while (x >= 2.0) {
+        x /= 2.0;
+        exponent += 1.0;
+    }
+    double const z = (x - 1.0) / (x + 1.0);
+    double term = z;
+    double ln = 0.0;
+    for (int k = 0; k < 40; k++) {
+        ln += term / (2 * k + 1);
+        term *= z * z;
+    }
+    return exponent + 2.0 * ln / 0.693147180559945309417232;
+}
+
+//  See initFEProperties(): round(bits^(hamErr / ln(bits)) * log2(2 / repErr))
+//  = round(e^hamErr * log2(2 / repErr)).
+constexpr std::size_t numHelpers(std::size_t hamErr, double repErr) {
+    return static_cast<std::size_t>(expInt(hamErr) * log2(2.0 / repErr) + 0.5);
+}
+
+} // namespace detail
+
+
+/*
+ * Class: FuzzyExtractor
+ * --------------------
+ *  Length: length in bytes of source values and keys
+ *  HamErr: Hamming error, see FEProperties
+ *  RepErr: reproduce error as std::ratio (default: 1/1000)
+ *
+ *  An extractor only holds its locker parameters and may be copied. Errors
+ *  are reported as in the C API: 0 on success, negative int otherwise.
+ */
+template <std::size_t Length, std::size_t HamErr, class RepErr = std::ratio<1, 1000>>
+class FuzzyExtractor {
+    static_assert(Length > 0, "Length must not be 0");
+    static_assert(HamErr < Length * 8, "HamErr must be smaller than the number of bits");
+    static_assert(RepErr::num > 0 && RepErr::num < RepErr::den, "RepErr must be in (0, 1)");
+
+public:
+    static constexpr std::size_t length = Length;
+    static constexpr std::size_t hamErr = HamErr;
+    static constexpr double repErr = static_cast<double>(RepErr::num) / RepErr::den;
+    static constexpr std::size_t secLen = 2;
+    static constexpr std::size_t nonceLen = LOCKER_NONCE_LEN;
+    static constexpr std::size_t cipherLen = Length + secLen;
+    static constexpr std::size_t numHelpers = detail::numHelpers(HamErr, repErr);
+
+    using Value = std::array<unsigned char, Length>;
+    using Key = std::array<unsigned char, Length>;
+
+    //  Mask, nonce and cipher of one locker.
+    struct Helper {
+        std::array<unsigned char, Length> mask;
+        std::array<unsigned char, nonceLen> nonce;
+        std::array<unsigned char, cipherLen> cipher;
+    };
+
+    /*
+     * Class: HelperData
+     * --------------------
+     *  Public helper data of numHelpers lockers in a single allocation,
+     *  released when the object is destroyed. Move-only.
+     */
+    class HelperData {
+    public:
+        HelperData() : helpers_(new (std::nothrow) Helper[numHelpers]) {
+            initLockerParams(&locker_, LOCKER_ARGON2ID);
+        }
+
+        HelperData(HelperData&&) noexcept = default;
+        HelperData& operator=(HelperData&&) noexcept = default;
+        HelperData(const HelperData&) = delete;
+        HelperData& operator=(const HelperData&) = delete;
+
+        //  False if the allocation failed or the object was moved from.
+        bool valid() const { return helpers_ != nullptr; }
+
+        Helper& operator[](std::size_t i) { return helpers_[i]; }
+        const Helper& operator[](std::size_t i) const { return helpers_[i]; }
+
+        const LockerParams& locker() const { return locker_; }
+        static constexpr std::size_t size() { return numHelpers; }
+
+        /*
+         * Function: exportTo
+         * --------------------
+         *   Copies the helper data into a newly allocated C HelperData.
+         *   The caller MUST call freeHelperData() on h.
+         *
+         *   returns: 0 on success, negative int otherwise
+         */
+        int exportTo(::HelperData *const h) const {
+            if (!h || !valid()) return -1;
+            freeHelperData(h);
+            if (allocateHelperData(h, Length, cipherLen, numHelpers) != 0) return -3;
+            h->locker = locker_;
+            for (std::size_t i = 0; i < numHelpers; i++) {
+                std::memcpy(helperMask(h, i), helpers_[i].mask.data(), Length);
+                std::memcpy(helperNonce(h, i), helpers_[i].nonce.data(), nonceLen);
+                std::memcpy(helperCipher(h, i), helpers_[i].cipher.data(), cipherLen);
+            }
+            return 0;
+        }
+
+        /*
+         * Function: importFrom
+         * --------------------
+         *   Copies C helper data of the same dimensions into this object.
+         *   Seeded helper data is expanded; sampled helper data is not
+         *   supported.
+         *
+         *   returns: 0 on success, negative int otherwise
+         */
+        int importFrom(const ::HelperData& h) {
+            if (!valid() || !h.block) return -1;
+            if (h.length != Length || h.cipherLen != cipherLen || h.nonceLen != nonceLen ||
+                    h.numHelpers != numHelpers || h.sampleBits != 0) {
+                return -2;
+            }
+            locker_ = h.locker;
+            for (std::size_t i = 0; i < numHelpers; i++) {
+                getHelperMaskNonce(&h, i, helpers_[i].mask.data(), helpers_[i].nonce.data());
+                std::memcpy(helpers_[i].cipher.data(), helperCipher(&h, i), cipherLen);
+            }
+            return 0;
+        }
+
+    private:
+        friend class FuzzyExtractor;
+
+        std::unique_ptr<Helper[]> helpers_;
+        LockerParams locker_;
+    };
+
+    explicit FuzzyExtractor(LockerAlgorithm const algorithm = LOCKER_ARGON2ID) {
+        initLockerParams(&locker_, algorithm);
+    }
+
+    explicit FuzzyExtractor(const LockerParams& locker) : locker_(locker) {}
+
+    /*
+     * Function: generate
+     * --------------------
+     *   Counterpart of feGenerate(): picks a random key and locks it into
+     *   every helper of h with fresh masks and nonces.
+     *
+     *   returns: 0 on success, negative int otherwise
+     */
+    int generate(const Value& value, Key& key, HelperData& h) {
+        if (!h.valid()) return -1;
+        if (!lockerParamsValid(&locker_)) return -2;
+        h.locker_ = locker_;
+
+        randombytes_buf(key.data(), Length);
+        std::array<unsigned char, cipherLen> keyPadded{};
+        for (std::size_t j = 0; j < Length; j++) keyPadded[j] = key[j];
+
+        int ret = 0;
+        for (std::size_t i = 0; i < numHelpers && ret == 0; i++) {
+            Helper& helper = h[i];
+            randombytes_buf(helper.mask.data(), Length);
+            randombytes_buf(helper.nonce.data(), nonceLen);
+
+            Value vector;
+            for (std::size_t j = 0; j < Length; j++) vector[j] = value[j] & helper.mask[j];
+            if (lockerHash(&locker_, helper.cipher.data(), cipherLen,
+                    vector.data(), Length, helper.nonce.data()) != 0) {
+                ret = -3;
+                break;
+            }
+            for (std::size_t j = 0; j < cipherLen; j++) helper.cipher[j] ^= keyPadded[j];
+        }
+        sodium_memzero(keyPadded.data(), cipherLen);
+        return ret;
+    }
+
+    /*
+     * Function: reproduce
+     * --------------------
+     *   Counterpart of feReproduce(). Tries the lockers in index order.
+     *
+     *   returns: 0 on success, -4 if no locker opened, other negative int on error
+     */
+    int reproduce(const Value& value, Key& key, const HelperData& h) {
+        if (!h.valid()) return -1;
+
+        for (std::size_t i = 0; i < numHelpers; i++) {
+            const Helper& helper = h[i];
+            Value vector;
+            std::array<unsigned char, cipherLen> digest;
+            for (std::size_t j = 0; j < Length; j++) vector[j] = value[j] & helper.mask[j];
+            if (lockerHash(&h.locker_, digest.data(), cipherLen,
+                    vector.data(), Length, helper.nonce.data()) != 0) {
+                return -3;
+            }
+
+            //  The padding of the key is all zero if the locker opened.
+            unsigned char diff = 0;
+            for (std::size_t j = Length; j < cipherLen; j++) diff |= digest[j] ^ helper.cipher[j];
+            if (diff != 0) continue;
+
+            for (std::size_t j = 0; j < Length; j++) key[j] = digest[j] ^ helper.cipher[j];
+            return 0;
+        }
+        return -4;
+    }
+
+    const LockerParams& locker() const { return locker_; }
+
+private:
+    LockerParams locker_;
+};
+
+} // namespace fe
+
+#endif // __FUZZYEXTRACTOR_HPP__
@@ -0,0 +1,292 @@
+//########################################################################
+// (C) Embedded Systems Lab
+// All rights reserved.
+// ------------------------------------------------------------
+// This document contains proprietary information belonging to
+// Research & Development FH OÖ Forschungs und Entwicklungs GmbH.
+// Using, passing on and copying of this document or parts of it
+// is generally not permitted without prior written authorization.
+// ------------------------------------------------------------
+// info(at)embedded-lab.at
+// https://www.embedded-lab.at/
+//########################################################################
+// *** File name: HelperDataFile.c
+// *** Date of file creation: 2022-02-07
+// *** List of autors: Lucas Drack
+// ***
+// *** Binary on-disk format for HelperData.
+//########################################################################
+
+#include "HelperDataFile.h"
+
+#include <stdlib.h>
+#include <string.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+_Static_assert(sizeof(HelperDataFileHeader) == HD_FILE_HEADER_SIZE,
+        "HelperDataFileHeader must match HD_FILE_HEADER_SIZE");
+
+static void checksumRecord(const HelperDataFileHeader *const header, const void* block,
+        size_t const blockSize, uint8_t out[HD_FILE_CHECKSUM_LEN]) {
+    HelperDataFileHeader copy = *header;
+    memset(copy.checksum, 0, HD_FILE_CHECKSUM_LEN);
+
+    crypto_generichash_state state;
+    crypto_generichash_init(&state, NULL, 0, HD_FILE_CHECKSUM_LEN);
+    crypto_generichash_update(&state, (const unsigned char*)&copy, sizeof(copy));
+    crypto_generichash_update(&state, (const unsigned char*)block, blockSize);
+    crypto_generichash_final(&state, out, HD_FILE_CHECKSUM_LEN);
+}
+
+size_t helperDataFileSize(const HelperData *const h) {
+    if (!h) return 0;
+    return HD_FILE_HEADER_SIZE + h->blockSize;
+}
+
+int serializeHelperData(const HelperData *const h, void* buf, size_t const size) {
+    if (!h || !h->block || !buf) {
+        printf("serializeHelperData error: nullptr argument.\n");
+        return -1;
+    }
+    if (size < helperDataFileSize(h)) {
+        printf("serializeHelperData error: buffer too small.\n");
+        return -2;
+    }
+
+    HelperDataFileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, HD_FILE_MAGIC, 4);
+    header.version    = HD_FILE_VERSION;
+    header.headerSize = HD_FILE_HEADER_SIZE;
+    header.byteOrder  = HD_FILE_BYTE_ORDER;
+    header.length     = h->length;
+    header.nonceLen   = h->nonceLen;
+    header.cipherLen  = h->cipherLen;
+    header.numHelpers = h->numHelpers;
+    header.algorithm  = (uint32_t)h->locker.algorithm;
+    header.opslimit   = h->locker.opslimit;
+    header.memlimit   = h->locker.memlimit;
+    header.blockSize  = h->blockSize;
+    if (h->seeded) {
+        header.flags |= HD_FILE_FLAG_SEEDED;
+        memcpy(header.seed, h->seed, sizeof(header.seed));
+    }
+    if (h->sampleBits) {
+        header.flags |= HD_FILE_FLAG_SAMPLED;
+        header.sampleBits = (uint32_t)h->sampleBits;
+    }
+    checksumRecord(&header, h->block, h->blockSize, header.checksum);
+
+    memcpy(buf, &header, sizeof(header));
+    memcpy((unsigned char*)buf + HD_FILE_HEADER_SIZE, h->block, h->blockSize);
+    return 0;
+}
+
+int viewHelperData(HelperData *const h, const void* buf, size_t const size, bool const verify) {
+    if (!h || !buf) {
+        printf("viewHelperData error: nullptr argument.\n");
+        return -1;
+    }
+    if (size < HD_FILE_HEADER_SIZE || ((uintptr_t)buf % 64) != 0) {
+        printf("viewHelperData error: buffer too small or misaligned.\n");
+        return -2;
+    }
+
+    HelperDataFileHeader header;
+    memcpy(&header, buf, sizeof(header));
+    if (memcmp(header.magic, HD_FILE_MAGIC, 4) != 0 || header.headerSize != HD_FILE_HEADER_SIZE) {
+        printf("viewHelperData error: not a helper data record.\n");
+        return -3;
+    }
+    if (header.version < 1 || header.version > HD_FILE_VERSION ||
+            header.byteOrder != HD_FILE_BYTE_ORDER ||
+            (header.flags & ~(HD_FILE_FLAG_SEEDED | HD_FILE_FLAG_SAMPLED)) != 0) {
+        printf("viewHelperData error: unsupported version or byte order.\n");
+        return -4;
+    }
+    LockerParams locker;
+    locker.algorithm = (LockerAlgorithm)header.algorithm;
+    locker.opslimit  = header.opslimit;
+    locker.memlimit  = (size_t)header.memlimit;
+    if (!lockerParamsValid(&locker) || header.memlimit != locker.memlimit ||
+            header.nonceLen != LOCKER_NONCE_LEN) {
+        printf("viewHelperData error: unsupported locker parameters.\n");
+        return -5;
+    }
+
+    //  Checked before anything is derived from them, also without verify:
+    //  the store views mapped records unverified.
+    if (header.length == 0 || header.length > HD_FILE_MAX_LENGTH ||
+            header.cipherLen < header.length || header.cipherLen - header.length > HD_FILE_MAX_PADDING ||
+            header.numHelpers > HD_FILE_MAX_HELPERS || header.sampleBits > header.length * 8) {
+        printf("viewHelperData error: dimensions out of range.\n");
+        return -6;
+    }
+
+    HelperData dims;
+    initHelperData(&dims);
+    dims.length     = header.length;
+    dims.nonceLen   = header.nonceLen;
+    dims.cipherLen  = header.cipherLen;
+    dims.numHelpers = header.numHelpers;
+    dims.seeded     = (header.flags & HD_FILE_FLAG_SEEDED) != 0;
+    dims.sampleBits = (header.flags & HD_FILE_FLAG_SAMPLED) ? header.sampleBits : 0;
+    dims.locker     = locker;
+    if (((header.flags & HD_FILE_FLAG_SAMPLED) != 0) != (header.sampleBits != 0) ||
+            helperDataBlockSize(&dims) == 0 ||
+            header.blockSize != helperDataBlockSize(&dims) ||
+            header.blockSize > size - HD_FILE_HEADER_SIZE) {
+        printf("viewHelperData error: inconsistent sizes.\n");
+        return -6;
+    }
+
+    const unsigned char* block = (const unsigned char*)buf + HD_FILE_HEADER_SIZE;
+    if (dims.sampleBits && !dims.seeded) {
+        //  Reproduction gathers bits at the stored indices, so an index out
+        //  of range would read beyond the value. This check is needed even
+        //  without verify.
+        const uint32_t* indices = (const uint32_t*)block;
+        for (size_t j = 0; j < dims.numHelpers * dims.sampleBits; j++) {
+            if (indices[j] >= header.length * 8) {
+                printf("viewHelperData error: sample index out of range.\n");
+                return -6;
+            }
+        }
+    }
+    if (verify) {
+        uint8_t checksum[HD_FILE_CHECKSUM_LEN];
+        checksumRecord(&header, block, header.blockSize, checksum);
+        if (memcmp(checksum, header.checksum, HD_FILE_CHECKSUM_LEN) != 0) {
+            printf("viewHelperData error: checksum mismatch.\n");
+            return -7;
+        }
+    }
+
+    freeHelperData(h);
+    *h = dims;
+    if (h->seeded) {
+        memcpy(h->seed, header.seed, sizeof(h->seed));
+    }
+    h->block      = (void*)block;
+    h->blockSize  = header.blockSize;
+    h->readOnly   = true;
+    layoutHelperData(h);
+    return 0;
+}
+
+int saveHelperData(const HelperData *const h, const char* path) {
+    if (!h || !h->block || !path) {
+        printf("saveHelperData error: nullptr argument.\n");
+        return -1;
+    }
+
+    size_t size = helperDataFileSize(h);
+    void* buf = malloc(size);
+    if (!buf) {
+        printf("saveHelperData error: malloc failed.\n");
+        return -2;
+    }
+    int ret = serializeHelperData(h, buf, size);
+
+    FILE* stream = (ret == 0) ? fopen(path, "wb") : NULL;
+    if (ret == 0 && !stream) {
+        printf("saveHelperData error: cannot open %s.\n", path);
+        ret = -3;
+    }
+    if (stream) {
+        if (fwrite(buf, 1, size, stream) != size) ret = -4;
+        if (fclose(stream) != 0) ret = -4;
+        if (ret != 0) printf("saveHelperData error: cannot write %s.\n", path);
+    }
+    free(buf);
+    return ret;
+}
+
+int loadHelperData(HelperData *const h, const char* path) {
+    if (!h || !path) {
+        printf("loadHelperData error: nullptr argument.\n");
+        return -1;
+    }
+
+    // Map, verify and copy into a regular owned helper data.
+    HelperData view;
+    initHelperData(&view);
+    int ret = mapHelperData(&view, path, true);
+    if (ret != 0) return ret;
+
+    ret = copyHelperData(h, &view);
+    freeHelperData(&view);
+    return ret;
+}
+
+int mapHelperData(HelperData *const h, const char* path, bool const verify) {
+    if (!h || !path) {
+        printf("mapHelperData error: nullptr argument.\n");
+        return -1;
+    }
+
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+            FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE) {
+        printf("mapHelperData error: cannot open %s.\n", path);
+        return -2;
+    }
+    LARGE_INTEGER fileSize;
+    GetFileSizeEx(file, &fileSize);
+    size_t size = (size_t)fileSize.QuadPart;
+    HANDLE section = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    void* mapping = section ? MapViewOfFile(section, FILE_MAP_READ, 0, 0, 0) : NULL;
+    if (section) CloseHandle(section);
+    CloseHandle(file);
+    if (!mapping) {
+        printf("mapHelperData error: cannot map %s.\n", path);
+        return -2;
+    }
+#else
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        printf("mapHelperData error: cannot open %s.\n", path);
+        return -2;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < HD_FILE_HEADER_SIZE) {
+        printf("mapHelperData error: %s is not a helper data file.\n", path);
+        close(fd);
+        return -2;
+    }
+    size_t size = (size_t)st.st_size;
+    void* mapping = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        printf("mapHelperData error: cannot map %s.\n", path);
+        return -2;
+    }
+#endif
+
+    int ret = viewHelperData(h, mapping, size, verify);
+    if (ret != 0) {
+        unmapHelperDataFile(mapping, size);
+        return ret;
+    }
+    h->mapping = mapping;
+    h->mappingSize = size;
+    return 0;
+}
+
+void unmapHelperDataFile(void* mapping, size_t const size) {
+    if (!mapping) return;
+#ifdef _WIN32
+    (void)size;
+    UnmapViewOfFile(mapping);
+#else
+    munmap(mapping, size);
+#endif
+}
@@ -0,0 +1,176 @@
+//########################################################################
+// (C) Embedded Systems Lab
+// All rights reserved.
+// ------------------------------------------------------------
+// This document contains proprietary information belonging to
+// Research & Development FH OÖ Forschungs und Entwicklungs GmbH.
+// Using, passing on and copying of this document or parts of it
+// is generally not permitted without prior written authorization.
+// ------------------------------------------------------------
+// info(at)embedded-lab.at
+// https://www.embedded-lab.at/
+//########################################################################
+// *** File name: HelperDataFile.h
+// *** Date of file creation: 2022-02-07
+// *** List of autors: Lucas Drack
+// ***
+// *** Binary on-disk format for HelperData.
+//########################################################################
+
+#ifndef __HELPERDATAFILE_H__
+#define __HELPERDATAFILE_H__
+
+#include <stdint.h>
+#include "CFuzzyExtractor.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * File format
+ * --------------------
+ *  A helper data file is a fixed 128 byte header followed by the helper
+ *  data block exactly as it is laid out in memory (see layoutHelperData()).
+ *  The header size is a multiple of the cache line, so a mapped file can be
+ *  used in place without copying.
+ *
+ *  All fields are stored in the byte order of the writing host. byteOrder
+ *  lets the reader detect a file written on a host of different endianness,
+ *  which is rejected.
+ *
+ *  magic:      "CFEH"
+ *  version:    Format version (HD_FILE_VERSION)
+ *  headerSize: Size of this header in bytes (128)
+ *  byteOrder:  HD_FILE_BYTE_ORDER as written by the host
+ *  flags:      HD_FILE_FLAG_SEEDED if masks and nonces are derived from seed,
+ *              HD_FILE_FLAG_SAMPLED if lockers sample bit indices
+ *  length, nonceLen, cipherLen, numHelpers: see HelperData
+ *  algorithm:  LockerAlgorithm the lockers were created with
+ *  sampleBits: Bits sampled per locker, 0 unless HD_FILE_FLAG_SAMPLED is set
+ *  opslimit, memlimit: cost parameters of the lockers (see LockerParams)
+ *  blockSize:  Size of the block following the header
+ *  checksum:   BLAKE2b-128 over the header (with checksum zeroed) and block
+ *  seed:       Seed of seeded helper data, zero otherwise
+ *
+ *  Version 1 files have no flags and no seed, version 2 files have no
+ *  sampled lockers; both are still accepted.
+ */
+#define HD_FILE_MAGIC       "CFEH"
+#define HD_FILE_VERSION     3
+#define HD_FILE_HEADER_SIZE 128
+#define HD_FILE_BYTE_ORDER  0x01020304u
+#define HD_FILE_CHECKSUM_LEN 16
+#define HD_FILE_FLAG_SEEDED 0x1u
+#define HD_FILE_FLAG_SAMPLED 0x2u
+
+//  Largest dimensions a reader accepts. Values and ciphers are held on the
+//  stack while lockers are hashed, so a damaged header must not be trusted.
+#define HD_FILE_MAX_LENGTH   4096           // bytes of the value
+#define HD_FILE_MAX_PADDING  FE_MAX_SEC_LEN // cipherLen - length
+#define HD_FILE_MAX_HELPERS  (1ull << 32)
+
+typedef struct {
+    char     magic[4];
+    uint16_t version;
+    uint16_t headerSize;
+    uint32_t byteOrder;
+    uint32_t flags;
+    uint64_t length;
+    uint64_t nonceLen;
+    uint64_t cipherLen;
+    uint64_t numHelpers;
+    uint32_t algorithm;
+    uint32_t sampleBits;
+    uint64_t opslimit;
+    uint64_t memlimit;
+    uint64_t blockSize;
+    uint8_t  checksum[HD_FILE_CHECKSUM_LEN];
+    uint8_t  seed[32];
+} HelperDataFileHeader;
+
+/*
+ * Function: helperDataFileSize
+ * --------------------
+ *   returns: the number of bytes serializeHelperData() writes for h
+ */
+size_t helperDataFileSize(const HelperData *const h);
+
+/*
+ * Function: serializeHelperData
+ * --------------------
+ *   Writes header and block of h into buf.
+ *
+ *   h:    the helper data to serialize
+ *   buf:  destination, at least helperDataFileSize(h) bytes
+ *   size: size of buf in bytes
+ *
+ *   returns: 0 on success, negative int otherwise
+ */
+int serializeHelperData(const HelperData *const h, void* buf, size_t const size);
+
+/*
+ * Function: viewHelperData
+ * --------------------
+ *   Validates a serialized helper data record and points a read-only h
+ *   straight into buf. Nothing is copied, so buf must outlive h.
+ *   freeHelperData() on h does not touch buf.
+ *
+ *   h:      receives the read-only view. Any previous content is freed.
+ *   buf:    the serialized record, aligned to 64 bytes
+ *   size:   size of buf in bytes
+ *   verify: if true, the checksum over the whole record is verified. The
+ *           dimensions are always checked against the HD_FILE_MAX_* limits
+ *           and the size of buf.
+ *
+ *   returns: 0 on success, negative int otherwise
+ */
+int viewHelperData(HelperData *const h, const void* buf, size_t const size, bool const verify);
+
+/*
+ * Function: saveHelperData
+ * --------------------
+ *   Writes h to the file at path, replacing it.
+ *
+ *   returns: 0 on success, negative int otherwise
+ */
+int saveHelperData(const HelperData *const h, const char* path);
+
+/*
+ * Function: loadHelperData
+ * --------------------
+ *   Reads the file at path into a newly allocated, writable h.
+ *
+ *   returns: 0 on success, negative int otherwise
+ */
+int loadHelperData(HelperData *const h, const char* path);
+
+/*
+ * Function: mapHelperData
+ * --------------------
+ *   Maps the file at path into memory and points a read-only h into the
+ *   mapping without parsing or copying the helper arrays. The mapping is
+ *   released by freeHelperData().
+ *
+ *   h:      receives the read-only helper data. Any previous content is freed.
+ *   path:   the helper data file
+ *   verify: if true, the checksum is verified. This touches every page
+ *           of the file.
+ *
+ *   returns: 0 on success, negative int otherwise
+ */
+int mapHelperData(HelperData *const h, const char* path, bool const verify);
+
+/*
+ * Function: unmapHelperDataFile
+ * --------------------
+ *   Releases a mapping created by mapHelperData(). Called by
+ *   freeHelperData(); there is no need to call it directly.
+ */
+void unmapHelperDataFile(void* mapping, size_t const size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __HELPERDATAFILE_H__
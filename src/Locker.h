@@ -0,0 +1,113 @@
+//########################################################################
+// (C) Embedded Systems Lab
+// All rights reserved.
+// ------------------------------------------------------------
+// This document contains proprietary information belonging to
+// Research & Development FH OÖ Forschungs und Entwicklungs GmbH.
+// Using, passing on and copying of this document or parts of it
+// is generally not permitted without prior written authorization.
+// ------------------------------------------------------------
+// info(at)embedded-lab.at
+// https://www.embedded-lab.at/
+//########################################################################
+// *** File name: Locker.h
+// *** Date of file creation: 2022-02-07
+// *** List of autors: Lucas Drack
+// ***
+// *** Hash backends for the digital lockers.
+//########################################################################
+
+#ifndef __LOCKER_H__
+#define __LOCKER_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sodium.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*  
+ * Enum: LockerAlgorithm
+ * --------------------
+ *  Hash primitive a digital locker is built from. The values are stored in
+ *  helper data files; the Argon2 values equal libsodium's crypto_pwhash
+ *  algorithm ids.
+ *
+ *  LOCKER_ARGON2I:        Argon2i v1.3 (crypto_pwhash)
+ *  LOCKER_ARGON2ID:       Argon2id v1.3 (crypto_pwhash), the default
+ *  LOCKER_BLAKE2B:        BLAKE2b keyed with the nonce (crypto_generichash).
+ *                         Fast, no memory hardness.
+ *  LOCKER_PBKDF2_SHA256:  PBKDF2-HMAC-SHA256 with the nonce as salt, as used
+ *                         by C. Yagemann's Python implementation
+ */
+typedef enum {
+    LOCKER_ARGON2I       = 1,
+    LOCKER_ARGON2ID      = 2,
+    LOCKER_BLAKE2B       = 16,
+    LOCKER_PBKDF2_SHA256 = 17
+} LockerAlgorithm;
+
+/*  
+ * Struct: LockerParams
+ * --------------------
+ *  algorithm: Hash primitive of the lockers
+ *  opslimit:  Argon2: number of passes. PBKDF2: number of iterations.
+ *             BLAKE2b: unused (0).
+ *  memlimit:  Argon2: memory in bytes. Unused (0) otherwise.
+ */
+typedef struct {
+    LockerAlgorithm algorithm;
+    uint64_t opslimit;
+    size_t memlimit;
+} LockerParams;
+
+/*
+ * Function: initLockerParams
+ * --------------------
+ *   Sets lp to algorithm with its cheapest cost parameters: the libsodium
+ *   minimum for Argon2, 1 iteration for PBKDF2 (as in the Python
+ *   implementation).
+ *
+ *   returns: 0 on success, negative int for an unknown algorithm
+ */
+int initLockerParams(LockerParams *const lp, LockerAlgorithm const algorithm);
+
+/*
+ * Function: lockerParamsValid
+ * --------------------
+ *   returns: true if lp names a known algorithm with supported cost parameters
+ */
+bool lockerParamsValid(const LockerParams *const lp);
+
+/*
+ * Function: lockerName
+ * --------------------
+ *   returns: a printable name of algorithm
+ */
+const char* lockerName(LockerAlgorithm const algorithm);
+
+/*
+ * Function: lockerHash
+ * --------------------
+ *   Hashes the locker input with the locker's nonce.
+ *
+ *   lp:     backend and cost parameters
+ *   out:    receives outLen bytes. Argon2 requires outLen >= 16.
+ *   in:     the (masked) locker input
+ *   nonce:  the locker nonce, LOCKER_NONCE_LEN bytes
+ *
+ *   returns: 0 on success, negative int otherwise
+ */
+#define LOCKER_NONCE_LEN crypto_pwhash_SALTBYTES
+
+int lockerHash(const LockerParams *const lp, unsigned char out[], size_t const outLen,
+        const unsigned char in[], size_t const inLen, const unsigned char nonce[]);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __LOCKER_H__
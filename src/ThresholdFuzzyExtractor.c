@@ -0,0 +1,386 @@
+//########################################################################
+// (C) Embedded Systems Lab
+// All rights reserved.
+// ------------------------------------------------------------
+// This document contains proprietary information belonging to
+// Research & Development FH OÖ Forschungs und Entwicklungs GmbH.
+// Using, passing on and copying of this document or parts of it
+// is generally not permitted without prior written authorization.
+// ------------------------------------------------------------
+// info(at)embedded-lab.at
+// https://www.embedded-lab.at/
+//########################################################################
+// *** File name: ThresholdFuzzyExtractor.c
+// *** Date of file creation: 2022-02-07
+// *** List of autors: Lucas Drack
+// ***
+// *** Threshold variant of the digital locker fuzzy extractor, based on
+// *** Cheon et al. 2018 (A Reusable Fuzzy Extractor with Practical
+// *** Storage Size: Modifying Canetti et al.'s Construction).
+//########################################################################
+
+#include "ThresholdFuzzyExtractor.h"
+#include "FESimd.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// Internal data type for brevity.
+typedef unsigned char byte;
+
+static double logBinomial(size_t const n, size_t const k) {
+    return lgamma((double)n + 1.0) - lgamma((double)k + 1.0) - lgamma((double)(n - k) + 1.0);
+}
+
+double feSampleOpenProbability(size_t const bits, size_t const hamErr, size_t const sampleBits,
+        size_t const threshold) {
+    if (sampleBits > bits || hamErr > bits) return 0.0;
+
+    double prob = 0.0;
+    double total = logBinomial(bits, sampleBits);
+    for (size_t j = 0; j <= threshold && j <= hamErr && j <= sampleBits; j++) {
+        // j of the sampled positions are wrong, the others are among the correct bits
+        if (sampleBits - j > bits - hamErr) continue;
+        prob += exp(logBinomial(hamErr, j) + logBinomial(bits - hamErr, sampleBits - j) - total);
+    }
+    return (prob > 1.0) ? 1.0 : prob;
+}
+
+void initFEThresholdProperties(FEThresholdProperties *const p, size_t const length, size_t const hamErr,
+        double const repErr, size_t const sampleBits, size_t const threshold) {
+    if(!p) return;
+
+    size_t bits = length * 8;
+    p->length = length;
+    p->hamErr = hamErr;
+    p->repErr = repErr;
+    p->sampleBits = (sampleBits == 0 || sampleBits > bits) ? bits / 2 : sampleBits;
+    p->threshold = (threshold > p->sampleBits) ? p->sampleBits : threshold;
+    p->nonceLen = crypto_pwhash_SALTBYTES;   // (16) fixed due to libsodium's Argon2 implementation
+    initLockerParams(&p->locker, LOCKER_ARGON2ID);
+
+    // Number of error patterns of weight <= threshold on a sample.
+    double patterns = 0.0;
+    for (size_t j = 0; j <= p->threshold; j++) {
+        patterns += round(exp(logBinomial(p->sampleBits, j)));
+    }
+    p->patterns = (size_t)patterns;
+
+    // Each tried pattern may open a locker by accident with 2^(-8 secLen),
+    // so the padding grows by one byte per 256 patterns.
+    p->secLen = 2 + (size_t)ceil(log2(patterns) / 8.0);
+    p->cipherLen = length + p->secLen;
+
+    // A reading within hamErr fails only if none of the lockers open:
+    // (1 - P(open))^numHelpers <= repErr
+    double open = feSampleOpenProbability(bits, hamErr, p->sampleBits, p->threshold);
+    if (open >= 1.0) {
+        p->numHelpers = 1;
+    }
+    else if (open <= 0.0) {
+        p->numHelpers = 0;
+    }
+    else {
+        p->numHelpers = (size_t)ceil(log(repErr) / log1p(-open));
+    }
+}
+
+void printFEThresholdProperties(FEThresholdProperties *const p) {
+    if(!p) return;
+
+    printf("\n*** Threshold Fuzzy Extractor Properties ***\n");
+    printf("Length: %zu\n", p->length);
+    printf("Hamming Err: %zu\n", p->hamErr);
+    printf("Reproduction Err: %f\n", p->repErr);
+    printf("Sample bits: %zu\n", p->sampleBits);
+    printf("Threshold: %zu\n", p->threshold);
+    printf("Security Len: %zu\n", p->secLen);
+    printf("Nonce Len: %zu\n", p->nonceLen);
+    printf("Patterns per locker: %zu\n", p->patterns);
+    printf("Cipher Len: %zu\n", p->cipherLen);
+    printf("# of helpers: %zu\n", p->numHelpers);
+}
+
+
+/**********************************************************/
+
+
+void initThresholdHelperData(ThresholdHelperData *const h) {
+    if(!h) return;
+    h->indices = 0;
+    h->nonces  = 0;
+    h->ciphers = 0;
+    h->block   = 0;
+    h->blockSize = 0;
+}
+
+//  One block holds [indices | nonces | ciphers] of all lockers.
+static int allocateThresholdHelperData(ThresholdHelperData *const h, const FEThresholdProperties *const p) {
+    h->length = p->length;
+    h->nonceLen = p->nonceLen;
+    h->cipherLen = p->cipherLen;
+    h->numHelpers = p->numHelpers;
+    h->sampleBits = p->sampleBits;
+    h->threshold = p->threshold;
+    h->locker = p->locker;
+
+    size_t indicesSize = p->numHelpers * p->sampleBits * sizeof(uint32_t);
+    h->blockSize = indicesSize + p->numHelpers * (p->nonceLen + p->cipherLen);
+    h->block = malloc(h->blockSize ? h->blockSize : 1);
+    if(!h->block) {
+        printf("Error in allocateThresholdHelperData: malloc failed.\n");
+        initThresholdHelperData(h);
+        return -1;
+    }
+    h->indices = (uint32_t*)h->block;
+    h->nonces  = (byte*)h->block + indicesSize;
+    h->ciphers = h->nonces + p->numHelpers * p->nonceLen;
+    return 0;
+}
+
+void freeThresholdHelperData(ThresholdHelperData *const h) {
+    if(!h || !h->block) return;
+    free(h->block);
+    initThresholdHelperData(h);
+}
+
+void printThresholdHelperData(ThresholdHelperData *const h) {
+    if(!h) return;
+
+    printf("\n*** Threshold helper data ***\n");
+    printf("Length: %zu\n", h->length);
+    printf("Nonce Length: %zu\n", h->nonceLen);
+    printf("Cipher Length: %zu\n", h->cipherLen);
+    printf("Sample bits: %zu\n", h->sampleBits);
+    printf("Threshold: %zu\n", h->threshold);
+    printf("# of helpers: %zu\n", h->numHelpers);
+    printf("\nHelper data size: %zu\n", h->blockSize + sizeof(ThresholdHelperData));
+}
+
+
+/**********************************************************/
+
+
+void feSampleBits(const unsigned char value[], const uint32_t indices[], size_t const count,
+        unsigned char out[]) {
+    memset(out, 0, (count + 7) / 8);
+    for (size_t j = 0; j < count; j++) {
+        uint32_t b = indices[j];
+        out[j / 8] |= (byte)(((value[b / 8] >> (b % 8)) & 1) << (j % 8));
+    }
+}
+
+static int compareIndex(const void* a, const void* b) {
+    uint32_t x = *(const uint32_t*)a;
+    uint32_t y = *(const uint32_t*)b;
+    return (x > y) - (x < y);
+}
+
+//  Floyd's algorithm: if t was picked before, top cannot have been, so top
+//  is taken instead. The 64 bit words make the modulo bias negligible.
+void feSampleIndices(uint32_t indices[], size_t const count, size_t const bits, const unsigned char random[]) {
+    for (size_t j = 0; j < count; j++) {
+        size_t top = bits - count + j;
+        uint64_t r = 0;
+        for (size_t b = 0; b < 8; b++) {
+            r |= (uint64_t)random[8 * j + b] << (8 * b);
+        }
+        uint32_t t = (uint32_t)(r % (top + 1));
+
+        bool taken = false;
+        for (size_t m = 0; m < j && !taken; m++) {
+            taken = (indices[m] == t);
+        }
+        indices[j] = taken ? (uint32_t)top : t;
+    }
+    qsort(indices, count, sizeof(uint32_t), compareIndex);
+}
+
+static int hashSample(byte digest[], const ThresholdHelperData *const h, const byte sample[],
+        const byte nonce[]) {
+    return lockerHash(&h->locker, digest, h->cipherLen, sample, (h->sampleBits + 7) / 8, nonce);
+}
+
+int feThresholdGenerate(const unsigned char value[], unsigned char key[],
+        const size_t len, ThresholdHelperData *const h, const FEThresholdProperties *const p) {
+    if (!value || !key || !h || !p) {
+        printf("feThresholdGenerate error: nullptr argument.\n");
+        return -1;
+    }
+    if (p->length != len) {
+        printf("feThresholdGenerate error: cannot produce key for value of different length.\n");
+        return -2;
+    }
+    if (!lockerParamsValid(&p->locker)) {
+        printf("feThresholdGenerate error: invalid locker parameters.\n");
+        return -2;
+    }
+    if (p->numHelpers == 0 || p->sampleBits == 0) {
+        printf("feThresholdGenerate error: properties allow no locker to open.\n");
+        return -2;
+    }
+
+    freeThresholdHelperData(h);
+    if (allocateThresholdHelperData(h, p) != 0) return -3;
+
+    byte* random = (byte*)malloc(8 * h->sampleBits);
+    if (!random) {
+        printf("feThresholdGenerate error: malloc failed.\n");
+        freeThresholdHelperData(h);
+        return -3;
+    }
+
+    randombytes_buf(key, len);
+    byte key_padded[p->cipherLen];
+    memcpy(key_padded, key, len);
+    memset(key_padded + len, 0, p->secLen);
+
+    randombytes_buf(h->nonces, h->numHelpers * h->nonceLen);
+
+    int ret = 0;
+    byte sample[(h->sampleBits + 7) / 8];
+    for (size_t i = 0; i < h->numHelpers && ret == 0; i++) {
+        uint32_t* indices = h->indices + i * h->sampleBits;
+        byte* cipher = h->ciphers + i * h->cipherLen;
+
+        randombytes_buf(random, 8 * h->sampleBits);
+        feSampleIndices(indices, h->sampleBits, len * 8, random);
+        feSampleBits(value, indices, h->sampleBits, sample);
+
+        ret = hashSample(cipher, h, sample, h->nonces + i * h->nonceLen);
+        feXor(cipher, cipher, key_padded, h->cipherLen);
+    }
+    sodium_memzero(sample, sizeof(sample));
+    sodium_memzero(key_padded, sizeof(key_padded));
+    free(random);
+
+    if (ret != 0) {
+        printf("feThresholdGenerate error: Ran out of memory during hashing.\n");
+    }
+    return ret;
+}
+
+//  Hashes the sample and checks whether it opens the locker.
+//  returns: 1 if opened (key written), 0 if not, negative int on error
+static int trySample(const ThresholdHelperData *const h, size_t const i, const byte sample[], byte key[]) {
+    byte digest[h->cipherLen];
+    const byte* cipher = h->ciphers + i * h->cipherLen;
+
+    if (hashSample(digest, h, sample, h->nonces + i * h->nonceLen) != 0) return -3;
+
+    if (!feXorIsZero(digest + h->length, cipher + h->length, h->cipherLen - h->length)) return 0;
+
+    feXor(key, digest, cipher, h->length);
+    return 1;
+}
+
+//  Tries all error patterns of weight <= threshold on the sample of locker i.
+//  The patterns are enumerated as combinations of flipped positions in
+//  lexicographic order, flipping the sample in place.
+static int openThresholdLocker(const ThresholdHelperData *const h, size_t const i, byte sample[], byte key[]) {
+    size_t const k = h->sampleBits;
+
+    for (size_t w = 0; w <= h->threshold && w <= k; w++) {
+        size_t pos[w + 1];
+        for (size_t j = 0; j < w; j++) pos[j] = j;
+
+        for (;;) {
+            for (size_t j = 0; j < w; j++) sample[pos[j] / 8] ^= (byte)(1 << (pos[j] % 8));
+            int ret = trySample(h, i, sample, key);
+            for (size_t j = 0; j < w; j++) sample[pos[j] / 8] ^= (byte)(1 << (pos[j] % 8));
+            if (ret != 0) return ret;
+
+            // next combination of w positions out of k
+            size_t j = w;
+            while (j > 0 && pos[j - 1] == k - w + (j - 1)) j--;
+            if (j == 0) break;
+            pos[j - 1]++;
+            for (size_t l = j; l < w; l++) pos[l] = pos[l - 1] + 1;
+        }
+    }
+    return 0;
+}
+
+int feThresholdReproduce(const unsigned char value[], unsigned char key[],
+        const size_t len, const ThresholdHelperData *const h) {
+    if (!value || !key || !h) {
+        printf("feThresholdReproduce error: nullptr argument.\n");
+        return -1;
+    }
+    if (h->length != len) {
+        printf("feThresholdReproduce error: cannot produce key for value of different length.\n");
+        return -2;
+    }
+
+    byte sample[(h->sampleBits + 7) / 8];
+    int ret = 0;
+    for (size_t i = 0; i < h->numHelpers && ret == 0; i++) {
+        feSampleBits(value, h->indices + i * h->sampleBits, h->sampleBits, sample);
+        ret = openThresholdLocker(h, i, sample, key);
+    }
+    sodium_memzero(sample, sizeof(sample));
+
+    if (ret < 0) {
+        printf("feThresholdReproduce error: Ran out of memory during hashing.\n");
+        return ret;
+    }
+    return (ret == 1) ? 0 : -4;
+}
+
+
+/**********************************************************/
+
+
+int initFEContext(FEContext *const ctx, FEConstruction const construction,
+        size_t const length, size_t const hamErr, double const repErr) {
+    if (!ctx) return -1;
+
+    ctx->construction = construction;
+    switch (construction) {
+    case FE_CANETTI:
+        initFEProperties(&ctx->p.canetti, length, hamErr, repErr);
+        initHelperData(&ctx->h.canetti);
+        return 0;
+    case FE_THRESHOLD:
+        initFEThresholdProperties(&ctx->p.threshold, length, hamErr, repErr, 0, 1);
+        initThresholdHelperData(&ctx->h.threshold);
+        return 0;
+    }
+    printf("initFEContext error: unknown construction.\n");
+    return -2;
+}
+
+void freeFEContext(FEContext *const ctx) {
+    if (!ctx) return;
+
+    switch (ctx->construction) {
+    case FE_CANETTI:   freeHelperData(&ctx->h.canetti); break;
+    case FE_THRESHOLD: freeThresholdHelperData(&ctx->h.threshold); break;
+    }
+}
+
+int feContextGenerate(FEContext *const ctx, const unsigned char value[], unsigned char key[],
+        const size_t len) {
+    if (!ctx) return -1;
+
+    switch (ctx->construction) {
+    case FE_CANETTI:
+        return feGenerate(value, key, len, &ctx->h.canetti, &ctx->p.canetti);
+    case FE_THRESHOLD:
+        return feThresholdGenerate(value, key, len, &ctx->h.threshold, &ctx->p.threshold);
+    }
+    return -1;
+}
+
+int feContextReproduce(const FEContext *const ctx, const unsigned char value[], unsigned char key[],
+        const size_t len) {
+    if (!ctx) return -1;
+
+    switch (ctx->construction) {
+    case FE_CANETTI:
+        return feReproduce(value, key, len, &ctx->h.canetti);
+    case FE_THRESHOLD:
+        return feThresholdReproduce(value, key, len, &ctx->h.threshold);
+    }
+    return -1;
+}
@@ -0,0 +1,255 @@
+//########################################################################
+// (C) Embedded Systems Lab
+// All rights reserved.
+// ------------------------------------------------------------
+// This document contains proprietary information belonging to
+// Research & Development FH OÖ Forschungs und Entwicklungs GmbH.
+// Using, passing on and copying of this document or parts of it
+// is generally not permitted without prior written authorization.
+// ------------------------------------------------------------
+// info(at)embedded-lab.at
+// https://www.embedded-lab.at/
+//########################################################################
+// *** File name: ThresholdFuzzyExtractor.h
+// *** Date of file creation: 2022-02-07
+// *** List of autors: Lucas Drack
+// ***
+// *** Threshold variant of the digital locker fuzzy extractor, based on
+// *** Cheon et al. 2018 (A Reusable Fuzzy Extractor with Practical
+// *** Storage Size: Modifying Canetti et al.'s Construction).
+//########################################################################
+
+#ifndef __THRESHOLD_FUZZYEXTRACTOR_H__
+#define __THRESHOLD_FUZZYEXTRACTOR_H__
+
+#include <stdint.h>
+#include "CFuzzyExtractor.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//  In Canetti et al.'s construction a locker only opens if every sampled bit
+//  of the reading matches the enrolled value. Cheon et al. let a locker open
+//  if at most `threshold` of its sampled bits are wrong: on reproduction all
+//  error patterns of weight <= threshold are tried on the sample. Every
+//  locker is much more likely to open, so far fewer lockers (and therefore
+//  far less helper data) are needed, at the cost of more hashes per locker.
+
+
+/*  
+ * Struct: FEThresholdProperties
+ * --------------------
+ *  length:     Length in bytes of source values and keys.
+ *  hamErr:     Hamming error, see FEProperties.
+ *  repErr:     Reproduce error, see FEProperties.
+ *  sampleBits: Number of bit positions of the value sampled into each locker.
+ *  threshold:  Number of wrong sampled bits a locker still tolerates.
+ *  secLen:     Security parameter, see FEProperties. Raised with the number
+ *              of error patterns tried per locker, so the chance of a locker
+ *              opening by accident stays that of a single Canetti locker.
+ *  nonceLen:   Length in bytes of nonce (salt) used in digital locker (16).
+ *  locker:     Hash backend and cost parameters of the lockers (Argon2id).
+ *  patterns:   Number of error patterns tried per locker on reproduction.
+ *  cipherLen:  Length in bytes of hashed ciphers.
+ *  numHelpers: Number of lockers needed to reproduce with (1 - repErr).
+ */
+typedef struct {
+    size_t length;
+    size_t hamErr;
+    double repErr;
+    size_t sampleBits;
+    size_t threshold;
+    size_t secLen;
+    size_t nonceLen;
+    LockerParams locker;
+
+    size_t patterns;
+    size_t cipherLen;
+    size_t numHelpers;
+} FEThresholdProperties;
+
+/*
+ * Function: initFEThresholdProperties
+ * --------------------
+ *   Computes the number of lockers needed so that a reading within hamErr
+ *   reproduces the key with probability (1 - repErr). A single locker opens
+ *   if at most threshold of the hamErr wrong bits fall into its sample
+ *   (hypergeometric distribution).
+ *
+ *   sampleBits: bits per locker. 0 selects half of the value's bits, which
+ *               matches what a random mask keeps in Canetti's construction.
+ *   threshold:  tolerated errors per locker. 0 is Canetti's exact match.
+ */
+void initFEThresholdProperties(FEThresholdProperties *const p, size_t const length, size_t const hamErr,
+        double const repErr, size_t const sampleBits, size_t const threshold);
+
+void printFEThresholdProperties(FEThresholdProperties *const p);
+
+
+/*  
+ * Struct: ThresholdHelperData
+ * --------------------
+ *  Public helper data of the threshold construction. Allocated as one
+ *  block, like HelperData.
+ *
+ *  length, nonceLen, cipherLen, numHelpers: see HelperData
+ *  sampleBits: Bits sampled per locker
+ *  threshold:  Tolerated errors per locker
+ *  locker:     Hash backend and cost parameters of the lockers
+ *  indices:    Sorted bit positions sampled by each locker
+ *  nonces:     Nonces (salts) used during hashing
+ *  ciphers:    Ciphers resulting from the hashing algorithm
+ */
+typedef struct {
+    size_t length;
+    size_t nonceLen;
+    size_t cipherLen;
+    size_t numHelpers;
+    size_t sampleBits;
+    size_t threshold;
+    LockerParams locker;
+
+    uint32_t* indices;          // uint32_t[numHelpers * sampleBits]
+    unsigned char* nonces;      // char[numHelpers * nonceLen]
+    unsigned char* ciphers;     // char[numHelpers * cipherLen]
+
+    void* block;
+    size_t blockSize;
+} ThresholdHelperData;
+
+void initThresholdHelperData(ThresholdHelperData *const h);
+
+void freeThresholdHelperData(ThresholdHelperData *const h);
+
+void printThresholdHelperData(ThresholdHelperData *const h);
+
+/*
+ * Function: feThresholdGenerate
+ * --------------------
+ *   Threshold counterpart of feGenerate(). Samples sampleBits random bit
+ *   positions per locker and locks a random key behind each sample.
+ *
+ *   value: the source value
+ *   key:   the key derived from the source
+ *   len:   length of value and key (bytes)
+ *   h:     Public helper data. The caller MUST call
+ *          freeThresholdHelperData() on h before discarding it.
+ *   p:     Holds the parameters of the fuzzy extractor.
+ *
+ *   returns: 0 on success, negative int otherwise
+ */
+int feThresholdGenerate(const unsigned char value[], unsigned char key[],
+        const size_t len, ThresholdHelperData *const h, const FEThresholdProperties *const p);
+
+/*
+ * Function: feThresholdReproduce
+ * --------------------
+ *   Threshold counterpart of feReproduce(). For every locker, all error
+ *   patterns of weight <= threshold are applied to the sample of value
+ *   until a locker opens.
+ *
+ *   value: the value to reproduce a key for
+ *   key:   the reproduced key
+ *   len:   length of value and key (bytes)
+ *   h:     the previously generated public helper data
+ *
+ *   returns: 0 on success, -4 if no locker opened, other negative int on error
+ */
+int feThresholdReproduce(const unsigned char value[], unsigned char key[],
+        const size_t len, const ThresholdHelperData *const h);
+
+/*
+ * Function: feSampleBits
+ * --------------------
+ *   Gathers the bits of value at the given positions into out, packed
+ *   LSB first. Bit b of value is bit (b % 8) of value[b / 8].
+ *
+ *   out: receives (count + 7) / 8 bytes
+ */
+void feSampleBits(const unsigned char value[], const uint32_t indices[], size_t const count,
+        unsigned char out[]);
+
+/*
+ * Function: feSampleIndices
+ * --------------------
+ *   Picks count distinct bit positions below bits, sorted ascending, so
+ *   that feSampleBits() walks the value front to back. Shared by the
+ *   threshold lockers and sampled Canetti lockers (threshold 0).
+ *
+ *   random: 8 * count random (or seed derived) bytes, all consumed
+ */
+void feSampleIndices(uint32_t indices[], size_t const count, size_t const bits, const unsigned char random[]);
+
+/*
+ * Function: feSampleOpenProbability
+ * --------------------
+ *   Probability that at most threshold of hamErr wrong bits (out of bits)
+ *   fall into a uniformly random sample of sampleBits positions.
+ */
+double feSampleOpenProbability(size_t const bits, size_t const hamErr, size_t const sampleBits,
+        size_t const threshold);
+
+
+/**********************************************************/
+
+
+/*  
+ * Enum: FEConstruction
+ * --------------------
+ *  FE_CANETTI:   Canetti et al. 2016, feGenerate()/feReproduce()
+ *  FE_THRESHOLD: Cheon et al. 2018, feThresholdGenerate()/feThresholdReproduce()
+ */
+typedef enum {
+    FE_CANETTI = 0,
+    FE_THRESHOLD = 1
+} FEConstruction;
+
+/*  
+ * Struct: FEContext
+ * --------------------
+ *  Lets callers choose the construction at runtime. Holds the properties
+ *  and helper data of the selected construction.
+ */
+typedef struct {
+    FEConstruction construction;
+    union {
+        FEProperties canetti;
+        FEThresholdProperties threshold;
+    } p;
+    union {
+        HelperData canetti;
+        ThresholdHelperData threshold;
+    } h;
+} FEContext;
+
+/*
+ * Function: initFEContext
+ * --------------------
+ *   Initializes properties and empty helper data for the given construction.
+ *   The threshold construction uses default sampleBits and a threshold of 1;
+ *   call initFEThresholdProperties() on ctx->p.threshold to change them.
+ *
+ *   returns: 0 on success, negative int otherwise
+ */
+int initFEContext(FEContext *const ctx, FEConstruction const construction,
+        size_t const length, size_t const hamErr, double const repErr);
+
+void freeFEContext(FEContext *const ctx);
+
+/*
+ * Function: feContextGenerate / feContextReproduce
+ * --------------------
+ *   Dispatch to the generate/reproduce function of the selected construction.
+ */
+int feContextGenerate(FEContext *const ctx, const unsigned char value[], unsigned char key[],
+        const size_t len);
+
+int feContextReproduce(const FEContext *const ctx, const unsigned char value[], unsigned char key[],
+        const size_t len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __THRESHOLD_FUZZYEXTRACTOR_H__
@@ -20,11 +20,28 @@
 //########################################################################
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <sodium.h>
 #include <string.h>
 #include <assert.h>
+#include <pthread.h>
+#ifdef __linux__
+#include <poll.h>
+#endif
 
 #include "CFuzzyExtractor.h"
+#include "HelperDataFile.h"
+#include "ThresholdFuzzyExtractor.h"
+#include "FESimd.h"
+#include "FEAsync.h"
+#include "FEOptimizer.h"
+#include "FEReadings.h"
+#include "FEStore.h"
+#include "FEIdentify.h"
+#include "FECalibrate.h"
+#include "FESession.h"
+#include "FEHintCache.h"
+#include "FESimulate.h"
 #include "minunit.h"
 
 //  This project uses minunit for simple unit testing
@@ -94,6 +111,21 @@ static char * testFreeTwiceHelperData() {
     return 0;
 }
 
+static char * testCopyHelperData() {
+    HelperData copy;
+    initHelperData(&copy);
+    freeHelperData(&h);
+    allocateHelperData(&h, 16, 18, 5);
+    mu_assert("Error: copyHelperData failed.", copyHelperData(&copy, &h) == 0);
+    mu_assert("Error in testCopyHelperData.", copy.numHelpers == 5 &&
+                                              copy.block != h.block &&
+                                              memcmp(copy.block, h.block, h.blockSize) == 0 &&
+                                              helperMask(&copy, 4)[15] == helperMask(&h, 4)[15]);
+    freeHelperData(&copy);
+    freeHelperData(&h);
+    return 0;
+}
+
 static char * testInitFEProperties() {
     FEProperties p;
     initFEProperties(&p, 16, 4, 0.001);
@@ -272,18 +304,1349 @@ static char * testReproduceFuzzyHamErr4() {
     return 0;
 }
 
-// Fill 1D array of unsigned char with contents from line
-// Line format is CSV delimited by ;
-int parseRow(unsigned char* dest, char* line) {
-    if (dest == NULL || line == NULL) { return -1; }
+// The parallel reproduction must deliver the same key as the sequential one,
+// both for a noisy reading that opens a locker and for one that doesn't.
+static char * testReproduceParallel() {
+    freeHelperData(&h);
+    FEProperties p;
+    const size_t len = 16;
+    initFEProperties(&p, len, 4, 0.001);
+    unsigned char fingerprint[len];
+    unsigned char noisy[len];
+    unsigned char key[len];
+    unsigned char reproduced[len];
+    unsigned char reproducedParallel[len];
+    int ret;
+
+    randombytes_buf(fingerprint, len);
+    ret = feGenerate(fingerprint, key, len, &h, &p);
+    mu_assert("Error: feGenerate failed.", ret == 0);
+
+    memcpy(noisy, fingerprint, len);
+    noisy[randombytes_uniform(len)] ^= 0x11;
+
+    ret = feReproduce(noisy, reproduced, len, &h);
+    mu_assert("Error: feReproduce failed.", ret == 0);
+    ret = feReproduceParallel(noisy, reproducedParallel, len, &h, 4);
+    mu_assert("Error: feReproduceParallel failed.", ret == 0);
+    mu_assert("Error: feReproduceParallel yielded a different key.",
+                memcmp(reproduced, reproducedParallel, len) == 0);
+
+    randombytes_buf(noisy, len);
+    memset(reproducedParallel, 0, len);
+    ret = feReproduceParallel(noisy, reproducedParallel, len, &h, 4);
+    mu_assert("Error: feReproduceParallel failed.", ret == 0);
+    mu_assert("Error: feReproduceParallel yielded a key for a different value.",
+                memcmp(key, reproducedParallel, len) != 0);
+
+    freeHelperData(&h);
+    return 0;
+}
+
+// Helper data filled by several threads must be usable by the sequential
+// reproduction, just like helper data from feGenerate().
+static char * testGenerateParallel() {
+    freeHelperData(&h);
+    FEProperties p;
+    const size_t len = 16;
+    initFEProperties(&p, len, 4, 0.001);
+    unsigned char fingerprint[len];
+    unsigned char noisy[len];
+    unsigned char key[len];
+    unsigned char reproduced[len];
+    int ret;
+
+    randombytes_buf(fingerprint, len);
+    ret = feGenerateParallel(fingerprint, key, len, &h, &p, 4);
+    mu_assert("Error: feGenerateParallel failed.", ret == 0);
+    mu_assert("Error: feGenerateParallel produced wrong helper count.", h.numHelpers == p.numHelpers);
+
+    ret = feReproduce(fingerprint, reproduced, len, &h);
+    mu_assert("Error: feReproduce failed.", ret == 0);
+    mu_assert("Error: could not reproduce key.", memcmp(key, reproduced, len) == 0);
+
+    memcpy(noisy, fingerprint, len);
+    noisy[randombytes_uniform(len)] ^= 0x11;
+    memset(reproduced, 0, len);
+    ret = feReproduce(noisy, reproduced, len, &h);
+    mu_assert("Error: feReproduce failed.", ret == 0);
+    mu_assert("Error: could not reproduce key from noisy value.", memcmp(key, reproduced, len) == 0);
+
+    freeHelperData(&h);
+    return 0;
+}
+
+// Helper data written to disk must reproduce the key both when mapped
+// read-only and when loaded into memory.
+static char * testSaveMapHelperData() {
+    freeHelperData(&h);
+    FEProperties p;
+    const size_t len = 16;
+    initFEProperties(&p, len, 2, 0.001);
+    const char* fname = "helperdata_test.bin";
+    unsigned char fingerprint[len];
+    unsigned char key[len];
+    unsigned char reproduced[len];
+    HelperData stored;
+    initHelperData(&stored);
+    int ret;
+
+    randombytes_buf(fingerprint, len);
+    ret = feGenerate(fingerprint, key, len, &h, &p);
+    mu_assert("Error: feGenerate failed.", ret == 0);
+    ret = saveHelperData(&h, fname);
+    mu_assert("Error: saveHelperData failed.", ret == 0);
+
+    ret = mapHelperData(&stored, fname, true);
+    mu_assert("Error: mapHelperData failed.", ret == 0);
+    mu_assert("Error: mapped helper data differs.", stored.readOnly &&
+                stored.numHelpers == h.numHelpers &&
+                memcmp(stored.block, h.block, h.blockSize) == 0);
+    memset(reproduced, 0, len);
+    ret = feReproduce(fingerprint, reproduced, len, &stored);
+    mu_assert("Error: could not reproduce key from mapped helper data.",
+                ret == 0 && memcmp(key, reproduced, len) == 0);
+
+    ret = loadHelperData(&stored, fname);
+    mu_assert("Error: loadHelperData failed.", ret == 0 && !stored.readOnly);
+    memset(reproduced, 0, len);
+    ret = feReproduce(fingerprint, reproduced, len, &stored);
+    mu_assert("Error: could not reproduce key from loaded helper data.",
+                ret == 0 && memcmp(key, reproduced, len) == 0);
+
+    freeHelperData(&stored);
+    remove(fname);
+    freeHelperData(&h);
+    return 0;
+}
+
+// Seeded helper data stores only the ciphers, but must behave exactly like
+// regular helper data, also after a round trip through a file.
+static char * testSeededHelperData() {
+    freeHelperData(&h);
+    FEProperties p;
+    const size_t len = 16;
+    initFEProperties(&p, len, 4, 0.001);
+    p.seeded = true;
+    const char* fname = "helperdata_seeded_test.bin";
+    unsigned char fingerprint[len];
+    unsigned char noisy[len];
+    unsigned char key[len];
+    unsigned char reproduced[len];
+    HelperData stored;
+    initHelperData(&stored);
+    int ret;
+
+    randombytes_buf(fingerprint, len);
+    ret = feGenerate(fingerprint, key, len, &h, &p);
+    mu_assert("Error: feGenerate failed.", ret == 0);
+    mu_assert("Error: seeded helper data stores masks or nonces.",
+                h.seeded && h.masks == 0 && h.nonces == 0 &&
+                h.blockSize < p.numHelpers * (len + p.nonceLen));
+
+    memcpy(noisy, fingerprint, len);
+    noisy[randombytes_uniform(len)] ^= 0x11;
+    ret = feReproduce(noisy, reproduced, len, &h);
+    mu_assert("Error: could not reproduce key from seeded helper data.",
+                ret == 0 && memcmp(key, reproduced, len) == 0);
+
+    ret = saveHelperData(&h, fname);
+    mu_assert("Error: saveHelperData failed.", ret == 0);
+    ret = mapHelperData(&stored, fname, true);
+    mu_assert("Error: mapHelperData failed.", ret == 0 && stored.seeded);
+    memset(reproduced, 0, len);
+    ret = feReproduce(noisy, reproduced, len, &stored);
+    mu_assert("Error: could not reproduce key from mapped seeded helper data.",
+                ret == 0 && memcmp(key, reproduced, len) == 0);
+
+    // Damaged dimensions are rejected even without checksum: 2^63 helpers of
+    // 18 byte ciphers wrap the block size to 0.
+    size_t const size = helperDataFileSize(&h);
+    unsigned char* raw = (unsigned char*)malloc(size + 64);
+    void* buf = raw + (64 - (uintptr_t)raw % 64);
+    ret = serializeHelperData(&h, buf, size);
+    HelperDataFileHeader* header = (HelperDataFileHeader*)buf;
+    header->numHelpers = 1ull << 63;
+    mu_assert("Error: wrapping helper count accepted.",
+                ret == 0 && viewHelperData(&stored, buf, size, false) < 0);
+    header->numHelpers = h.numHelpers;
+    header->cipherLen = 1ull << 40;
+    mu_assert("Error: huge cipher length accepted.", viewHelperData(&stored, buf, size, false) < 0);
+    header->cipherLen = h.cipherLen;
+    mu_assert("Error: restored header rejected.", viewHelperData(&stored, buf, size, false) == 0);
+    free(raw);
+
+    freeHelperData(&stored);
+    remove(fname);
+    freeHelperData(&h);
+    return 0;
+}
+
+// The threshold construction needs far fewer lockers than Canetti's for the
+// same error tolerance and must still reproduce the key from a noisy value.
+static char * testThresholdConstruction() {
+    FEContext ctx;
+    const size_t len = 16;
+    unsigned char fingerprint[len];
+    unsigned char noisy[len];
+    unsigned char key[len];
+    unsigned char reproduced[len];
+    int ret;
+
+    ret = initFEContext(&ctx, FE_THRESHOLD, len, 8, 0.001);
+    mu_assert("Error: initFEContext failed.", ret == 0);
+    FEProperties canetti;
+    initFEProperties(&canetti, len, 8, 0.001);
+    mu_assert("Error: threshold construction needs too many lockers.",
+                ctx.p.threshold.numHelpers > 0 &&
+                ctx.p.threshold.numHelpers * 50 < canetti.numHelpers);
+
+    randombytes_buf(fingerprint, len);
+    ret = feContextGenerate(&ctx, fingerprint, key, len);
+    mu_assert("Error: feContextGenerate failed.", ret == 0);
+
+    // Flip 6 bits in different bytes.
+    memcpy(noisy, fingerprint, len);
+    for (size_t i = 0; i < 6; i++) noisy[2 * i] ^= (unsigned char)(1 << i);
+    memset(reproduced, 0, len);
+    ret = feContextReproduce(&ctx, noisy, reproduced, len);
+    mu_assert("Error: could not reproduce key from noisy value.",
+                ret == 0 && memcmp(key, reproduced, len) == 0);
+
+    randombytes_buf(noisy, len);
+    memset(reproduced, 0, len);
+    ret = feContextReproduce(&ctx, noisy, reproduced, len);
+    mu_assert("Error: threshold construction opened for a different value.",
+                ret == -4 && memcmp(key, reproduced, len) != 0);
+
+    freeFEContext(&ctx);
+    return 0;
+}
+
+// Every locker backend must lock and unlock. The PBKDF2 backend must match
+// Python's hashlib.pbkdf2_hmac("sha256", ...), as used by the original
+// implementation.
+static char * testLockerBackends() {
+    const LockerAlgorithm algorithms[] = { LOCKER_ARGON2ID, LOCKER_ARGON2I,
+                                           LOCKER_BLAKE2B, LOCKER_PBKDF2_SHA256 };
+    const unsigned char expected[18] = { 0xef, 0x9d, 0x5f, 0x6a, 0xdd, 0x4a, 0x5d, 0x19, 0xf4,
+                                         0xa7, 0xfc, 0x92, 0xb4, 0x8f, 0x23, 0x51, 0xea, 0x95 };
+    unsigned char digest[18];
+    LockerParams lp;
+    initLockerParams(&lp, LOCKER_PBKDF2_SHA256);
+    lockerHash(&lp, digest, sizeof(digest), (const unsigned char*)"password", 8,
+               (const unsigned char*)"0123456789abcdef");
+    mu_assert("Error: PBKDF2 locker differs from hashlib.", memcmp(digest, expected, 18) == 0);
+
+    freeHelperData(&h);
+    FEProperties p;
+    const size_t len = 16;
+    unsigned char fingerprint[len];
+    unsigned char noisy[len];
+    unsigned char key[len];
+    unsigned char reproduced[len];
+    int ret;
+
+    for (size_t a = 0; a < sizeof(algorithms) / sizeof(algorithms[0]); a++) {
+        initFEProperties(&p, len, 2, 0.001);
+        initLockerParams(&p.locker, algorithms[a]);
+        randombytes_buf(fingerprint, len);
+        ret = feGenerate(fingerprint, key, len, &h, &p);
+        mu_assert("Error: feGenerate failed.", ret == 0 && h.locker.algorithm == algorithms[a]);
+
+        memcpy(noisy, fingerprint, len);
+        noisy[randombytes_uniform(len)] ^= 0x01;
+        memset(reproduced, 0, len);
+        ret = feReproduce(noisy, reproduced, len, &h);
+        mu_assert("Error: could not reproduce key with locker backend.",
+                    ret == 0 && memcmp(key, reproduced, len) == 0);
+    }
+
+    freeHelperData(&h);
+    return 0;
+}
+
+// The batch reproduction must deliver per reading what feReproduce() delivers,
+// including duplicated readings and a reading of a different device.
+static char * testReproduceBatch() {
+    freeHelperData(&h);
+    FEProperties p;
+    const size_t len = 16;
+    const size_t nReadings = 5;
+    initFEProperties(&p, len, 4, 0.001);
+    unsigned char fingerprint[len];
+    unsigned char readings[nReadings][len];
+    unsigned char keys[nReadings][len];
+    int results[nReadings];
+    unsigned char key[len];
+    unsigned char reproduced[len];
+    int ret;
+
+    randombytes_buf(fingerprint, len);
+    ret = feGenerate(fingerprint, key, len, &h, &p);
+    mu_assert("Error: feGenerate failed.", ret == 0);
 
-    unsigned char* _dest = dest;
-    const char* tok;
-    for (tok = strtok(line, ";"); tok && *tok; tok = strtok(NULL, ";\n")) {
-        if (dest == NULL) { return -2; }
-        *_dest++ = (unsigned char)atoi(tok);
+    memcpy(readings[0], fingerprint, len);
+    memcpy(readings[1], fingerprint, len);
+    memcpy(readings[2], fingerprint, len);
+    readings[2][3] ^= 0x21;
+    memcpy(readings[3], readings[2], len);
+    randombytes_buf(readings[4], len);
+    memset(keys, 0, sizeof(keys));
+
+    ret = feReproduceBatch(&readings[0][0], nReadings, &keys[0][0], results, len, &h);
+    mu_assert("Error: feReproduceBatch failed.", ret == 0);
+    for (size_t i = 0; i < 4; i++) {
+        memset(reproduced, 0, len);
+        feReproduce(readings[i], reproduced, len, &h);
+        mu_assert("Error: feReproduceBatch differs from feReproduce.",
+                    results[i] == 0 && memcmp(keys[i], reproduced, len) == 0 &&
+                    memcmp(keys[i], key, len) == 0);
     }
+    mu_assert("Error: feReproduceBatch opened for a different value.",
+                results[4] == -4 && memcmp(keys[4], key, len) != 0);
 
+    freeHelperData(&h);
+    return 0;
+}
+
+// With three unstable bits in the enrollment readings, the first locker of
+// ordered helper data must mask out all of them.
+static char * testGenerateOrdered() {
+    freeHelperData(&h);
+    FEProperties p;
+    const size_t len = 16;
+    const size_t nReadings = 20;
+    initFEProperties(&p, len, 4, 0.001);
+    unsigned char fingerprint[len];
+    unsigned char readings[nReadings][len];
+    unsigned char key[len];
+    unsigned char reproduced[len];
+    int ret;
+
+    randombytes_buf(fingerprint, len);
+    for (size_t i = 0; i < nReadings; i++) {
+        memcpy(readings[i], fingerprint, len);
+        readings[i][1] ^= (unsigned char)(randombytes_uniform(2) << 4);
+        readings[i][7] ^= (unsigned char)(randombytes_uniform(2) << 0);
+        readings[i][9] ^= (unsigned char)(randombytes_uniform(2) << 6);
+    }
+
+    mu_assert("Error: feGenerateOrdered accepted missing arguments.",
+                feGenerateOrdered(&readings[0][0], nReadings, key, len, &h, NULL) == -1 &&
+                feGenerateOrdered(&readings[0][0], nReadings, key, 0, &h, &p) == -1);
+    ret = feGenerateOrdered(&readings[0][0], nReadings, key, len, &h, &p);
+    mu_assert("Error: feGenerateOrdered failed.", ret == 0);
+    mu_assert("Error: first locker is not the most stable one.",
+                (helperMask(&h, 0)[1] & 0x10) == 0 &&
+                (helperMask(&h, 0)[7] & 0x01) == 0 &&
+                (helperMask(&h, 0)[9] & 0x40) == 0);
+
+    ret = feReproduce(readings[nReadings - 1], reproduced, len, &h);
+    mu_assert("Error: could not reproduce key from enrollment reading.",
+                ret == 0 && memcmp(key, reproduced, len) == 0);
+
+    freeHelperData(&h);
+    return 0;
+}
+
+// The vectorized kernels must agree with plain byte loops for every length
+// and alignment, including tails shorter than a vector register.
+static char * testSimdKernels() {
+    unsigned char a[256 + 3];
+    unsigned char b[256 + 3];
+    unsigned char dst[256 + 3];
+    randombytes_buf(a, sizeof(a));
+    randombytes_buf(b, sizeof(b));
+
+    for (size_t off = 0; off < 4; off++) {
+        for (size_t n = 0; n <= 256; n++) {
+            const unsigned char* x = a + off;
+            const unsigned char* y = b + (3 - off);
+            bool ok = true;
+
+            feMaskAnd(dst + off, x, y, n);
+            for (size_t j = 0; j < n; j++) ok &= dst[off + j] == (x[j] & y[j]);
+            feXor(dst + off, x, y, n);
+            for (size_t j = 0; j < n; j++) ok &= dst[off + j] == (x[j] ^ y[j]);
+            mu_assert("Error: SIMD kernel differs from scalar result.", ok);
+
+            mu_assert("Error: feXorIsZero false for equal buffers.", feXorIsZero(x, x, n));
+            if (n > 0) {
+                memcpy(dst, x, n);
+                dst[randombytes_uniform(n)] ^= 0x80;
+                mu_assert("Error: feXorIsZero missed a differing byte.", !feXorIsZero(x, dst, n));
+            }
+        }
+    }
+    return 0;
+}
+
+// Index-subset sampling stores a few bit positions per locker and needs far
+// fewer lockers than random masks. Stored, seeded and mapped helper data
+// must all reproduce the key.
+static char * testSampledHelperData() {
+    freeHelperData(&h);
+    FEProperties p;
+    FEProperties masked;
+    const size_t len = 16;
+    const size_t k = 32;
+    const char* fname = "helperdata_sampled_test.bin";
+    initFESampledProperties(&p, len, 4, 0.001, k);
+    initFEProperties(&masked, len, 4, 0.001);
+    unsigned char fingerprint[len];
+    unsigned char noisy[len];
+    unsigned char other[len];
+    unsigned char key[len];
+    unsigned char keys[2][len];
+    int results[2];
+    HelperData stored;
+    initHelperData(&stored);
+    int ret;
+
+    mu_assert("Error: sampling needs as many lockers as masking.",
+                p.sampleBits == k && p.numHelpers > 0 && p.numHelpers * 10 < masked.numHelpers);
+
+    randombytes_buf(fingerprint, len);
+    memcpy(noisy, fingerprint, len);
+    noisy[3] ^= 0x11;
+    noisy[10] ^= 0x80;
+    randombytes_buf(other, len);
+
+    for (int seeded = 0; seeded < 2; seeded++) {
+        p.seeded = seeded;
+        ret = feGenerate(fingerprint, key, len, &h, &p);
+        mu_assert("Error: feGenerate failed.", ret == 0 && h.sampleBits == k && h.masks == 0);
+        if (!seeded) {
+            bool valid = true;
+            for (size_t i = 0; i < h.numHelpers; i++) {
+                const uint32_t* indices = helperIndices(&h, i);
+                for (size_t j = 0; j < k; j++) {
+                    valid &= indices[j] < len * 8 && (j == 0 || indices[j - 1] < indices[j]);
+                }
+            }
+            mu_assert("Error: sample indices are not distinct and sorted.", valid);
+        }
+
+        ret = saveHelperData(&h, fname);
+        mu_assert("Error: saveHelperData failed.", ret == 0);
+        ret = mapHelperData(&stored, fname, true);
+        mu_assert("Error: mapHelperData failed.", ret == 0 && stored.sampleBits == k);
+
+        unsigned char values[2][len];
+        memcpy(values[0], noisy, len);
+        memcpy(values[1], other, len);
+        ret = feReproduceBatch(&values[0][0], 2, &keys[0][0], results, len, &stored);
+        mu_assert("Error: could not reproduce key from sampled helper data.",
+                    ret == 0 && results[0] == 0 && memcmp(keys[0], key, len) == 0);
+        mu_assert("Error: sampled helper data opened for a different value.", results[1] == -4);
+
+        freeHelperData(&stored);
+        remove(fname);
+    }
+
+    p.seeded = false;
+    ret = feGenerateOrdered(noisy, 1, key, len, &h, &p);
+    mu_assert("Error: feGenerateOrdered failed on sampled helper data.", ret == 0);
+    ret = feReproduce(noisy, keys[0], len, &h);
+    mu_assert("Error: could not reproduce key from ordered sampled helper data.",
+                ret == 0 && memcmp(keys[0], key, len) == 0);
+
+    // With 100 wrong bits, every sample of 32 out of 128 bits hits one.
+    initFESampledProperties(&p, len, 100, 0.001, k);
+    ret = feGenerate(fingerprint, key, len, &h, &p);
+    mu_assert("Error: helper data that cannot open was generated.", p.numHelpers == 0 && ret == -2);
+
+    freeHelperData(&h);
+    return 0;
+}
+
+// feReproduceStats must tell which locker opened and report -4 instead of
+// a silent 0 if none did. With FE_ENABLE_STATS, the histograms must count
+// both reproductions.
+static char * testReproduceStats() {
+    freeHelperData(&h);
+    FEProperties p;
+    const size_t len = 16;
+    initFEProperties(&p, len, 4, 0.001);
+    initLockerParams(&p.locker, LOCKER_BLAKE2B);
+    unsigned char fingerprint[len];
+    unsigned char other[len];
+    unsigned char key[len];
+    unsigned char reproduced[len];
+    FEStats stats;
+    int ret;
+
+    randombytes_buf(fingerprint, len);
+    randombytes_buf(other, len);
+    ret = feGenerate(fingerprint, key, len, &h, &p);
+    mu_assert("Error: feGenerate failed.", ret == 0);
+
+    feStatsReset();
+    ret = feReproduceStats(fingerprint, reproduced, len, &h, &stats);
+    mu_assert("Error: feReproduceStats did not open the first locker.",
+                ret == 0 && stats.openedIndex == 0 && stats.lockersTried == 1 &&
+                memcmp(key, reproduced, len) == 0);
+
+    ret = feReproduceStats(other, reproduced, len, &h, &stats);
+    mu_assert("Error: feReproduceStats opened for a different value.",
+                ret == -4 && stats.openedIndex == -1 && stats.lockersTried == h.numHelpers);
+
+    FEHistogramSummary summary;
+    feStatsSummary(FE_HIST_REPRODUCE, &summary);
+    if (feStatsEnabled()) {
+        mu_assert("Error: reproduce histogram did not count both calls.",
+                    summary.count == 2 && summary.minNs <= summary.p50Ns &&
+                    summary.p50Ns <= summary.maxNs);
+        feStatsSummary(FE_HIST_LOCKER, &summary);
+        mu_assert("Error: locker histogram does not match lockers tried.",
+                    summary.count == 1 + h.numHelpers);
+    }
+    else {
+        mu_assert("Error: disabled statistics recorded values.", summary.count == 0);
+    }
+
+    freeHelperData(&h);
+    return 0;
+}
+
+// Callback of testReproduceAsync: counts completed jobs.
+static void countCompletion(FEReproduceJob* job, void* userData) {
+    (void)job;
+    __atomic_fetch_add((int*)userData, 1, __ATOMIC_SEQ_CST);
+}
+
+// Callback of testReproduceAsync: counts the job and releases its handle.
+static void releaseOnCompletion(FEReproduceJob* job, void* userData) {
+    __atomic_fetch_add((int*)userData, 1, __ATOMIC_SEQ_CST);
+    feReproduceRelease(job);
+}
+
+// Async jobs must deliver the same key as feReproduce(), report exhausted
+// and cancelled jobs, and signal completion by callback and event fd. A
+// released job must not run its callback.
+static char * testReproduceAsync() {
+    freeHelperData(&h);
+    FEProperties p;
+    const size_t len = 16;
+    initFEProperties(&p, len, 4, 0.001);
+    unsigned char fingerprint[len];
+    unsigned char noisy[len];
+    unsigned char other[len];
+    unsigned char key[len];
+    unsigned char reproduced[len];
+    FEExecutor* executor;
+    FEReproduceJob* jobs[3];
+    FEReproduceOptions options;
+    int completed = 0;
+    int ret;
+
+    randombytes_buf(fingerprint, len);
+    randombytes_buf(other, len);
+    memcpy(noisy, fingerprint, len);
+    noisy[5] ^= 0x21;
+    ret = feGenerate(fingerprint, key, len, &h, &p);
+    mu_assert("Error: feGenerate failed.", ret == 0);
+
+    ret = feExecutorCreate(&executor, 2);
+    mu_assert("Error: feExecutorCreate failed.", ret == 0);
+    initFEReproduceOptions(&options);
+    options.callback = countCompletion;
+    options.userData = &completed;
+    options.eventFd = true;
+
+    ret  = feReproduceSubmit(executor, other, len, &h, &options, &jobs[0]);
+    ret |= feReproduceSubmit(executor, noisy, len, &h, &options, &jobs[1]);
+    ret |= feReproduceSubmit(executor, other, len, &h, &options, &jobs[2]);
+    mu_assert("Error: feReproduceSubmit failed.", ret == 0);
+    feReproduceCancel(jobs[0]);
+
+    ret = feReproduceWait(jobs[1], reproduced);
+    mu_assert("Error: async job did not reproduce the key.",
+                ret == 0 && memcmp(key, reproduced, len) == 0);
+    ret = feReproduceWait(jobs[0], 0);
+    mu_assert("Error: cancelled job was not cancelled.", ret == FE_ASYNC_CANCELLED);
+    ret = feReproduceWait(jobs[2], 0);
+    mu_assert("Error: job with a different value did not exhaust the lockers.", ret == -4);
+
+#ifdef __linux__
+    struct pollfd pfd = { feReproduceEventFd(jobs[2]), POLLIN, 0 };
+    mu_assert("Error: event fd of a finished job is not readable.",
+                pfd.fd >= 0 && poll(&pfd, 1, 1000) == 1);
+#endif
+
+    for (int j = 0; j < 3; j++) feReproduceRelease(jobs[j]);
+    feExecutorDestroy(executor);
+    mu_assert("Error: not every job ran its callback.", completed == 3);
+
+    // One worker busy with all lockers of jobs[0]: jobs[1] is still queued
+    // when the caller releases it, so its releasing callback must not run.
+    // jobs[2] is only released by its callback.
+    int releasedByCallback[2] = { 0, 0 };
+    FEReproduceOptions busy;
+    initFEReproduceOptions(&busy);
+    busy.lockersPerSlice = h.numHelpers;
+    ret = feExecutorCreate(&executor, 1);
+    ret |= feReproduceSubmit(executor, other, len, &h, &busy, &jobs[0]);
+    options.callback = releaseOnCompletion;
+    options.eventFd = false;
+    for (int j = 1; j < 3; j++) {
+        options.userData = &releasedByCallback[j - 1];
+        ret |= feReproduceSubmit(executor, other, len, &h, &options, &jobs[j]);
+    }
+    mu_assert("Error: feReproduceSubmit failed.", ret == 0);
+    feReproduceRelease(jobs[1]);
+    feReproduceRelease(jobs[0]);
+    feExecutorDestroy(executor);
+    mu_assert("Error: callback of a released job ran.", releasedByCallback[0] == 0);
+    mu_assert("Error: callback of a held job did not run once.", releasedByCallback[1] == 1);
+
+    freeHelperData(&h);
+    return 0;
+}
+
+// Lockers appended to existing helper data, right away or by the executor,
+// must keep the existing lockers and the key, for masked, seeded and
+// sampled helper data alike.
+static char * testExtendHelperData() {
+    freeHelperData(&h);
+    const size_t len = 16;
+    const size_t numReady = 8;
+    FEProperties p;
+    HelperData before;
+    unsigned char fingerprint[len];
+    unsigned char noisy[len];
+    unsigned char key[len];
+    unsigned char wrongKey[len];
+    unsigned char reproduced[len];
+    FEExecutor* executor;
+    FEReproduceJob* job;
+    int ret;
+
+    initHelperData(&before);
+    randombytes_buf(fingerprint, len);
+    memcpy(noisy, fingerprint, len);
+    noisy[9] ^= 0x04;
+
+    for (int mode = 0; mode < 3; mode++) {
+        if (mode == 2) initFESampledProperties(&p, len, 4, 0.001, 32);
+        else initFEProperties(&p, len, 4, 0.001);
+        initLockerParams(&p.locker, LOCKER_BLAKE2B);
+        p.seeded = (mode == 1);
+        size_t const numHelpers = p.numHelpers;
+        p.numHelpers = numReady;
+
+        ret = feGenerate(fingerprint, key, len, &h, &p);
+        ret |= copyHelperData(&before, &h);
+        mu_assert("Error: feGenerate failed.", ret == 0);
+        memcpy(wrongKey, key, len);
+        wrongKey[0] ^= 1;
+        mu_assert("Error: feExtend accepted a wrong key.",
+                    feExtend(fingerprint, wrongKey, len, &h, numHelpers) == -2 &&
+                    h.numHelpers == numReady);
+        mu_assert("Error: feExtend removed lockers.",
+                    feExtend(fingerprint, key, len, &h, numReady - 1) == -2);
+
+        ret = feExtend(fingerprint, key, len, &h, numHelpers);
+        mu_assert("Error: feExtend failed.", ret == 0 && h.numHelpers == numHelpers);
+        mu_assert("Error: feExtend changed existing lockers.",
+                    memcmp(h.ciphers, before.ciphers, numReady * h.cipherLen) == 0);
+        ret = feReproduce(noisy, reproduced, len, &h);
+        mu_assert("Error: extended helper data yields a different key.",
+                    ret == 0 && memcmp(reproduced, key, len) == 0);
+    }
+
+    // Lazy enrollment: a few lockers now, the rest in the background.
+    initFEProperties(&p, len, 4, 0.001);
+    initLockerParams(&p.locker, LOCKER_BLAKE2B);
+    ret = feExecutorCreate(&executor, 2);
+    mu_assert("Error: feExecutorCreate failed.", ret == 0);
+    ret = feGenerateLazy(executor, fingerprint, key, len, &h, &p, numReady, NULL, &job);
+    mu_assert("Error: feGenerateLazy failed.", ret == 0 && h.numHelpers == numReady);
+    ret = feReproduce(fingerprint, reproduced, len, &h);
+    mu_assert("Error: lazy helper data does not reproduce before filling.",
+                ret == 0 && memcmp(reproduced, key, len) == 0);
+
+    ret = feReproduceWait(job, NULL);
+    ret |= feExtendTake(job, &h);
+    mu_assert("Error: lazy filling failed.", ret == 0 && h.numHelpers == p.numHelpers);
+    mu_assert("Error: fill job handed out its result twice.", feExtendTake(job, &h) == -1);
+    feReproduceRelease(job);
+    ret = feReproduce(noisy, reproduced, len, &h);
+    mu_assert("Error: lazily filled helper data yields a different key.",
+                ret == 0 && memcmp(reproduced, key, len) == 0);
+    feExecutorDestroy(executor);
+
+    freeHelperData(&before);
+    freeHelperData(&h);
+    return 0;
+}
+
+// Draws a reading of reference in which the first unstable bits flip
+// with probability 1/10 each.
+static void noisyReading(const unsigned char reference[], unsigned char reading[],
+        size_t const len, size_t const unstable) {
+    memcpy(reading, reference, len);
+    for (size_t b = 0; b < unstable; b++) {
+        if (randombytes_uniform(10) == 0) reading[b / 8] ^= (unsigned char)(1 << (b % 8));
+    }
+}
+
+// The optimizer must find the unstable bits, need far fewer lockers than
+// the worst case of initFEProperties(), pick the smallest secLen whose
+// accidental opens stay below the target and still reproduce from fresh
+// readings.
+static char * testOptimizeProperties() {
+    freeHelperData(&h);
+    const size_t len = 16;
+    const size_t unstable = 8;
+    const size_t numReadings = 200;
+    unsigned char reference[len];
+    unsigned char readings[numReadings * len];
+    unsigned char reading[len];
+    unsigned char key[len];
+    unsigned char reproduced[len];
+    FEErrorProfile profile;
+    FEOptimizeOptions options;
+    FEProperties p;
+    FEProperties worstCase;
+    FEStats stats;
+    double frr;
+    double far;
+    int ret;
+
+    randombytes_buf(reference, len);
+    for (size_t r = 0; r < numReadings; r++) {
+        noisyReading(reference, readings + r * len, len, unstable);
+    }
+    ret = feEstimateErrorProfile(reference, readings, numReadings, len, &profile);
+    mu_assert("Error: feEstimateErrorProfile failed.", ret == 0);
+    for (size_t b = unstable; b < len * 8; b++) {
+        mu_assert("Error: stable bit has an error rate.", profile.bitErrorRates[b] == 0.0);
+    }
+    mu_assert("Error: implausible error rates.",
+                profile.maxErrorRate > 0.0 && profile.maxErrorRate < 0.3 &&
+                profile.maxHamming <= unstable);
+
+    initFEOptimizeOptions(&options);
+    options.targetFRR = 1e-6;
+    ret = feOptimizeProperties(&profile, 0, &options, &p, &frr, &far);
+    mu_assert("Error: feOptimizeProperties failed.", ret == 0);
+    initFEProperties(&worstCase, len, unstable, options.targetFRR);
+    mu_assert("Error: optimized properties miss the targets.",
+                frr <= options.targetFRR && far <= options.targetFAR &&
+                p.numHelpers > 0 && p.numHelpers < worstCase.numHelpers);
+    mu_assert("Error: fePredictFRR differs from the optimizer.",
+                fePredictFRR(&profile, 0, p.numHelpers, p.secLen, 0.0) == frr &&
+                fePredictFRR(&profile, 0, p.numHelpers - 1, p.secLen, 0.0) > options.targetFRR);
+    mu_assert("Error: the optimizer did not pick the smallest secLen.",
+                p.secLen > 1 &&
+                fePredictFRR(&profile, 0, options.maxHelpers, p.secLen - 1, 0.0) > options.targetFRR);
+
+    initLockerParams(&p.locker, LOCKER_BLAKE2B);
+    ret = feGenerate(reference, key, len, &h, &p);
+    mu_assert("Error: feGenerate failed.", ret == 0);
+    for (int r = 0; r < 100; r++) {
+        noisyReading(reference, reading, len, unstable);
+        ret = feReproduceStats(reading, reproduced, len, &h, &stats);
+        mu_assert("Error: could not reproduce with optimized properties.",
+                    ret == 0 && memcmp(key, reproduced, len) == 0);
+    }
+    freeHelperData(&h);
+
+    options.sampled = true;
+    ret = feOptimizeProperties(&profile, 0, &options, &p, &frr, &far);
+    mu_assert("Error: sampled optimization failed.",
+                ret == 0 && p.sampleBits >= options.minSampleBits &&
+                frr <= options.targetFRR && far <= options.targetFAR);
+
+    options.maxHelpers = 1;
+    ret = feOptimizeProperties(&profile, 0, &options, &p, 0, 0);
+    mu_assert("Error: unreachable targets were not reported.", ret == -5);
+
+    freeErrorProfile(&profile);
+    return 0;
+}
+
+// CSV and binary readings must come out in chunks of the requested size,
+// mapped or streamed through a buffer smaller than a line, and malformed
+// lines must be reported.
+static char * testReadingsLoader() {
+    const char* fnameCSV = "readings_test.csv";
+    const char* fnameBin = "readings_test.bin";
+    const size_t len = 16;
+    const size_t numReadings = 1000;
+    unsigned char* readings = malloc(numReadings * len);
+    FEReadingsOptions options;
+    FEReadingsReader* reader;
+    const unsigned char* chunk;
+    size_t count;
+    int ret;
+
+    mu_assert("Error: malloc failed.", readings != NULL);
+    randombytes_buf(readings, numReadings * len);
+    FILE* csv = fopen(fnameCSV, "w");
+    FILE* bin = fopen(fnameBin, "wb");
+    mu_assert("Error: could not create test files.", csv && bin);
+    for (size_t r = 0; r < numReadings; r++) {
+        // Blank lines, CRLF and a trailing separator must not matter.
+        if (r % 100 == 0) fprintf(csv, "\n");
+        for (size_t j = 0; j < len; j++) {
+            fprintf(csv, (j + 1 < len) ? "%u;" : ((r % 2) ? "%u;\r\n" : "%u\n"), readings[r * len + j]);
+        }
+    }
+    fwrite(readings, len, numReadings, bin);
+    fclose(csv);
+    fclose(bin);
+
+    for (int mode = 0; mode < 4; mode++) {
+        initFEReadingsOptions(&options);
+        options.format = (mode & 1) ? FE_READINGS_BINARY : FE_READINGS_CSV;
+        options.length = (mode & 1) ? len : 0;
+        options.chunkReadings = 64;
+        options.stream = (mode & 2) != 0;
+        options.bufferSize = 7;
+        ret = feReadingsOpen(&reader, (mode & 1) ? fnameBin : fnameCSV, &options);
+        mu_assert("Error: feReadingsOpen failed.", ret == 0);
+
+        size_t total = 0;
+        while ((ret = feReadingsNext(reader, &chunk, &count)) == 1) {
+            mu_assert("Error: chunk too large or past the end.",
+                        count <= 64 && total + count <= numReadings && feReadingsLength(reader) == len);
+            mu_assert("Error: readings differ from the file.",
+                        memcmp(chunk, readings + total * len, count * len) == 0);
+            total += count;
+        }
+        mu_assert("Error: not all readings were read.", ret == 0 && total == numReadings);
+        feReadingsClose(reader);
+    }
+
+    // Malformed lines: a value above 255, then a short line.
+    csv = fopen(fnameCSV, "w");
+    fprintf(csv, "1;2;3\n1;256;3\n");
+    fclose(csv);
+    size_t length = 0;
+    unsigned char* loaded;
+    ret = feReadingsLoad(fnameCSV, FE_READINGS_CSV, &length, &loaded, &count);
+    mu_assert("Error: value above 255 was accepted.", ret == -2);
+    csv = fopen(fnameCSV, "w");
+    fprintf(csv, "1;2;3\n1;2\n");
+    fclose(csv);
+    ret = feReadingsLoad(fnameCSV, FE_READINGS_CSV, &length, &loaded, &count);
+    mu_assert("Error: short line was accepted.", ret == -2);
+
+    remove(fnameCSV);
+    remove(fnameBin);
+    free(readings);
+    return 0;
+}
+
+#ifndef _WIN32
+// Value of enrolled device id in testEnrollmentStore.
+static void deviceValue(uint64_t const id, unsigned char value[16]) {
+    crypto_generichash(value, 16, (const unsigned char*)&id, sizeof(id), NULL, 0);
+}
+
+typedef struct {
+    FEStore* store;
+    uint64_t numIds;
+    int failures;
+    int stop;
+} StoreReader;
+
+// Reader thread of testEnrollmentStore: looks up enrolled devices while
+// the writer adds, deletes and compacts.
+static void* readStore(void* arg) {
+    StoreReader* r = (StoreReader*)arg;
+    HelperData view;
+    initHelperData(&view);
+    for (uint64_t n = 0; !__atomic_load_n(&r->stop, __ATOMIC_ACQUIRE) || n < r->numIds; n++) {
+        uint64_t id = 3 + n % r->numIds;    // devices 0-2 are replaced or deleted
+        if (feStoreGet(r->store, id, &view, false) != 0 || view.length != 16) r->failures++;
+    }
+    freeHelperData(&view);
+    return NULL;
+}
+
+// Devices must be found by ID across reopening, index rebuilds and
+// compaction, with concurrent lock-free readers and a single writer.
+static char * testEnrollmentStore() {
+    freeHelperData(&h);
+    const char* fname = "store_test.fes";
+    const char* fnameIndex = "store_test.fes.idx";
+    const size_t len = 16;
+    const uint64_t numIds = 1500;
+    FEProperties p;
+    FEStore* store;
+    FEStore* other;
+    HelperData view;
+    HelperData before;
+    unsigned char value[len];
+    unsigned char key[len];
+    unsigned char keys[2][len];
+    unsigned char reproduced[len];
+    int ret;
+
+    remove(fname);
+    remove(fnameIndex);
+    initFEProperties(&p, len, 1, 0.5);
+    initLockerParams(&p.locker, LOCKER_BLAKE2B);
+    initHelperData(&view);
+    initHelperData(&before);
+
+    ret = feStoreOpen(&store, fname, true);
+    mu_assert("Error: feStoreOpen failed.", ret == 0);
+    ret = feStoreOpen(&other, fname, true);
+    mu_assert("Error: second writer was not refused.", ret == -5);
+
+    // More devices than the initial index holds at half load.
+    for (uint64_t id = 0; id < numIds; id++) {
+        deviceValue(id, value);
+        ret = feGenerate(value, key, len, &h, &p);
+        if (id < 2) memcpy(keys[id], key, len);
+        ret |= feStorePut(store, id, &h);
+        mu_assert("Error: feStorePut failed.", ret == 0);
+    }
+    mu_assert("Error: wrong device count.", feStoreCount(store) == numIds && feStoreGarbage(store) == 0);
+
+    ret = feStoreGet(store, 1, &view, true);
+    deviceValue(1, value);
+    ret |= feReproduce(value, reproduced, len, &view);
+    mu_assert("Error: could not reproduce from stored helper data.",
+                ret == 0 && view.readOnly && memcmp(reproduced, keys[1], len) == 0);
+    mu_assert("Error: found a device that was never enrolled.",
+                feStoreGet(store, numIds + 7, &view, false) == FE_STORE_NOT_FOUND);
+
+    // Re-enroll device 0, delete device 2.
+    deviceValue(0, value);
+    ret = feGenerate(value, keys[0], len, &h, &p);
+    ret |= feStorePut(store, 0, &h);
+    ret |= feStoreDelete(store, 2);
+    mu_assert("Error: re-enroll or delete failed.", ret == 0);
+    mu_assert("Error: deleted device still found.",
+                feStoreGet(store, 2, &view, false) == FE_STORE_NOT_FOUND &&
+                feStoreDelete(store, 2) == FE_STORE_NOT_FOUND);
+    mu_assert("Error: replaced and deleted records are not garbage.",
+                feStoreCount(store) == numIds - 1 && feStoreGarbage(store) > 0);
+
+    // Readers in another handle and another thread.
+    ret = feStoreOpen(&other, fname, false);
+    mu_assert("Error: read-only open failed.", ret == 0 && feStoreCount(other) == numIds - 1);
+    feStoreClose(other);
+
+    StoreReader reader = { store, 1000, 0, 0 };
+    pthread_t thread;
+    pthread_create(&thread, NULL, readStore, &reader);
+    ret = feStoreGet(store, 0, &before, false);
+    for (uint64_t id = numIds; id < numIds + 500; id++) {
+        ret |= feStorePut(store, id, &h);
+    }
+    ret |= feStoreCompact(store);
+    __atomic_store_n(&reader.stop, 1, __ATOMIC_RELEASE);
+    pthread_join(thread, NULL);
+    mu_assert("Error: writing or compaction failed.", ret == 0);
+    mu_assert("Error: a reader missed an enrolled device.", reader.failures == 0);
+    mu_assert("Error: compaction left garbage or lost devices.",
+                feStoreGarbage(store) == 0 && feStoreCount(store) == numIds + 499);
+
+    // Views from before compaction stay valid until released.
+    deviceValue(0, value);
+    ret = feReproduce(value, reproduced, len, &before);
+    mu_assert("Error: view from before compaction is broken.",
+                ret == 0 && memcmp(reproduced, keys[0], len) == 0);
+    freeHelperData(&before);
+    mu_assert("Error: superseded mappings were not released.",
+                feStoreRelease(store) > 0 && feStoreRelease(store) == 0);
+    ret = feStoreGet(store, 0, &view, true);
+    ret |= feReproduce(value, reproduced, len, &view);
+    mu_assert("Error: device lost after releasing old mappings.",
+                ret == 0 && memcmp(reproduced, keys[0], len) == 0);
+    freeHelperData(&view);
+    feStoreClose(store);
+
+    // Reopen with the index, then without it.
+    for (int rebuild = 0; rebuild < 2; rebuild++) {
+        if (rebuild) remove(fnameIndex);
+        ret = feStoreOpen(&store, fname, true);
+        mu_assert("Error: reopening the store failed.", ret == 0);
+        ret = feStoreGet(store, 0, &view, true);
+        ret |= feReproduce(value, reproduced, len, &view);
+        mu_assert("Error: device lost after reopening.",
+                    ret == 0 && memcmp(reproduced, keys[0], len) == 0 &&
+                    feStoreCount(store) == numIds + 499 &&
+                    feStoreGet(store, 2, &view, false) == FE_STORE_NOT_FOUND);
+        freeHelperData(&view);
+        feStoreClose(store);
+    }
+
+    uint64_t ids[4];
+    ret = feStoreOpen(&store, fname, false);
+    mu_assert("Error: feStoreList failed.", ret == 0 && feStoreList(store, ids, 4) == 4);
+    feStoreClose(store);
+
+    remove(fname);
+    remove(fnameIndex);
+    freeHelperData(&h);
+    return 0;
+}
+#endif
+
+// A noisy reading must be attributed to the device it came from, trying
+// far fewer lockers than reproducing against every device in turn.
+static char * testIdentify() {
+    const size_t len = 16;
+    const size_t numCandidates = 40;
+    const size_t device = 29;
+    FEProperties p;
+    FEIdentifyOptions options;
+    HelperData helpers[numCandidates];
+    const HelperData* candidates[numCandidates];
+    double weights[numCandidates];
+    unsigned char values[numCandidates][len];
+    unsigned char keys[numCandidates][len];
+    unsigned char noisy[len];
+    unsigned char key[len];
+    size_t match;
+    size_t tried;
+    int ret;
+
+    // 40 candidates with hundreds of lockers each would falsely match a
+    // random value quite often at the default security length.
+    initFEProperties(&p, len, 4, 0.001);
+    initLockerParams(&p.locker, LOCKER_BLAKE2B);
+    ret = feSetSecLen(&p, 6);
+    mu_assert("Error: feSetSecLen failed.", ret == 0 && p.cipherLen == len + 6 &&
+                                            feSetSecLen(&p, FE_MAX_SEC_LEN + 1) == -2);
+    for (size_t c = 0; c < numCandidates; c++) {
+        initHelperData(&helpers[c]);
+        randombytes_buf(values[c], len);
+        ret = feGenerate(values[c], keys[c], len, &helpers[c], &p);
+        mu_assert("Error: feGenerate failed.", ret == 0);
+        candidates[c] = &helpers[c];
+    }
+    size_t const sequential = device * helpers[0].numHelpers;
+
+    memcpy(noisy, values[device], len);
+    noisy[3] ^= 0x01;
+    initFEIdentifyOptions(&options);
+    options.numThreads = 4;
+    ret = feIdentify(noisy, len, candidates, numCandidates, &options, key, &match, &tried);
+    mu_assert("Error: feIdentify did not find the device.",
+                ret == 0 && match == device && memcmp(key, keys[device], len) == 0);
+    mu_assert("Error: feIdentify tried too many lockers.", tried < sequential / 4);
+
+    // A likely device goes first.
+    for (size_t c = 0; c < numCandidates; c++) weights[c] = (c == device) ? 1.0 : 0.0;
+    options.weights = weights;
+    options.numThreads = 1;
+    ret = feIdentify(noisy, len, candidates, numCandidates, &options, key, &match, &tried);
+    mu_assert("Error: weighted feIdentify did not find the device.",
+                ret == 0 && match == device && tried < 2 * numCandidates);
+
+    randombytes_buf(noisy, len);
+    options.weights = NULL;
+    options.numThreads = 0;
+    ret = feIdentify(noisy, len, candidates, numCandidates, &options, key, &match, &tried);
+    mu_assert("Error: feIdentify matched an unknown value.", ret == -4);
+
+    // Candidates that would match a random value too often are refused.
+    options.maxFalseMatches = 1e-12;
+    ret = feIdentify(noisy, len, candidates, numCandidates, &options, key, &match, &tried);
+    mu_assert("Error: feIdentify accepted candidates with too little padding.", ret == -2);
+
+#ifndef _WIN32
+    const char* fname = "identify_test.fes";
+    FEStore* store;
+    uint64_t deviceId = 0;
+    remove(fname);
+    ret = feStoreOpen(&store, fname, true);
+    for (size_t c = 0; c < numCandidates; c++) {
+        ret |= feStorePut(store, 1000 + c, &helpers[c]);
+    }
+    mu_assert("Error: enrolling the candidates failed.", ret == 0);
+    memcpy(noisy, values[device], len);
+    noisy[7] ^= 0x10;
+    ret = feIdentifyStore(noisy, len, store, NULL, key, &deviceId, NULL);
+    mu_assert("Error: feIdentifyStore did not find the device.",
+                ret == 0 && deviceId == 1000 + device && memcmp(key, keys[device], len) == 0);
+    feStoreClose(store);
+    remove(fname);
+    remove("identify_test.fes.idx");
+#endif
+
+    for (size_t c = 0; c < numCandidates; c++) freeHelperData(&helpers[c]);
+
+    // Two candidates with default options and properties already match a
+    // random value too often; at the secLen feIdentify asks for they work.
+    initFEProperties(&p, len, 6, 0.001);
+    initLockerParams(&p.locker, LOCKER_BLAKE2B);
+    for (size_t secLen = p.secLen; secLen <= 3; secLen++) {
+        mu_assert("Error: feSetSecLen failed.", feSetSecLen(&p, secLen) == 0);
+        for (size_t c = 0; c < 2; c++) {
+            initHelperData(&helpers[c]);
+            ret = feGenerate(values[c], keys[c], len, &helpers[c], &p);
+            mu_assert("Error: feGenerate failed.", ret == 0);
+        }
+        memcpy(noisy, values[1], len);
+        noisy[0] ^= 0x04;
+        ret = feIdentify(noisy, len, candidates, 2, NULL, key, &match, &tried);
+        for (size_t c = 0; c < 2; c++) freeHelperData(&helpers[c]);
+        if (secLen < 3) {
+            mu_assert("Error: feIdentify accepted default candidates.", ret == -2);
+        }
+        else {
+            mu_assert("Error: feIdentify failed at the secLen it asked for.",
+                        ret == 0 && match == 1 && memcmp(key, keys[1], len) == 0);
+        }
+    }
+    return 0;
+}
+
+// Calibrated lockers must fit the requested number of lockers into the
+// budget by the calibration's own measurements and travel with the helper
+// data. Wall-clock checks are left to fuzzy_bench.
+static char * testCalibrate() {
+    freeHelperData(&h);
+    const size_t len = 16;
+    FEProperties p;
+    FECalibrateOptions options;
+    FECalibration result;
+    unsigned char fingerprint[len];
+    unsigned char key[len];
+    unsigned char reproduced[len];
+    int ret;
+
+    initFEProperties(&p, len, 2, 0.001);
+    p.numHelpers = 40;
+    initFECalibrateOptions(&options);
+    options.budgetMs = 100.0;
+    options.numThreads = 2;
+    ret = feCalibrate(&p, &options, &result);
+    mu_assert("Error: feCalibrate failed.", ret == 0 && lockerParamsValid(&p.locker) &&
+                p.locker.algorithm == options.algorithm);
+    mu_assert("Error: calibration predicts more than the budget.",
+                result.lockerMs > 0.0 && result.worstCaseMs <= options.budgetMs &&
+                result.maxHelpers >= p.numHelpers);
+    mu_assert("Error: calibration results are inconsistent.",
+                fabs(result.worstCaseMs - result.lockerMs * p.numHelpers) <= 1e-6 * result.worstCaseMs);
+
+    // The parameters travel with the helper data.
+    randombytes_buf(fingerprint, len);
+    ret = feGenerate(fingerprint, key, len, &h, &p);
+    mu_assert("Error: feGenerate failed.", ret == 0 && h.locker.algorithm == p.locker.algorithm &&
+                h.locker.memlimit == p.locker.memlimit && h.locker.opslimit == p.locker.opslimit);
+    ret = feReproduce(fingerprint, reproduced, len, &h);
+    mu_assert("Error: calibrated lockers do not reproduce.", ret == 0 && memcmp(key, reproduced, len) == 0);
+
+    p.numHelpers = (size_t)1 << 40;
+    ret = feCalibrate(&p, &options, &result);
+    mu_assert("Error: an unreachable budget was not reported.",
+                ret == -5 && result.maxHelpers < p.numHelpers);
+
+    freeHelperData(&h);
+    return 0;
+}
+
+// Subkeys from a session must equal those derived from the enrollment key
+// and differ per label, id and length; expired sessions derive nothing.
+static char * testSessionSubkeys() {
+    freeHelperData(&h);
+    const size_t len = 16;
+    FEProperties p;
+    FESession* session;
+    unsigned char fingerprint[len];
+    unsigned char noisy[len];
+    unsigned char key[len];
+    unsigned char expected[32];
+    unsigned char subkeys[4][32];
+    int ret;
+
+    initFEProperties(&p, len, 4, 0.001);
+    initLockerParams(&p.locker, LOCKER_BLAKE2B);
+    randombytes_buf(fingerprint, len);
+    memcpy(noisy, fingerprint, len);
+    noisy[2] ^= 0x40;
+    ret = feGenerate(fingerprint, key, len, &h, &p);
+    mu_assert("Error: feGenerate failed.", ret == 0);
+
+    ret = feSessionOpen(&session, noisy, len, &h, 0);
+    mu_assert("Error: feSessionOpen failed.", ret == 0);
+    ret  = feSessionDerive(session, "encryption", 0, subkeys[0], 32);
+    ret |= feSessionDerive(session, "mac", 0, subkeys[1], 32);
+    ret |= feSessionDerive(session, "encryption", 1, subkeys[2], 32);
+    ret |= feSessionDerive(session, "encryption", 0, subkeys[3], 16);
+    mu_assert("Error: feSessionDerive failed.", ret == 0);
+    ret = feDeriveSubkey(key, len, "encryption", 0, expected, 32);
+    mu_assert("Error: session subkey differs from the enrollment subkey.",
+                ret == 0 && memcmp(expected, subkeys[0], 32) == 0);
+    mu_assert("Error: subkeys with different label, id or length are equal.",
+                memcmp(subkeys[0], subkeys[1], 32) != 0 && memcmp(subkeys[0], subkeys[2], 32) != 0 &&
+                memcmp(subkeys[0], subkeys[3], 16) != 0);
+    mu_assert("Error: an invalid subkey length was accepted.",
+                feSessionDerive(session, "mac", 0, expected, 8) == -2);
+    feSessionExpire(session);
+    mu_assert("Error: an expired session derived a subkey.",
+                feSessionDerive(session, "mac", 0, expected, 32) == FE_SESSION_EXPIRED);
+    feSessionClose(session);
+
+    ret = feSessionFromKey(&session, key, len, 1e-9);
+    mu_assert("Error: feSessionFromKey failed.", ret == 0);
+    mu_assert("Error: a session outlived its lifetime.",
+                feSessionDerive(session, "mac", 0, expected, 32) == FE_SESSION_EXPIRED);
+    feSessionClose(session);
+
+    randombytes_buf(noisy, len);
+    ret = feSessionOpen(&session, noisy, len, &h, 0);
+    mu_assert("Error: a session was opened with a different value.", ret == -4 && !session);
+
+    freeHelperData(&h);
+    return 0;
+}
+
+// Repeat reproductions of the same reading must open the cached locker
+// first; the cache keeps the most recent lockers and devices.
+static char * testHintCache() {
+    freeHelperData(&h);
+    const size_t len = 16;
+    FEProperties p;
+    FEHintCache* cache;
+    FEStats stats;
+    unsigned char fingerprint[len];
+    unsigned char noisy[len];
+    unsigned char key[len];
+    unsigned char reproduced[len];
+    size_t hints[4];
+    int ret;
+
+    initFEProperties(&p, len, 4, 0.001);
+    initLockerParams(&p.locker, LOCKER_BLAKE2B);
+    // The random reading below must try every locker without opening one.
+    ret = feSetSecLen(&p, 6);
+    randombytes_buf(fingerprint, len);
+    memcpy(noisy, fingerprint, len);
+    noisy[0] ^= 0x81;
+    noisy[11] ^= 0x10;
+    ret |= feGenerate(fingerprint, key, len, &h, &p);
+    ret |= feHintCacheCreate(&cache, 2, 0);
+    mu_assert("Error: setup failed.", ret == 0);
+
+    ret = feReproduceCached(cache, 7, noisy, reproduced, len, &h, &stats);
+    mu_assert("Error: feReproduceCached failed.", ret == 0 && memcmp(key, reproduced, len) == 0);
+    size_t const opened = (size_t)stats.openedIndex;
+    mu_assert("Error: first reproduction did not try lockers in order.", stats.lockersTried == opened + 1);
+    memset(reproduced, 0, len);
+    ret = feReproduceCached(cache, 7, noisy, reproduced, len, &h, &stats);
+    mu_assert("Error: cached locker was not tried first.",
+                ret == 0 && stats.lockersTried == 1 && memcmp(key, reproduced, len) == 0);
+
+    // Out of range and repeated hints are skipped, wrong hints only cost time.
+    size_t given[3] = { h.numHelpers + 5, opened, opened };
+    ret = feReproduceHinted(noisy, reproduced, len, &h, given, 3, &stats);
+    mu_assert("Error: valid hint was not tried first.",
+                ret == 0 && stats.lockersTried == 1 && stats.openedIndex == (int64_t)opened);
+    given[0] = opened + 1;
+    ret = feReproduceHinted(noisy, reproduced, len, &h, given, 1, &stats);
+    mu_assert("Error: wrong hint broke reproduction.",
+                ret == 0 && memcmp(key, reproduced, len) == 0 && stats.lockersTried <= opened + 2);
+    randombytes_buf(noisy, len);
+    ret = feReproduceHinted(noisy, reproduced, len, &h, given, 1, &stats);
+    mu_assert("Error: hinted reproduction did not try every locker once.",
+                ret == -4 && stats.lockersTried == h.numHelpers);
+
+    // Most recent lockers first, least recently used device evicted.
+    feHintCachePut(cache, 1, 5);
+    feHintCachePut(cache, 1, 7);
+    feHintCachePut(cache, 1, 5);
+    mu_assert("Error: hints are not most recent first.",
+                feHintCacheGet(cache, 1, hints, 4) == 2 && hints[0] == 5 && hints[1] == 7);
+    feHintCachePut(cache, 2, 3);
+    mu_assert("Error: least recently used device was kept.",
+                feHintCacheGet(cache, 7, hints, 4) == 0 && feHintCacheGet(cache, 1, hints, 4) == 2);
+    feHintCachePut(cache, 3, 9);
+    mu_assert("Error: wrong device evicted.",
+                feHintCacheGet(cache, 2, hints, 4) == 0 && feHintCacheGet(cache, 1, hints, 4) == 2 &&
+                feHintCacheGet(cache, 3, hints, 4) == 1 && hints[0] == 9);
+    feHintCacheForget(cache, 1);
+    mu_assert("Error: forgotten device still has hints.", feHintCacheGet(cache, 1, hints, 4) == 0);
+
+    feHintCacheDestroy(cache);
+    freeHelperData(&h);
+    return 0;
+}
+
+// Simulated FRR, FAR and lockers tried must match the analytic model of the
+// properties, be reproducible from a seed and agree with real lockers.
+static char * testSimulate() {
+    const size_t len = 16;
+    FEProperties p;
+    FENoiseModel noise;
+    FESimulateOptions o;
+    FESimulation a, b;
+    int ret;
+
+    // Hamming distance 4 against random masks: a locker opens with 1/16.
+    initFEProperties(&p, len, 4, 0.001);
+    initFENoiseModel(&noise, FE_NOISE_HAMMING);
+    noise.hamming = 4;
+    initFESimulateOptions(&o);
+    o.hash = FE_SIM_COMPARE;
+    o.trials = 2000;
+    o.seed = 42;
+    ret = feSimulate(&p, &noise, &o, &a);
+    mu_assert("Error: feSimulate failed.", ret == 0 && a.genuine == 20000 && a.impostor == 20000);
+    mu_assert("Error: simulated rates are off.",
+                a.falseRejects == 0 && a.falseAccepts == 0 && a.frrHigh > 0.0 && a.frrHigh < 0.001);
+    mu_assert("Error: simulated lockers tried are off.",
+                a.meanLockersTried > 14.0 && a.meanLockersTried < 18.0 &&
+                a.p50LockersTried <= a.p90LockersTried && a.p90LockersTried <= a.p99LockersTried);
+
+    // Same seed, same result, whatever the number of threads.
+    o.numThreads = 1;
+    ret = feSimulate(&p, &noise, &o, &b);
+    mu_assert("Error: simulation depends on the number of threads.", ret == 0 &&
+                memcmp(a.lockersTried, b.lockersTried, (p.numHelpers + 1) * sizeof(uint64_t)) == 0);
+    freeFESimulation(&a);
+    freeFESimulation(&b);
+
+    // Sampled lockers are sized for repErr.
+    initFESampledProperties(&p, len, 8, 0.01, 16);
+    o.numThreads = 0;
+    ret = feSimulate(&p, &noise, &o, &a);
+    noise.hamming = 8;
+    ret |= feSimulate(&p, &noise, &o, &b);
+    mu_assert("Error: sampled FRR exceeds repErr.", ret == 0 && a.frr < b.frr && b.frrLow <= 0.01);
+    freeFESimulation(&a);
+    freeFESimulation(&b);
+
+    // More temperature drift, more rejections.
+    initFEProperties(&p, len, 4, 0.001);
+    initFENoiseModel(&noise, FE_NOISE_DRIFT);
+    noise.driftPerKelvin = 0.001;
+    noise.deltaKelvin = 10.0;
+    ret = feSimulate(&p, &noise, &o, &a);
+    noise.deltaKelvin = -100.0;
+    ret |= feSimulate(&p, &noise, &o, &b);
+    mu_assert("Error: drift did not raise FRR.", ret == 0 && a.frr < b.frr && b.frrLow > 0.5);
+    freeFESimulation(&a);
+    freeFESimulation(&b);
+
+    // The real generate/reproduce path agrees. Impostor readings must not
+    // open a locker by chance, so the padding is raised.
+    feSetSecLen(&p, 6);
+    initFENoiseModel(&noise, FE_NOISE_HAMMING);
+    noise.hamming = 4;
+    o.hash = FE_SIM_BLAKE2B;
+    o.trials = 16;
+    o.readingsPerTrial = 4;
+    o.impostorsPerTrial = 2;
+    ret = feSimulate(&p, &noise, &o, &a);
+    mu_assert("Error: hashed simulation is off.", ret == 0 && a.genuine == 64 && a.falseRejects == 0 &&
+                a.falseAccepts == 0 && a.falseOpens == 0);
+    freeFESimulation(&a);
+
+    initFENoiseModel(&noise, FE_NOISE_PROFILE);
+    ret = feSimulate(&p, &noise, &o, &a);
+    mu_assert("Error: profile noise without profile accepted.", ret == -2);
     return 0;
 }
 
@@ -297,32 +1660,35 @@ int printRow(unsigned char* row, const size_t len) {
     return 0; 
 }
 
+// Reads nReadings latent fingerprints and the known fingerprint, all of
+// len bytes. Extra readings in the file are ignored.
 int readFingerprintsFromCSV(const char* fnameLatent, const char* fnameKnown,
                             const size_t len, const size_t nReadings,
                             unsigned char knownFP[len], unsigned char latentFP[nReadings][len])
 {
-        FILE* stream = fopen(fnameLatent, "r");
-        if (!stream) { return -1; }
-
-        int i = 0;
-        int ret = 0;
-        char line[1024];
-        while (fgets(line, 1024, stream))
-        {
-            // printf("%s", line);
-            ret = parseRow(latentFP[i++], line);
-            // printRow(latentFP[i++], len);
-            if (ret != 0) { return -2; }
-        }
-        fclose(stream);
-
-        stream = fopen(fnameKnown, "r");
-        if (!stream) { return -3; }
-
-        fgets(line, 1024, stream);
-        ret = parseRow(knownFP, line);
-        if (ret != 0) { return -4; }
+    size_t length = len;
+    size_t count = 0;
+    unsigned char* readings = NULL;
+
+    int ret = feReadingsLoad(fnameLatent, FE_READINGS_CSV, &length, &readings, &count);
+    if (ret != 0) { return -1; }
+    if (count < nReadings) {
+        free(readings);
+        return -2;
+    }
+    memcpy(latentFP, readings, nReadings * len);
+    free(readings);
+
+    ret = feReadingsLoad(fnameKnown, FE_READINGS_CSV, &length, &readings, &count);
+    if (ret != 0) { return -3; }
+    if (count < 1) {
+        free(readings);
+        return -4;
     }
+    memcpy(knownFP, readings, len);
+    free(readings);
+    return 0;
+}
 
 
 static char * GenerateT25ReproduceT25_HE4() {
@@ -554,6 +1920,7 @@ static char * all_tests() {
     // mu_run_test(testAllocateHelperData);
     // mu_run_test(testFreeUnallocatedHelperData);
     // mu_run_test(testFreeTwiceHelperData);
+    mu_run_test(testCopyHelperData);
     // mu_run_test(testInitFEProperties);
 
     // Test fuzzy extractor
@@ -561,6 +1928,29 @@ static char * all_tests() {
     // mu_run_test(testReproduceBad);
     // mu_run_test(testReproduceFailsOnDifferentValue);
     // mu_run_test(testReproduceFuzzyHamErr4);
+    mu_run_test(testReproduceParallel);
+    mu_run_test(testGenerateParallel);
+    mu_run_test(testSaveMapHelperData);
+    mu_run_test(testSeededHelperData);
+    mu_run_test(testThresholdConstruction);
+    mu_run_test(testLockerBackends);
+    mu_run_test(testReproduceBatch);
+    mu_run_test(testGenerateOrdered);
+    mu_run_test(testSimdKernels);
+    mu_run_test(testSampledHelperData);
+    mu_run_test(testReproduceStats);
+    mu_run_test(testReproduceAsync);
+    mu_run_test(testExtendHelperData);
+    mu_run_test(testOptimizeProperties);
+    mu_run_test(testReadingsLoader);
+#ifndef _WIN32
+    mu_run_test(testEnrollmentStore);
+#endif
+    mu_run_test(testIdentify);
+    mu_run_test(testCalibrate);
+    mu_run_test(testSessionSubkeys);
+    mu_run_test(testHintCache);
+    mu_run_test(testSimulate);
 
 
     mu_run_test(GenerateT25ReproduceT25_HE4);
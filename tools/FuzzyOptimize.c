@@ -0,0 +1,175 @@
+//########################################################################
+// (C) Embedded Systems Lab
+// All rights reserved.
+// ------------------------------------------------------------
+// This document contains proprietary information belonging to
+// Research & Development FH OÖ Forschungs und Entwicklungs GmbH.
+// Using, passing on and copying of this document or parts of it
+// is generally not permitted without prior written authorization.
+// ------------------------------------------------------------
+// info(at)embedded-lab.at
+// https://www.embedded-lab.at/
+//########################################################################
+// *** File name: FuzzyOptimize.c
+// *** Date of file creation: 2022-02-07
+// *** List of autors: Lucas Drack
+// ***
+// *** Picks FEProperties for a fingerprint source from measured readings.
+//########################################################################
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sodium.h>
+
+#include "CFuzzyExtractor.h"
+#include "FEOptimizer.h"
+#include "FECalibrate.h"
+#include "FEReadings.h"
+
+//  Usage: fuzzy_optimize --readings path [options]
+//
+//    --readings path         readings of the enrolled device, one per line
+//    --known path            enrolled value (default: per-bit majority of
+//                            the readings)
+//    --impostor path         readings of other devices (default: random bits)
+//    --frr 0.001             target false rejection rate
+//    --far 1e-6              target rate of other devices opening a locker
+//    --min-error-rate 0      floor of every per-bit error rate
+//    --sampled 32            search index-subset sampling, from this many
+//                            sampled bits per locker up
+//    --max-helpers 10000000  upper bound of the locker count
+//    --budget-ms 200         calibrate the Argon2 cost so that trying all
+//                            lockers takes at most this long on this host
+//    --threads 0             workers of a reproduction for --budget-ms
+//                            (default: one per online CPU)
+//
+//  Files use the format of the test fingerprints: one value per line, its
+//  bytes as decimal numbers separated by ';' (see FEReadings.h). The length
+//  is taken from the first line of the readings.
+
+typedef struct {
+    const char* readings;
+    const char* known;
+    const char* impostor;
+    FEOptimizeOptions optimize;
+    FECalibrateOptions calibrate;
+    bool calibrated;
+} OptimizeOptions;
+
+static int parseOptions(int argc, char** argv, OptimizeOptions *const o) {
+    memset(o, 0, sizeof(OptimizeOptions));
+    initFEOptimizeOptions(&o->optimize);
+    initFECalibrateOptions(&o->calibrate);
+    for (int a = 1; a < argc; a++) {
+        const char* opt = argv[a];
+        const char* arg = (a + 1 < argc) ? argv[a + 1] : 0;
+        int ret = 0;
+        if (!arg) {
+            ret = -1;
+        }
+        else if (strcmp(opt, "--readings") == 0)       o->readings = arg;
+        else if (strcmp(opt, "--known") == 0)          o->known = arg;
+        else if (strcmp(opt, "--impostor") == 0)       o->impostor = arg;
+        else if (strcmp(opt, "--frr") == 0)            o->optimize.targetFRR = strtod(arg, 0);
+        else if (strcmp(opt, "--far") == 0)            o->optimize.targetFAR = strtod(arg, 0);
+        else if (strcmp(opt, "--min-error-rate") == 0) o->optimize.minBitErrorRate = strtod(arg, 0);
+        else if (strcmp(opt, "--max-helpers") == 0)    o->optimize.maxHelpers = (size_t)strtoul(arg, 0, 10);
+        else if (strcmp(opt, "--threads") == 0)        o->calibrate.numThreads = (size_t)strtoul(arg, 0, 10);
+        else if (strcmp(opt, "--budget-ms") == 0) {
+            o->calibrated = true;
+            o->calibrate.budgetMs = strtod(arg, 0);
+        }
+        else if (strcmp(opt, "--sampled") == 0) {
+            o->optimize.sampled = true;
+            o->optimize.minSampleBits = (size_t)strtoul(arg, 0, 10);
+        }
+        else {
+            ret = -1;
+        }
+        if (ret != 0) {
+            fprintf(stderr, "fuzzy_optimize error: invalid option %s.\n", opt);
+            return -1;
+        }
+        a++;
+    }
+    if (!o->readings) {
+        fprintf(stderr, "fuzzy_optimize error: --readings is required.\n");
+        return -1;
+    }
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    OptimizeOptions o;
+    if (parseOptions(argc, argv, &o) != 0) {
+        return 1;
+    }
+    if (sodium_init() == -1) {
+        return 1;
+    }
+
+    size_t len = 0;
+    size_t numReadings = 0;
+    size_t numKnown = 0;
+    size_t numImpostor = 0;
+    unsigned char* readings = 0;
+    unsigned char* known = 0;
+    unsigned char* impostor = 0;
+    FEErrorProfile genuine;
+    FEErrorProfile other;
+    initErrorProfile(&genuine);
+    initErrorProfile(&other);
+
+    int ret = feReadingsLoad(o.readings, FE_READINGS_CSV, &len, &readings, &numReadings);
+    if (ret == 0 && o.known) ret = feReadingsLoad(o.known, FE_READINGS_CSV, &len, &known, &numKnown);
+    if (ret == 0 && o.impostor) {
+        ret = feReadingsLoad(o.impostor, FE_READINGS_CSV, &len, &impostor, &numImpostor);
+    }
+    if (ret == 0 && (numReadings == 0 || (o.known && numKnown == 0))) {
+        fprintf(stderr, "fuzzy_optimize error: no readings.\n");
+        ret = -2;
+    }
+
+    if (ret == 0) ret = feEstimateErrorProfile(known, readings, numReadings, len, &genuine);
+    if (ret == 0 && impostor) {
+        //  Against the same reference the genuine profile used.
+        ret = feEstimateErrorProfile(genuine.reference, impostor, numImpostor, len, &other);
+    }
+
+    FEProperties p;
+    double frr = 0.0;
+    double far = 0.0;
+    if (ret == 0) {
+        printErrorProfile(&genuine);
+        ret = feOptimizeProperties(&genuine, impostor ? &other : 0, &o.optimize, &p, &frr, &far);
+    }
+    FECalibration calibration;
+    if (ret == 0 && o.calibrated) {
+        ret = feCalibrate(&p, &o.calibrate, &calibration);
+        if (ret == -5) {
+            fprintf(stderr, "fuzzy_optimize error: at most %zu lockers fit %g ms.\n",
+                    calibration.maxHelpers, o.calibrate.budgetMs);
+        }
+    }
+    if (ret == 0) {
+        FEProperties worstCase;
+        initFEProperties(&worstCase, len, (size_t)genuine.maxHamming, o.optimize.targetFRR);
+        printFEProperties(&p);
+        printf("\nPredicted FRR: %g\n", frr);
+        printf("Predicted FAR: %g\n", far);
+        printf("# of helpers for the worst observed reading (hamErr %zu): %zu\n",
+                genuine.maxHamming, worstCase.numHelpers);
+        if (o.calibrated) {
+            printf("Locker time: %.3f ms, worst case reproduction: %.1f ms\n",
+                    calibration.lockerMs, calibration.worstCaseMs);
+        }
+    }
+
+    freeErrorProfile(&genuine);
+    freeErrorProfile(&other);
+    free(readings);
+    free(known);
+    free(impostor);
+    return (ret == 0) ? 0 : 1;
+}
@@ -0,0 +1,166 @@
+//########################################################################
+// (C) Embedded Systems Lab
+// All rights reserved.
+// ------------------------------------------------------------
+// This document contains proprietary information belonging to
+// Research & Development FH OÖ Forschungs und Entwicklungs GmbH.
+// Using, passing on and copying of this document or parts of it
+// is generally not permitted without prior written authorization.
+// ------------------------------------------------------------
+// info(at)embedded-lab.at
+// https://www.embedded-lab.at/
+//########################################################################
+// *** File name: FuzzySimulate.c
+// *** Date of file creation: 2022-02-07
+// *** List of autors: Lucas Drack
+// ***
+// *** Monte Carlo FRR/FAR of FEProperties under a noise model.
+//########################################################################
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sodium.h>
+
+#include "CFuzzyExtractor.h"
+#include "FEOptimizer.h"
+#include "FEReadings.h"
+#include "FESimulate.h"
+
+//  Usage: fuzzy_simulate [options]
+//
+//    --length 16             bytes of the value (taken from --readings if
+//                            given)
+//    --ham-err 4             hamErr of the simulated properties
+//    --rep-err 0.001         repErr of the simulated properties
+//    --sampled 0             sampled bits per locker, 0 for byte masks
+//    --hamming 4             noise: exactly this many bits flip
+//    --flip-rate 0.01        noise: every bit flips with this rate
+//    --readings path         noise: per-bit error rates of these readings
+//                            (CSV, see FEReadings.h) against their majority
+//    --drift 0.001           noise: add temperature drift of this rate per
+//    --delta-kelvin 20       kelvin, for this temperature difference
+//    --trials 1000           enrollments
+//    --readings-per-trial 10 genuine readings per enrollment
+//    --impostors 10          impostor readings per enrollment
+//    --hash compare          locker | blake2b | compare (default: compare)
+//    --threads 0             workers (default: one per online CPU)
+//    --confidence 0.95       level of the confidence intervals
+//    --seed 0                seed of the noise, 0 for a random one
+
+typedef struct {
+    size_t length;
+    size_t hamErr;
+    double repErr;
+    size_t sampleBits;
+    const char* readings;
+    FENoiseModel noise;
+    FESimulateOptions simulate;
+} SimulateOptions;
+
+static int parseOptions(int argc, char** argv, SimulateOptions *const o) {
+    memset(o, 0, sizeof(SimulateOptions));
+    o->length = 16;
+    o->hamErr = 4;
+    o->repErr = 0.001;
+    initFENoiseModel(&o->noise, FE_NOISE_HAMMING);
+    o->noise.hamming = 4;
+    initFESimulateOptions(&o->simulate);
+    o->simulate.hash = FE_SIM_COMPARE;
+    for (int a = 1; a < argc; a++) {
+        const char* opt = argv[a];
+        const char* arg = (a + 1 < argc) ? argv[a + 1] : 0;
+        int ret = 0;
+        if (!arg) {
+            ret = -1;
+        }
+        else if (strcmp(opt, "--length") == 0)       o->length = (size_t)strtoul(arg, 0, 10);
+        else if (strcmp(opt, "--ham-err") == 0)      o->hamErr = (size_t)strtoul(arg, 0, 10);
+        else if (strcmp(opt, "--rep-err") == 0)      o->repErr = strtod(arg, 0);
+        else if (strcmp(opt, "--sampled") == 0)      o->sampleBits = (size_t)strtoul(arg, 0, 10);
+        else if (strcmp(opt, "--delta-kelvin") == 0) o->noise.deltaKelvin = strtod(arg, 0);
+        else if (strcmp(opt, "--trials") == 0)       o->simulate.trials = strtoull(arg, 0, 10);
+        else if (strcmp(opt, "--impostors") == 0)    o->simulate.impostorsPerTrial = (size_t)strtoul(arg, 0, 10);
+        else if (strcmp(opt, "--threads") == 0)      o->simulate.numThreads = (size_t)strtoul(arg, 0, 10);
+        else if (strcmp(opt, "--confidence") == 0)   o->simulate.confidence = strtod(arg, 0);
+        else if (strcmp(opt, "--seed") == 0)         o->simulate.seed = strtoull(arg, 0, 10);
+        else if (strcmp(opt, "--readings-per-trial") == 0) {
+            o->simulate.readingsPerTrial = (size_t)strtoul(arg, 0, 10);
+        }
+        else if (strcmp(opt, "--hamming") == 0) {
+            o->noise.kind = FE_NOISE_HAMMING;
+            o->noise.hamming = (size_t)strtoul(arg, 0, 10);
+        }
+        else if (strcmp(opt, "--flip-rate") == 0) {
+            if (o->noise.kind != FE_NOISE_DRIFT) o->noise.kind = FE_NOISE_IID;
+            o->noise.flipRate = strtod(arg, 0);
+        }
+        else if (strcmp(opt, "--readings") == 0) {
+            if (o->noise.kind != FE_NOISE_DRIFT) o->noise.kind = FE_NOISE_PROFILE;
+            o->readings = arg;
+        }
+        else if (strcmp(opt, "--drift") == 0) {
+            o->noise.kind = FE_NOISE_DRIFT;
+            o->noise.driftPerKelvin = strtod(arg, 0);
+        }
+        else if (strcmp(opt, "--hash") == 0) {
+            if (strcmp(arg, "locker") == 0)        o->simulate.hash = FE_SIM_LOCKER;
+            else if (strcmp(arg, "blake2b") == 0)  o->simulate.hash = FE_SIM_BLAKE2B;
+            else if (strcmp(arg, "compare") == 0)  o->simulate.hash = FE_SIM_COMPARE;
+            else ret = -1;
+        }
+        else {
+            ret = -1;
+        }
+        if (ret != 0) {
+            fprintf(stderr, "fuzzy_simulate error: invalid option %s.\n", opt);
+            return -1;
+        }
+        a++;
+    }
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    SimulateOptions o;
+    if (parseOptions(argc, argv, &o) != 0) {
+        return 1;
+    }
+    if (sodium_init() == -1) {
+        return 1;
+    }
+
+    size_t numReadings = 0;
+    unsigned char* readings = 0;
+    FEErrorProfile profile;
+    initErrorProfile(&profile);
+
+    int ret = 0;
+    if (o.readings) {
+        o.length = 0;
+        ret = feReadingsLoad(o.readings, FE_READINGS_CSV, &o.length, &readings, &numReadings);
+        if (ret == 0 && numReadings == 0) {
+            fprintf(stderr, "fuzzy_simulate error: no readings.\n");
+            ret = -2;
+        }
+        if (ret == 0) ret = feEstimateErrorProfile(0, readings, numReadings, o.length, &profile);
+        if (ret == 0) o.noise.profile = &profile;
+    }
+
+    FESimulation result;
+    initFESimulation(&result);
+    if (ret == 0) {
+        FEProperties p;
+        initFESampledProperties(&p, o.length, o.hamErr, o.repErr, o.sampleBits);
+        printFEProperties(&p);
+        ret = feSimulate(&p, &o.noise, &o.simulate, &result);
+    }
+    if (ret == 0) {
+        printFESimulation(&result);
+    }
+
+    freeFESimulation(&result);
+    freeErrorProfile(&profile);
+    free(readings);
+    return (ret == 0) ? 0 : 1;
+}